@@ -12,228 +12,1772 @@
 #include <Arduino.h>
 #include <DFRobot_WK2132.h>
 
+//波特率表放在Flash中，AVR上不占用RAM
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define IIC_SERIAL_PROGMEM                       PROGMEM
+#define IIC_SERIAL_READ_PROGMEM(dst, src, size)  memcpy_P(dst, src, size)
+#else
+#define IIC_SERIAL_PROGMEM
+#define IIC_SERIAL_READ_PROGMEM(dst, src, size)  memcpy(dst, src, size)
+#endif
+
+//FIFO分包长度：requestFrom()和分包计数都是uint8_t，Wire缓存为256字节时按255分包，避免长度回绕为0
+#define IIC_SERIAL_FIFO_CHUNK  ((IIC_SERIAL_WIRE_BUFFER_SIZE > 255) ? 255 : IIC_SERIAL_WIRE_BUFFER_SIZE)
+static_assert(IIC_SERIAL_WIRE_BUFFER_SIZE > 0, "IIC_SERIAL_WIRE_BUFFER_SIZE must be positive");
+
+//总线锁的作用域守卫：一组页切换和寄存器访问在同一次加锁内完成，IIC_SERIAL_ENABLE_RTOS为0时lock()/unlock()为空函数
+class DFRobot_WK2132_Guard{
+public:
+  DFRobot_WK2132_Guard(DFRobot_WK2132 *pChip):_pChip(pChip){if(_pChip) _pChip->lock();}
+  ~DFRobot_WK2132_Guard(){if(_pChip) _pChip->unlock();}
+private:
+  DFRobot_WK2132 *_pChip;
+};
+
 //DFRobot_IIC_Serial iicSerial;
 DFRobot_IIC_Serial::DFRobot_IIC_Serial(TwoWire &wire,  uint8_t subUartChannel, uint8_t addr){
+  _pChip = NULL;
   _pWire = &wire;
-  _addr = addr << 3;
-  _cacheObject = 0xff;
-  _page = 0xff;
+  _addr = addr;
   _subSerialChannel = subUartChannel;
-  _rxBufferIndex = 0;
- // _rxBufferTail = 0;
-  _txBufferIndex = 0;
- // _txBufferTail = 0;
+  _writePolicy = eWriteBlocking;
+  _intCb = NULL;
+  _txEmptyNotify = false;
+  _frameMode = false;
+  _frameCb = NULL;
+  _rxSink = NULL;
+  _errCb = NULL;
+  _rxErrFsr = 0;
+  _beginUs = 0;
+  _flowCtrl = false;
+  _xoffSent = false;
+  _peerXoff = false;
+  _flowPending = 0;
+  _flowHigh = 192;
+  _flowLow = 64;
+  _bfState = eBfIdle;
+  _pBfData = NULL;
+  _bfLen = 0;
+  _bfSent = 0;
+  memset(&_lineStats, 0, sizeof(_lineStats));
+  resetFrames();
+  _rxBufferHead = 0;
+  _rxBufferTail = 0;
+  _rxBufferSize = IIC_SERIAL_RX_BUFFER_SIZE;
+  _txFree = 0;
+  _baud = 0;
+#if IIC_SERIAL_ENABLE_STATS
+  memset(&_stats, 0, sizeof(_stats));
+#endif
+  _pRxBuffer = _rxBuffer;
+  _pTxBuffer = _txBuffer;
+  _txBufferHead = 0;
+  _txBufferTail = 0;
+  _txBufferSize = IIC_SERIAL_TX_BUFFER_SIZE;
   memset(_rxBuffer, 0, sizeof(_rxBuffer));
   memset(_txBuffer, 0, sizeof(_txBuffer));
+#if IIC_SERIAL_ENABLE_RTOS
+  _taskMode = false;
+  memset(&_ringStats, 0, sizeof(_ringStats));
+#endif
 }
 
-DFRobot_IIC_Serial::~DFRobot_IIC_Serial(){
-  
+DFRobot_IIC_Serial::DFRobot_IIC_Serial(DFRobot_WK2132 &chip, uint8_t subUartChannel)
+  :DFRobot_IIC_Serial(*chip.getWire(), subUartChannel, chip.getAddr()){
+  _pChip = &chip;
 }
 
-void DFRobot_IIC_Serial::begin(long unsigned baud, uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt){
-  _pWire->begin();
-  _addr = updateAddr(_addr, SUBUART_CHANNEL_1, OBJECT_REGISTER);
-  uint8_t val = 0;
-  if(readReg(REG_WK2132_GENA, &val, 1) != 1){
-      DBG("READ BYTE SIZE ERROR!");
-      return; //ERR_DATA_READ;
+DFRobot_IIC_Serial::~DFRobot_IIC_Serial(){
+  if(_pChip){
+      _pChip->detachChannel(this);
   }
-  if((val >> 6) != 0x02){
-      DBG("");
-      return;// ERR_DATA_BUS;
+}
+
+int DFRobot_IIC_Serial::begin(long unsigned baud, uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt){
+  return beginDivisor(baud, NULL, format, mode, opt);
+}
+int DFRobot_IIC_Serial::beginDivisor(unsigned long baud, const sBaudDivisor_t *pDiv, uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt){
+  unsigned long start = micros();
+  int ret = attachChip();
+  if(ret != ERR_OK){
+      return ret;
   }
+  //配置过程中有第1页的访问，整个begin()作为一个单元占用总线
+  DFRobot_WK2132_Guard guard(_pChip);
+  _pChip->_lastErr = ERR_OK;
   subSerialConfig(_subSerialChannel);
   DBG("OK");
-  setSubSerialBaudRate(_subSerialChannel, baud);
+  ret = configure(baud, pDiv, format, mode, opt);
+  _beginUs = micros() - start;
+  return ret;
+}
+int DFRobot_IIC_Serial::attachChip(void){
+  if(_pChip == NULL){
+      _pChip = DFRobot_WK2132::find(*_pWire, _addr);
+      if(_pChip == NULL){
+          _pChip = new DFRobot_WK2132(*_pWire, _addr);
+          _pChip->_autoCreated = true;
+      }
+  }
+  _pChip->attachChannel(this);
+  return _pChip->begin();
+}
+bool DFRobot_IIC_Serial::beginWarm(unsigned long baud, uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt){
+  unsigned long start = micros();
+  if(attachChip() != ERR_OK){
+      return false;
+  }
+  DFRobot_WK2132_Guard guard(_pChip);
+  _pChip->_lastErr = ERR_OK;
+  //子串口时钟未打开说明芯片刚上电或子串口从未配置过，按begin()完整初始化
+  if(!(_pChip->_gena & (1 << _subSerialChannel)) || _pChip->loadShadows(_subSerialChannel) != ERR_OK){
+      subSerialConfig(_subSerialChannel);
+      configure(baud, NULL, format, mode, opt);
+      _beginUs = micros() - start;
+      return false;
+  }
+  //与begin()相同的默认配置，只写不同的位，不写FIFO复位位
+  _pChip->subSerialGlobalRegEnable(_subSerialChannel, intrpt);
+  sSierReg_t sier = {.rFTrig = 0x01, .rxOvt = 0x01, .tfTrig = 0x00, .tFEmpty = 0x00, .rsv = 0x00, .fErr = 0x01};
+  _pChip->subSerialRegUpdate(_subSerialChannel, page0, REG_WK2132_SIER, 0xff, *(uint8_t *)&sier);
+  sFcrReg_t fcr = {.rfRst = 0x00, .tfRst = 0x00, .rfEn = 0x01, .tfEn = 0x01, .rfTrig = 0x00, .tfTrig = 0x00};
+  _pChip->subSerialRegUpdate(_subSerialChannel, page0, REG_WK2132_FCR, 0xfc, *(uint8_t *)&fcr);
+  _pChip->subSerialRegUpdate(_subSerialChannel, page1, REG_WK2132_RFTL, 0xff, 0x00);
+  _pChip->subSerialRegUpdate(_subSerialChannel, page1, REG_WK2132_TFTL, 0xff, 0x00);
+  configure(baud, NULL, format, mode, opt);
+  if(_pChip->_lastErr != ERR_OK){
+      //热连接过程中有访问失败，寄存器状态不确定，按begin()完整初始化
+      DBG("warm begin failed, full init");
+      _pChip->_lastErr = ERR_OK;
+      subSerialConfig(_subSerialChannel);
+      configure(baud, NULL, format, mode, opt);
+      _beginUs = micros() - start;
+      return false;
+  }
+  _beginUs = micros() - start;
+  return true;
+}
+int DFRobot_IIC_Serial::configure(unsigned long baud, const sBaudDivisor_t *pDiv, uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt){
+  setSubSerialDivisor(baud, pDiv ? *pDiv : baudDivisor(baud));
   setSubSerialConfigReg(format, mode, opt);
+  DBG("子串口接收/发送使能");
+  //波特率和数据格式配置完成后再打开收发，避免按旧配置收发数据
+  sScrReg_t scr = {.rxEn = 0x01, .txEn = 0x01, .sleepEn = 0x00, .rsv = 0x00 };
+  _pChip->subSerialRegUpdate(_subSerialChannel, page0, REG_WK2132_SCR, 0x03, *(uint8_t *)&scr);
+  _pChip->probeBurstRead(_subSerialChannel);
+  _txFree = 0;
+  _txBufferHead = 0;
+  _txBufferTail = 0;
+  _peerXoff = false;
+  _xoffSent = false;
+  _flowPending = 0;
+  _bfState = eBfIdle;
+  //配置过程中各寄存器访问的错误由芯片对象记录，begin()开始时已清除
+  return _pChip->_lastErr;
 }
-void DFRobot_IIC_Serial::begin(long unsigned baud, uint8_t format, uint8_t mode, uint8_t opt){
-  begin(baud, format, (eCommunicationMode_t)mode, (eLineBreakOutput_t)opt);
+int DFRobot_IIC_Serial::begin(long unsigned baud, uint8_t format, uint8_t mode, uint8_t opt){
+  return begin(baud, format, (eCommunicationMode_t)mode, (eLineBreakOutput_t)opt);
 }
 
 void DFRobot_IIC_Serial::end(){
-  //复位
+  if(_pChip == NULL){
+      return;
+  }
+  //关闭子串口的中断和时钟，再次调用begin()时重新配置
+  _pChip->subSerialGlobalRegDisable(_subSerialChannel, intrpt);
+  _pChip->subSerialGlobalRegDisable(_subSerialChannel, clock);
+  _rxBufferHead = 0;
+  _rxBufferTail = 0;
+  _txBufferHead = 0;
+  _txBufferTail = 0;
+  resetFrames();
 }
 
 int DFRobot_IIC_Serial::available(void){
-  int index = 0;
+  if(rxBufferCount() == 0 && !taskMode()){
+      fillRxBuffer();
+  }
+  return rxBufferCount();
+}
+
+int DFRobot_IIC_Serial::peek(void){
+  if(rxBufferCount() == 0 && (taskMode() || fillRxBuffer() == 0)){
+#if IIC_SERIAL_ENABLE_STATS
+      _stats.fifoEmpty++;
+#endif
+      return -1;
+  }
+  return _pRxBuffer[_rxBufferTail];
+}
+
+int DFRobot_IIC_Serial::read(void){
+  if(rxBufferCount() == 0 && (taskMode() || fillRxBuffer() == 0)){
+      DBG("FIFO Empty!");
+#if IIC_SERIAL_ENABLE_STATS
+      _stats.fifoEmpty++;
+#endif
+      return -1;
+  }
+  uint8_t val = _pRxBuffer[_rxBufferTail];
+  IIC_SERIAL_RING_STORE(_rxBufferTail, (uint16_t)((_rxBufferTail + 1) % _rxBufferSize));
+  return (int)val;
+}
+
+void DFRobot_IIC_Serial::setRxBuffer(uint8_t *pBuf, uint16_t size){
+  if(pBuf == NULL || size < 2){
+      pBuf = _rxBuffer;
+      size = IIC_SERIAL_RX_BUFFER_SIZE;
+  }
+  _pRxBuffer = pBuf;
+  _rxBufferSize = size;
+  _rxBufferHead = 0;
+  _rxBufferTail = 0;
+  resetFrames();
+}
+
+void DFRobot_IIC_Serial::setTxBuffer(uint8_t *pBuf, uint16_t size){
+  if(pBuf == NULL || size < 2){
+      pBuf = _txBuffer;
+      size = IIC_SERIAL_TX_BUFFER_SIZE;
+  }
+  _pTxBuffer = pBuf;
+  _txBufferSize = size;
+  _txBufferHead = 0;
+  _txBufferTail = 0;
+}
+
+int DFRobot_IIC_Serial::getRxFifoCount(void){
+  sStatus_t st;
+  if(_pChip && _pChip->_burstRead){
+      if(status(&st) != ERR_OK){
+          return -1;
+      }
+      return st.rxCount;
+  }
   uint8_t val = 0;
   sFsrReg_t fsr;
- // DBG(_subSerialChannel);
   if(readReg(REG_WK2132_RFCNT, &val, 1) != 1){
       DBG("READ BYTE SIZE ERROR!");
       return -1;
   }
-  index = (int)val;
-  if(index == 0){
+  if(val == 0){
       fsr = readFIFOStateReg();
-      if(fsr.rDat == 1){
-          index = 256;
+      if(fsr.rDat == 0){
+          return 0;
+      }
+      //读RFCNT和FSR之间可能刚收到数据，再读一次RFCNT，仍为0才是FIFO满256字节
+      if(readReg(REG_WK2132_RFCNT, &val, 1) != 1){
+          DBG("READ BYTE SIZE ERROR!");
+          return -1;
       }
+      if(val == 0){
+          _lineStats.rxHighWater = 256;
+          return 256;
+      }
+  }
+  if(val > _lineStats.rxHighWater){
+      _lineStats.rxHighWater = val;
   }
-  return index;
+  return (int)val;
 }
 
-int DFRobot_IIC_Serial::peek(void){
-  
-  return -1;
+int DFRobot_IIC_Serial::status(sStatus_t *pStatus){
+  if(pStatus == NULL || _pChip == NULL){
+      DBG("PARAMETER ERROR!");
+      return ERR_DATA_READ;
+  }
+  uint8_t val[4];
+  DFRobot_WK2132_Guard guard(_pChip);
+  _pChip->subSerialPageSwitch(_subSerialChannel, page0);
+  if(_pChip->_burstRead){
+      if(readReg(REG_WK2132_TFCNT, val, 4) != 4){
+          DBG("READ BYTE SIZE ERROR!");
+          return ERR_DATA_READ;
+      }
+  }else{
+      //先读FSR再读计数，FSR之后FIFO只会变化1个字节以内，计数为0时可由FSR确定空或满
+      if(readReg(REG_WK2132_FSR, &val[2], 1) != 1 || readReg(REG_WK2132_TFCNT, &val[0], 1) != 1 ||
+         readReg(REG_WK2132_RFCNT, &val[1], 1) != 1 || readReg(REG_WK2132_LSR, &val[3], 1) != 1){
+          DBG("READ BYTE SIZE ERROR!");
+          return ERR_DATA_READ;
+      }
+  }
+  pStatus->txCount = val[0];
+  pStatus->rxCount = val[1];
+  pStatus->fsr = *(sFsrReg_t *)&val[2];
+  pStatus->lsr = val[3];
+  noteFsr(val[2]);
+  fixStatusCount(pStatus);
+  if(_pChip->_burstRead && val[1] == 0 && pStatus->fsr.rDat){
+      //连续读取时RFCNT先于FSR读出，其间可能刚收到数据，再读一次RFCNT，仍为0才是FIFO满
+      if(readReg(REG_WK2132_RFCNT, &val[1], 1) != 1){
+          DBG("READ BYTE SIZE ERROR!");
+          return ERR_DATA_READ;
+      }
+      pStatus->rxCount = val[1] ? val[1] : 256;
+  }
+  if(pStatus->rxCount > _lineStats.rxHighWater){
+      _lineStats.rxHighWater = pStatus->rxCount;
+  }
+  _txFree = 256 - pStatus->txCount;
+  return ERR_OK;
 }
 
-int DFRobot_IIC_Serial::read(void){
-  sFsrReg_t fsr;
-  uint8_t val;
-  fsr = readFIFOStateReg();
-  if(fsr.rDat == 0){
-      DBG("FIFO Empty!");
-      return -1;
+void DFRobot_IIC_Serial::fixStatusCount(sStatus_t *pStatus){
+  //发送FIFO计数为0时非空按满处理：即使其间刚发出1个字节，按满计算也只会少写，不会溢出
+  if(pStatus->txCount == 0 && pStatus->fsr.tDat){
+      pStatus->txCount = 256;
+  }
+  if(pStatus->rxCount == 0 && pStatus->fsr.rDat){
+      pStatus->rxCount = 256;
   }
-  readReg(REG_WK2132_FDAT, &val, 1);
-  return (int)val;
+}
+
+uint16_t DFRobot_IIC_Serial::fillRxBuffer(int count){
+  bool sink = _rxSink && !_frameMode;
+  uint16_t space = sink ? 256 : (_rxBufferSize - 1 - rxBufferCount());
+  if(space == 0){
+      return 0;
+  }
+  if(count < 0){
+      count = getRxFifoCount();
+  }
+  if(count <= 0){
+      if(_flowCtrl){
+          flowUpdate(sink ? 0 : rxBufferCount());
+      }
+      return 0;
+  }
+  int fifoCount = count;
+  if(count > space){
+      count = space;
+  }
+  uint16_t total;
+  if((_rxErrFsr & 0x70) && _errCb){
+      total = fillMarked(count);
+  }else{
+      countRxErrors();
+      total = sink ? fillSink(count) : fillRing(count);
+  }
+  if(_flowCtrl){
+      //FIFO中没有读走的部分加上主控端缓存中的数据
+      flowUpdate(fifoCount - count + (sink ? 0 : rxBufferCount()));
+  }
+  return total;
+}
+uint16_t DFRobot_IIC_Serial::fillRing(uint16_t count){
+  uint16_t total = 0, kept = 0;
+  while(total < count){
+      //环形缓存分两段连续空间填充；尾指针由读取方修改，读一次后按这个值计算
+      uint16_t tail = IIC_SERIAL_RING_LOAD(_rxBufferTail);
+      uint16_t len = (_rxBufferHead >= tail) ? (_rxBufferSize - _rxBufferHead) : (tail - 1 - _rxBufferHead);
+      if(tail == 0 && _rxBufferHead >= tail){
+          len--;
+      }
+      if(len > count - total){
+          len = count - total;
+      }
+      size_t n = readFifoCache(_pRxBuffer + _rxBufferHead, len);
+      uint16_t k = _flowCtrl ? filterFlow(_pRxBuffer + _rxBufferHead, n) : n;
+      IIC_SERIAL_RING_STORE(_rxBufferHead, (uint16_t)((_rxBufferHead + k) % _rxBufferSize));
+      total += n;
+      kept += k;
+      if(n != len){
+          break;
+      }
+  }
+  if(_frameMode){
+      _frameOpen += kept;
+  }
+  return kept;
+}
+uint16_t DFRobot_IIC_Serial::filterFlow(uint8_t *pBuf, uint16_t size){
+  bool paused = _peerXoff;
+  uint16_t kept = 0;
+  for(uint16_t i = 0; i < size; i++){
+      if(pBuf[i] == IIC_SERIAL_XOFF){
+          paused = true;
+      }else if(pBuf[i] == IIC_SERIAL_XON){
+          paused = false;
+      }else{
+          pBuf[kept++] = pBuf[i];
+      }
+  }
+  setPeerPaused(paused);
+  return kept;
+}
+void DFRobot_IIC_Serial::setPeerPaused(bool paused){
+  if(paused == _peerXoff){
+      return;
+  }
+  //发送器保持使能，本端的XON/XOFF在暂停期间也能发出；暂停期间写入的数据留在主控端发送队列，恢复后写入发送FIFO
+  _peerXoff = paused;
+  if(!paused && txBufferCount() && !taskMode()){
+      poll();
+  }
+}
+void DFRobot_IIC_Serial::flowUpdate(uint16_t level){
+  if(!_xoffSent && level >= _flowHigh){
+      _xoffSent = true;
+      sendFlowChar(IIC_SERIAL_XOFF);
+  }else if(_xoffSent && level <= _flowLow){
+      _xoffSent = false;
+      sendFlowChar(IIC_SERIAL_XON);
+  }else if(_flowPending){
+      sendFlowChar(_flowPending);
+  }
+}
+void DFRobot_IIC_Serial::sendFlowChar(uint8_t c){
+  if(_txFree == 0 && getTxFifoSpace() <= 0){
+      _flowPending = c;
+      return;
+  }
+  if(writeReg(REG_WK2132_FDAT, &c, 1) != ERR_OK){
+      _flowPending = c;
+      return;
+  }
+  _txFree--;
+  _flowPending = 0;
+}
+void DFRobot_IIC_Serial::setFlowControl(bool enable, uint16_t highWater, uint16_t lowWater){
+  _flowHigh = highWater;
+  _flowLow = lowWater;
+  if(enable == _flowCtrl){
+      return;
+  }
+  _flowCtrl = enable;
+  if(!enable && _pChip){
+      if(_xoffSent){
+          sendFlowChar(IIC_SERIAL_XON);
+      }
+      setPeerPaused(false);
+  }
+  _xoffSent = false;
+  _flowPending = 0;
+}
+
+int DFRobot_IIC_Serial::sendBreakFrame(const uint8_t *pBuf, size_t size, unsigned long breakUs, unsigned long mabUs){
+  if(_pChip == NULL || (pBuf == NULL && size)){
+      DBG("PARAMETER ERROR!");
+      return ERR_DATA_WRITE;
+  }
+  if(_bfState != eBfIdle){
+      return ERR_BUSY;
+  }
+  _pBfData = pBuf;
+  _bfLen = size;
+  _bfSent = 0;
+  _bfBreakUs = breakUs;
+  _bfMabUs = mabUs;
+  _bfState = eBfDrain;
+  int ret = serviceBreakFrame();
+  if(_bfState != eBfIdle){
+      //剩余部分由poll()或发送FIFO中断继续
+      poll();
+  }
+  return ret;
+}
+int DFRobot_IIC_Serial::sendLinFrame(uint8_t id, const uint8_t *pData, uint8_t len, bool enhanced){
+  if(id > 0x3f || len > 8 || (pData == NULL && len)){
+      DBG("PARAMETER ERROR!");
+      return ERR_DATA_WRITE;
+  }
+  if(_bfState != eBfIdle){
+      return ERR_BUSY;
+  }
+  //受保护ID：P0 = ID0^ID1^ID2^ID4，P1 = !(ID1^ID3^ID4^ID5)
+  uint8_t p0 = ((id >> 0) ^ (id >> 1) ^ (id >> 2) ^ (id >> 4)) & 0x01;
+  uint8_t p1 = (~((id >> 1) ^ (id >> 3) ^ (id >> 4) ^ (id >> 5))) & 0x01;
+  uint8_t pid = id | (p0 << 6) | (p1 << 7);
+  _linBuf[0] = 0x55;
+  _linBuf[1] = pid;
+  uint8_t size = 2;
+  if(len){
+      //校验和为反码和：带进位回卷的8位累加后取反
+      uint16_t sum = enhanced ? pid : 0;
+      for(uint8_t i = 0; i < len; i++){
+          _linBuf[size++] = pData[i];
+          sum += pData[i];
+          if(sum > 0xff){
+              sum -= 0xff;
+          }
+      }
+      _linBuf[size++] = ~(uint8_t)sum;
+  }
+  unsigned long bitUs = _baud ? (1000000UL + _baud - 1) / _baud : 1000;
+  return sendBreakFrame(_linBuf, size, 13 * bitUs, bitUs);
+}
+int DFRobot_IIC_Serial::serviceBreakFrame(void){
+  while(true){
+      unsigned long elapsed = micros() - _bfAt;
+      switch(_bfState){
+        case eBfDrain:{
+            uint8_t val = 0;
+            _pChip->subSerialPageSwitch(_subSerialChannel, page0);
+            if(readReg(REG_WK2132_FSR, &val, 1) != 1){
+                _bfState = eBfIdle;
+                return _pChip->_lastErr;
+            }
+            noteFsr(val);
+            sFsrReg_t fsr = *(sFsrReg_t *)&val;
+            if(fsr.tDat){
+                //等发送FIFO空中断或下次poll()
+                return ERR_OK;
+            }
+            if(fsr.tBusy){
+                //FIFO已空，最后一个字节还在移位，不到一个字符时间
+                yield();
+                continue;
+            }
+            int ret = _pChip->subSerialRegUpdate(_subSerialChannel, page0, REG_WK2132_LCR, 0x20, 0x20);
+            if(ret != ERR_OK){
+                _bfState = eBfIdle;
+                return ret;
+            }
+            _bfAt = micros();
+            _bfState = eBfBreak;
+            break;
+        }
+        case eBfBreak:
+        case eBfMab:{
+            unsigned long wait = (_bfState == eBfBreak) ? _bfBreakUs : _bfMabUs;
+            if(elapsed < wait){
+                if(wait - elapsed > IIC_SERIAL_BREAK_SPIN_US){
+                    return ERR_OK;
+                }
+                delayMicroseconds(wait - elapsed);
+            }
+            if(_bfState == eBfMab){
+                _bfState = eBfData;
+                _txFree = 256;
+                break;
+            }
+            int ret = _pChip->subSerialRegUpdate(_subSerialChannel, page0, REG_WK2132_LCR, 0x20, 0x00);
+            if(ret != ERR_OK){
+                _bfState = eBfIdle;
+                return ret;
+            }
+            _bfAt = micros();
+            _bfState = eBfMab;
+            break;
+        }
+        case eBfData:{
+            if(_bfSent >= _bfLen){
+                _bfState = eBfIdle;
+                return ERR_OK;
+            }
+            int space = _txFree ? _txFree : getTxFifoSpace();
+            if(space <= 0){
+                return (space < 0) ? _pChip->_lastErr : ERR_OK;
+            }
+            uint16_t len = _bfLen - _bfSent;
+            if(len > space){
+                len = space;
+            }
+            if(_bfSent == 0){
+                //第一个字节单独写入，MAB只多出一次2字节的IIC写入时间
+                len = 1;
+            }
+            size_t n = writeFifo(_pBfData + _bfSent, len);
+            _bfSent += n;
+            _txFree = (n < _txFree) ? (_txFree - n) : 0;
+            if(n != len){
+                _bfState = eBfIdle;
+                return _pChip->_lastErr;
+            }
+            break;
+        }
+        default:
+            return ERR_OK;
+      }
+  }
+}
+
+uint16_t DFRobot_IIC_Serial::fillMarked(uint16_t count){
+  uint16_t total = 0;
+  _rxErrFsr = 0;
+  while(total < count){
+      uint8_t lsr = 0, data = 0;
+      if(readReg(REG_WK2132_LSR, &lsr, 1) != 1 || readFifoCache(&data, 1) != 1){
+          break;
+      }
+      if(_flowCtrl && filterFlow(&data, 1) == 0){
+          total++;
+          continue;
+      }
+      //溢出由读FSR时统计，这里只统计逐字节的错误
+      lsr &= IIC_SERIAL_LSR_PE | IIC_SERIAL_LSR_FE | IIC_SERIAL_LSR_BI;
+      if(lsr){
+          if(lsr & IIC_SERIAL_LSR_PE) _lineStats.parity++;
+          if(lsr & IIC_SERIAL_LSR_FE) _lineStats.framing++;
+          if(lsr & IIC_SERIAL_LSR_BI) _lineStats.breaks++;
+          _errCb(this, data, lsr);
+      }
+      if(_rxSink && !_frameMode){
+          _rxSink(this, &data, 1);
+      }else{
+          _pRxBuffer[_rxBufferHead] = data;
+          IIC_SERIAL_RING_STORE(_rxBufferHead, (uint16_t)((_rxBufferHead + 1) % _rxBufferSize));
+          if(_frameMode){
+              _frameOpen++;
+          }
+      }
+      total++;
+  }
+  return total;
+}
+void DFRobot_IIC_Serial::countRxErrors(void){
+  //没有逐字节读取LSR时，按本批数据中出现过的错误各计1次
+  if(_rxErrFsr & 0x10) _lineStats.parity++;
+  if(_rxErrFsr & 0x20) _lineStats.framing++;
+  if(_rxErrFsr & 0x40) _lineStats.breaks++;
+  _rxErrFsr = 0;
+}
+void DFRobot_IIC_Serial::noteFsr(uint8_t fsr){
+  if(fsr & 0x80){
+      _lineStats.overruns++;
+  }
+  _rxErrFsr |= fsr & 0x70;
+}
+uint16_t DFRobot_IIC_Serial::fillSink(int count){
+  if(count < 0){
+      count = getRxFifoCount();
+  }
+  //只用一个Wire分包大小的栈缓存中转，每读出一包就交给接收函数
+  uint8_t chunk[IIC_SERIAL_WIRE_BUFFER_SIZE];
+  uint16_t total = 0;
+  while((int)total < count){
+      uint16_t len = (count - total) > (int)sizeof(chunk) ? sizeof(chunk) : (count - total);
+      size_t n = readFifoCache(chunk, len);
+      uint16_t k = _flowCtrl ? filterFlow(chunk, n) : n;
+      if(k){
+          _rxSink(this, chunk, k);
+      }
+      total += n;
+      if(n != len){
+          break;
+      }
+  }
+  return total;
+}
+
+size_t DFRobot_IIC_Serial::drain(void){
+  if(_rxSink == NULL){
+      return 0;
+  }
+  return fillSink(-1);
+}
+
+size_t DFRobot_IIC_Serial::readAvailable(uint8_t *pBuf, size_t size){
+  if(pBuf == NULL || size == 0){
+      return 0;
+  }
+  size_t count = takeRxBuffer(pBuf, size);
+  if(count == size || taskMode()){
+      return count;
+  }
+  //主控端缓存取空后，剩余部分直接从接收FIFO批量读到用户缓存
+  int len = getRxFifoCount();
+  if(len <= 0){
+      if(_flowCtrl){
+          //缓存取走后水位下降，按需发送XON
+          fillRxBuffer(0);
+      }
+      return count;
+  }
+  if((((_rxErrFsr & 0x70) && _errCb) || _flowCtrl) && !(_rxSink && !_frameMode)){
+      //数据中有错误需逐字节标记，或打开了流控需去掉XON/XOFF时，经主控端接收缓存转交
+      fillRxBuffer(len);
+      return count + takeRxBuffer(pBuf + count, size - count);
+  }
+  if((size_t)len > size - count){
+      len = size - count;
+  }
+  countRxErrors();
+  return count + readFifoCache(pBuf + count, len);
+}
+
+size_t DFRobot_IIC_Serial::takeRxBuffer(uint8_t *pBuf, size_t size){
+  uint16_t head = IIC_SERIAL_RING_LOAD(_rxBufferHead);
+  uint16_t tail = _rxBufferTail;
+  size_t count = 0;
+  while(count < size && tail != head){
+      pBuf[count++] = _pRxBuffer[tail];
+      tail = (tail + 1) % _rxBufferSize;
+  }
+  IIC_SERIAL_RING_STORE(_rxBufferTail, tail);
+  return count;
+}
+
+size_t DFRobot_IIC_Serial::readBytes(uint8_t *pBuf, size_t size){
+  size_t count = 0;
+  unsigned long startMillis = millis();
+  while(count < size){
+      size_t n = readAvailable(pBuf + count, size - count);
+      if(n > 0){
+          count += n;
+          startMillis = millis();
+          continue;
+      }
+      if(millis() - startMillis >= _timeout){
+          break;
+      }
+      waitBusTask();
+  }
+  return count;
 }
 
 size_t DFRobot_IIC_Serial::write(uint8_t value){
-  sFsrReg_t fsr;
-  fsr = readFIFOStateReg();
-  if(fsr.tFull == 1){
+  if(taskMode() || _peerXoff){
+      return write(&value, 1);
+  }
+  if(_writePolicy == eWriteAsync){
+      return queueTx(&value, 1);
+  }
+  if(txBufferCount()){
+      //对端恢复后队列中还有数据，按队列的顺序发出
+      return write(&value, 1);
+  }
+  //_txFree是上次读到的发送FIFO剩余空间减去之后写入的字节数，FIFO只会被芯片取走数据，用完才需要重新读取
+  if(_txFree == 0 && getTxFifoSpace() <= 0){
       DBG("FIFO full!");
-      return -1;
+#if IIC_SERIAL_ENABLE_STATS
+      _stats.fifoFull++;
+#endif
+      return 0;
+  }
+  if(writeReg(REG_WK2132_FDAT, &value, 1) != ERR_OK){
+      return 0;
+  }
+  _txFree--;
+  if(_txEmptyNotify && !(getSier() & IIC_SERIAL_INT_TFEMPTY)){
+      writeSier(getSier() | IIC_SERIAL_INT_TFEMPTY);
   }
-  writeReg(REG_WK2132_FDAT, &value, 1);
   return 1;
 }
 
+size_t DFRobot_IIC_Serial::queueTx(const uint8_t *pBuf, size_t size){
+  size_t count = 0;
+  for(uint8_t retry = 0; retry < 2 && count < size; retry++){
+      if(retry){
+          //队列满时把队列中的数据写入发送FIFO腾出空间，只尝试一次，不等待；任务模式下发送FIFO只由总线任务写入
+          if(taskMode()){
+              break;
+          }
+          poll();
+      }
+      uint16_t tail = IIC_SERIAL_RING_LOAD(_txBufferTail);
+      uint16_t head = _txBufferHead;
+      while(count < size){
+          uint16_t next = (head + 1) % _txBufferSize;
+          if(next == tail){
+              break;
+          }
+          _pTxBuffer[head] = pBuf[count++];
+          head = next;
+      }
+      IIC_SERIAL_RING_STORE(_txBufferHead, head);
+  }
+#if IIC_SERIAL_ENABLE_STATS
+  if(count < size){
+      _stats.fifoFull++;
+  }
+#endif
+#if IIC_SERIAL_ENABLE_RTOS
+  if(_taskMode){
+      if(count < size){
+          _ringStats.txFull++;
+      }
+      uint16_t used = txBufferCount();
+      if(used > _ringStats.txHighWater){
+          _ringStats.txHighWater = used;
+      }
+  }
+#endif
+  return count;
+}
+
+bool DFRobot_IIC_Serial::drainTxBuffer(void){
+  uint16_t left = txBufferCount();
+  unsigned long startMillis = millis();
+  while(left){
+      if(_flowCtrl){
+          fillRxBuffer();
+      }
+      poll();
+      if(_peerXoff){
+          return false;
+      }
+      uint16_t n = txBufferCount();
+      if(n < left){
+          left = n;
+          startMillis = millis();
+          continue;
+      }
+      if(millis() - startMillis >= _timeout){
+          return false;
+      }
+      yield();
+  }
+  return true;
+}
+
+int DFRobot_IIC_Serial::poll(void){
+  if(_pChip == NULL){
+      return 0;
+  }
+  if(_flowPending){
+      //上次因发送FIFO满没发出的XON/XOFF先于队列数据发出
+      sendFlowChar(_flowPending);
+  }
+  if(_bfState != eBfIdle){
+      serviceBreakFrame();
+  }
+#if IIC_SERIAL_ENABLE_RTOS
+  if(_taskMode){
+      //任务模式下由总线任务把接收FIFO读入主控端接收缓存，缓存满时数据留在FIFO中
+      if(rxBufferCount() >= _rxBufferSize - 1){
+          _ringStats.rxFull++;
+      }else{
+          fillRxBuffer();
+      }
+      uint16_t used = rxBufferCount();
+      if(used > _ringStats.rxHighWater){
+          _ringStats.rxHighWater = used;
+      }
+  }
+#endif
+  int total = 0;
+  while(txBufferCount() && !_peerXoff){
+      int space = _txFree ? _txFree : getTxFifoSpace();
+      if(space <= 0){
+          break;
+      }
+      //环形队列分两段连续空间写入；头指针由写入方修改，读一次后按这个值计算
+      uint16_t head = IIC_SERIAL_RING_LOAD(_txBufferHead);
+      uint16_t len = (head > _txBufferTail) ? (head - _txBufferTail) : (_txBufferSize - _txBufferTail);
+      if(len > space){
+          len = space;
+      }
+      size_t n = writeFifo(_pTxBuffer + _txBufferTail, len);
+      IIC_SERIAL_RING_STORE(_txBufferTail, (uint16_t)((_txBufferTail + n) % _txBufferSize));
+      _txFree = (n < _txFree) ? (_txFree - n) : 0;
+      total += n;
+      if(n != len){
+          break;
+      }
+  }
+  //队列中还有数据时打开发送FIFO触点中断，FIFO低于触点时由service()继续补充；SIER有缓存，未改变时不访问总线
+  uint8_t sier = getSier();
+  if((txBufferCount() && !_peerXoff) || _bfState == eBfData){
+      sier |= IIC_SERIAL_INT_TFTRIG;
+  }else{
+      sier &= ~IIC_SERIAL_INT_TFTRIG;
+  }
+  if(_bfState == eBfDrain){
+      //发送FIFO空时继续发Break
+      sier |= IIC_SERIAL_INT_TFEMPTY;
+  }
+  if(total && _txEmptyNotify){
+      sier |= IIC_SERIAL_INT_TFEMPTY;
+  }
+  writeSier(sier);
+  return total;
+}
+
+#if IIC_SERIAL_ENABLE_RTOS
+void DFRobot_IIC_Serial::setTaskMode(bool enable){
+  _taskMode = enable;
+}
+#endif
+
+void DFRobot_IIC_Serial::flush(void){
+  if(_pChip == NULL){
+      return;
+  }
+  if(taskMode()){
+      //发送FIFO的状态由总线任务访问，这里只等发送队列被总线任务取空
+      while(txBufferCount()){
+          waitBusTask();
+      }
+      return;
+  }
+  sStatus_t st;
+  unsigned long pausedAt = millis();
+  while(true){
+      if(txBufferCount() && _peerXoff){
+          //对端暂停时poll()不发送队列中的数据，继续读取接收FIFO才能收到XON
+          fillRxBuffer();
+          if(_peerXoff && millis() - pausedAt >= _timeout){
+              DBG("peer paused, flush timeout");
+              return;
+          }
+      }else{
+          pausedAt = millis();
+      }
+      poll();
+      if(status(&st) != ERR_OK){
+          return;
+      }
+      if(txBufferCount() == 0 && st.fsr.tDat == 0 && st.fsr.tBusy == 0){
+          return;
+      }
+      //按波特率估算发送FIFO中的数据发完所需的时间(每字符至少10位)，期间不访问总线
+      unsigned long waitUs = _baud ? (st.txCount * 10000000UL / _baud) : 0;
+      if(waitUs >= 2000){
+          delay(waitUs / 1000);
+      }else{
+          yield();
+      }
+  }
+}
+
+void DFRobot_IIC_Serial::setTxEmptyNotify(bool enable){
+  _txEmptyNotify = enable;
+  if(_pChip == NULL){
+      return;
+  }
+  if(enable){
+      writeSier(getSier() | IIC_SERIAL_INT_TFEMPTY);
+  }else{
+      writeSier(getSier() & ~IIC_SERIAL_INT_TFEMPTY);
+  }
+}
+
+void DFRobot_IIC_Serial::setFifoTrigger(eFifoTrigger_t rx, eFifoTrigger_t tx){
+  if(_pChip == NULL){
+      DBG("begin() not called!");
+      return;
+  }
+  DFRobot_WK2132_Guard guard(_pChip);
+  setFifoTriggerLevel(0, 0);
+  sFcrReg_t fcr = {.rfRst = 0x00, .tfRst = 0x00, .rfEn = 0x00, .tfEn = 0x00, .rfTrig = (uint8_t)rx, .tfTrig = (uint8_t)tx};
+  _pChip->subSerialRegUpdate(_subSerialChannel, page0, REG_WK2132_FCR, 0xf0, *(uint8_t *)&fcr);
+}
+
+void DFRobot_IIC_Serial::setFifoTriggerLevel(uint8_t rxLevel, uint8_t txLevel){
+  if(_pChip == NULL){
+      DBG("begin() not called!");
+      return;
+  }
+  DFRobot_WK2132_Guard guard(_pChip);
+  _pChip->subSerialRegUpdate(_subSerialChannel, page1, REG_WK2132_RFTL, 0xff, rxLevel);
+  _pChip->subSerialRegUpdate(_subSerialChannel, page1, REG_WK2132_TFTL, 0xff, txLevel);
+  _pChip->subSerialPageSwitch(_subSerialChannel, page0);
+}
+
+void DFRobot_IIC_Serial::writeSier(uint8_t sier){
+  _pChip->subSerialRegUpdate(_subSerialChannel, page0, REG_WK2132_SIER, 0xff, sier);
+}
+
+uint8_t DFRobot_IIC_Serial::getSier(void){
+  return _pChip->subSerialRegShadow(_subSerialChannel, page0, REG_WK2132_SIER);
+}
+
+uint8_t DFRobot_IIC_Serial::getRxTriggerLevel(void){
+  DFRobot_WK2132_Guard guard(_pChip);
+  uint8_t level = _pChip->subSerialRegShadow(_subSerialChannel, page1, REG_WK2132_RFTL);
+  if(level == 0){
+      static const uint8_t preset[] = {8, 16, 24, 28};
+      level = preset[(_pChip->subSerialRegShadow(_subSerialChannel, page0, REG_WK2132_FCR) >> 4) & 0x03];
+  }
+  return level;
+}
+uint8_t DFRobot_IIC_Serial::serviceInterrupt(void){
+  uint8_t sifr = 0;
+  _pChip->subSerialPageSwitch(_subSerialChannel, page0);
+  if(readReg(REG_WK2132_SIFR, &sifr, 1) != 1){
+      DBG("READ BYTE SIZE ERROR!");
+      return 0;
+  }
+  sifr &= getSier();
+  if((sifr & IIC_SERIAL_INT_FERR) && !_pChip->_burstRead){
+      //不支持连续读取时读数据前不读FSR，只在有错误中断时补读一次
+      readFIFOStateReg();
+  }
+  if(sifr & (IIC_SERIAL_INT_RFTRIG | IIC_SERIAL_INT_RXOVT | IIC_SERIAL_INT_FERR)){
+      if(_frameMode){
+          serviceFrame(sifr);
+      }else{
+          fillRxBuffer();
+      }
+  }
+  if(sifr & IIC_SERIAL_INT_TFEMPTY){
+      //发送FIFO空中断在重新写入数据前一直有效，通知一次后关闭
+      writeSier(getSier() & ~IIC_SERIAL_INT_TFEMPTY);
+  }
+  if((sifr & (IIC_SERIAL_INT_TFTRIG | IIC_SERIAL_INT_TFEMPTY)) && (txBufferCount() || _bfState != eBfIdle)){
+      //发送队列中还有数据，发送并未完成，不通知发送FIFO空
+      poll();
+      sifr &= ~IIC_SERIAL_INT_TFEMPTY;
+  }
+  if(_intCb && sifr){
+      _intCb(this, sifr);
+  }
+  return sifr;
+}
+
+void DFRobot_IIC_Serial::serviceFrame(uint8_t sifr){
+  if(_frameCount >= IIC_SERIAL_FRAME_NUM){
+      //排队的帧已满，数据留在接收FIFO中，IRQ保持有效，readFrame()取走帧后继续处理
+      return;
+  }
+  sStatus_t st;
+  if(status(&st) != ERR_OK){
+      return;
+  }
+  //FSR的高4位是接收FIFO中所有数据的错误汇总，位顺序与LSR相同
+  _frameErr |= (*(uint8_t *)&st.fsr >> 4) & 0x0f;
+  if(st.rxCount == 0){
+      if(sifr & IIC_SERIAL_INT_RXOVT){
+          closeFrame(0);
+      }
+      return;
+  }
+  uint16_t n = fillRxBuffer(st.rxCount);
+  if(n < st.rxCount){
+      //主控端缓存放不下整帧，且没有完整的帧可以让出空间时，截断当前帧
+      if(_frameCount == 0 && n == 0){
+          closeFrame(IIC_SERIAL_FRAME_OVERRUN);
+      }
+      return;
+  }
+  if(sifr & IIC_SERIAL_INT_RXOVT){
+      closeFrame(0);
+  }
+}
+void DFRobot_IIC_Serial::closeFrame(uint8_t flags){
+  if(_frameOpen == 0){
+      return;
+  }
+  uint8_t index = (_frameHead + _frameCount) % IIC_SERIAL_FRAME_NUM;
+  _frameLen[index] = _frameOpen;
+  _frameFlags[index] = _frameErr | flags;
+  _frameCount++;
+  _frameOpen = 0;
+  //被截断的帧剩下的部分也带上截断标志
+  _frameErr = flags & IIC_SERIAL_FRAME_OVERRUN;
+  if(_frameCb){
+      _frameCb(this, _frameLen[index], _frameFlags[index]);
+  }
+}
+void DFRobot_IIC_Serial::resetFrames(void){
+  _frameOpen = 0;
+  _frameErr = 0;
+  _frameHead = 0;
+  _frameCount = 0;
+}
+void DFRobot_IIC_Serial::setFrameMode(bool enable){
+  _frameMode = enable;
+  _rxBufferHead = 0;
+  _rxBufferTail = 0;
+  resetFrames();
+}
+int DFRobot_IIC_Serial::frameAvailable(void){
+  if(_frameCount == 0 && _frameMode && _pChip && _pChip->_irqPin == 0xff){
+      //没有接IRQ引脚时查询一次中断标志，接收超时后帧即结束
+      serviceInterrupt();
+  }
+  return _frameCount;
+}
+uint16_t DFRobot_IIC_Serial::readFrame(uint8_t *pBuf, uint16_t maxLen, uint8_t *pFlags){
+  if(frameAvailable() == 0){
+      return 0;
+  }
+  uint16_t len = _frameLen[_frameHead];
+  uint8_t flags = _frameFlags[_frameHead];
+  _frameHead = (_frameHead + 1) % IIC_SERIAL_FRAME_NUM;
+  _frameCount--;
+  uint16_t count = 0;
+  for(uint16_t i = 0; i < len; i++){
+      uint8_t c = _pRxBuffer[_rxBufferTail];
+      _rxBufferTail = (_rxBufferTail + 1) % _rxBufferSize;
+      if(pBuf && count < maxLen){
+          pBuf[count++] = c;
+      }
+  }
+  if(len > maxLen){
+      flags |= IIC_SERIAL_FRAME_OVERRUN;
+  }
+  if(pFlags){
+      *pFlags = flags;
+  }
+  return count;
+}
+size_t DFRobot_IIC_Serial::write(const uint8_t *pBuf, size_t size){
+  if(pBuf == NULL){
+      DBG("pBuf ERROR!! : null pointer");
+      return 0;
+  }
+  if(taskMode()){
+      //任务模式下只写发送队列，阻塞写时等总线任务取走数据腾出空间
+      size_t count = queueTx(pBuf, size);
+      unsigned long startMillis = millis();
+      while(count < size && _writePolicy == eWriteBlocking && millis() - startMillis < _timeout){
+          waitBusTask();
+          size_t n = queueTx(pBuf + count, size - count);
+          if(n){
+              count += n;
+              startMillis = millis();
+          }
+      }
+      return count;
+  }
+  if(_peerXoff){
+      //对端暂停期间只写主控端发送队列；阻塞写时继续读取接收FIFO，收到XON后由setPeerPaused()把队列写入发送FIFO
+      size_t count = queueTx(pBuf, size);
+      unsigned long startMillis = millis();
+      while(count < size && _peerXoff && _writePolicy == eWriteBlocking && millis() - startMillis < _timeout){
+          fillRxBuffer();
+          yield();
+          count += queueTx(pBuf + count, size - count);
+      }
+      if(count < size && !_peerXoff){
+          //等待期间已恢复：队列没写完时后续数据继续排队，保持顺序
+          count += txBufferCount() ? queueTx(pBuf + count, size - count) : write(pBuf + count, size - count);
+      }
+      return count;
+  }
+  if(_writePolicy == eWriteAsync){
+      size_t n = queueTx(pBuf, size);
+      poll();
+      return n;
+  }
+  if(txBufferCount()){
+      //对端恢复(XON)时只poll()了一次，队列中可能还有数据：阻塞写先把队列发完，否则追加到队列，保持写入顺序
+      if(_writePolicy == eWriteBlocking){
+          drainTxBuffer();
+      }
+      if(_peerXoff){
+          return write(pBuf, size);
+      }
+      if(txBufferCount()){
+          size_t n = queueTx(pBuf, size);
+          poll();
+          return n;
+      }
+  }
+  size_t count = 0;
+  unsigned long startMillis = millis();
+  while(count < size){
+      int space = _txFree ? _txFree : getTxFifoSpace();
+      if(space > 0){
+          size_t len = ((size - count) > (size_t)space) ? (size_t)space : (size - count);
+          size_t n = writeFifo(pBuf + count, len);
+          count += n;
+          _txFree = (n < _txFree) ? (_txFree - n) : 0;
+          if(n != len){
+              break;
+          }
+          startMillis = millis();
+          continue;
+      }
+#if IIC_SERIAL_ENABLE_STATS
+      _stats.fifoFull++;
+#endif
+      if(space < 0 || _writePolicy == eWritePartial){
+          break;
+      }
+      if(millis() - startMillis >= _timeout){
+          DBG("FIFO full!");
+          break;
+      }
+      yield();
+  }
+  if(count && _txEmptyNotify && !(getSier() & IIC_SERIAL_INT_TFEMPTY)){
+      writeSier(getSier() | IIC_SERIAL_INT_TFEMPTY);
+  }
+  return count;
+}
+
+int DFRobot_IIC_Serial::availableForWrite(void){
+  if(_writePolicy == eWriteAsync || taskMode() || _peerXoff){
+      return _txBufferSize - 1 - txBufferCount();
+  }
+  return getTxFifoSpace();
+}
+
+int DFRobot_IIC_Serial::getTxFifoSpace(void){
+  sStatus_t st;
+  if(_pChip && _pChip->_burstRead){
+      if(status(&st) != ERR_OK){
+          return -1;
+      }
+      return _txFree;
+  }
+  uint8_t val = 0;
+  sFsrReg_t fsr;
+  if(readReg(REG_WK2132_TFCNT, &val, 1) != 1){
+      DBG("READ BYTE SIZE ERROR!");
+      return -1;
+  }
+  st.txCount = val;
+  if(val == 0){
+      fsr = readFIFOStateReg();
+      //计数为0且FIFO非空按满处理，避免读TFCNT和FSR之间发出1个字节时误判为空
+      if(fsr.tDat == 1){
+          st.txCount = 256;
+      }
+  }
+  _txFree = 256 - st.txCount;
+  return _txFree;
+}
+
+
+void DFRobot_IIC_Serial::subSerialConfig(uint8_t subUartChannel){
+  DBG("子串口时钟使能");
+  _pChip->subSerialGlobalRegEnable(subUartChannel, clock);
+  DBG("软件复位子串口");
+  _pChip->subSerialGlobalRegEnable(subUartChannel, rst);
+  DBG("子串口全局中断使能");
+  _pChip->subSerialGlobalRegEnable(subUartChannel, intrpt);
+  
+  DBG("子串口中断配置");
+  //发送FIFO触点/空中断在FIFO为空时一直有效，会使IRQ引脚常低，只在需要时(setTxEmptyNotify)打开
+  sSierReg_t sier = {.rFTrig = 0x01, .rxOvt = 0x01, .tfTrig = 0x00, .tFEmpty = 0x00, .rsv = 0x00, .fErr = 0x01};
+  _pChip->subSerialRegConfig(subUartChannel, page0, REG_WK2132_SIER, &sier);
+  DBG("使能发送/接收FIFO");
+  sFcrReg_t fcr = {.rfRst = 0x01, .tfRst = 0x00, .rfEn = 0x01, .tfEn = 0x01, .rfTrig = 0x00, .tfTrig = 0x00};
+  _pChip->subSerialRegConfig(subUartChannel, page0, REG_WK2132_FCR, &fcr);
+}
+
+//标准波特率在默认晶振下的分频值，编译期生成
+static const struct{
+  unsigned long baud;
+  sBaudDivisor_t div;
+} IIC_SERIAL_PROGMEM baudTable[] = {
+  {1200,   wk2132BaudDivisor(IIC_SERIAL_FOSC, 1200)},
+  {2400,   wk2132BaudDivisor(IIC_SERIAL_FOSC, 2400)},
+  {4800,   wk2132BaudDivisor(IIC_SERIAL_FOSC, 4800)},
+  {9600,   wk2132BaudDivisor(IIC_SERIAL_FOSC, 9600)},
+  {19200,  wk2132BaudDivisor(IIC_SERIAL_FOSC, 19200)},
+  {38400,  wk2132BaudDivisor(IIC_SERIAL_FOSC, 38400)},
+  {57600,  wk2132BaudDivisor(IIC_SERIAL_FOSC, 57600)},
+  {115200, wk2132BaudDivisor(IIC_SERIAL_FOSC, 115200)},
+  {230400, wk2132BaudDivisor(IIC_SERIAL_FOSC, 230400)},
+  {460800, wk2132BaudDivisor(IIC_SERIAL_FOSC, 460800)},
+  {921600, wk2132BaudDivisor(IIC_SERIAL_FOSC, 921600)},
+};
+
+sBaudDivisor_t DFRobot_IIC_Serial::baudDivisor(unsigned long baud){
+  unsigned long fosc = _pChip->getFosc();
+  if(baud * 16 > fosc){
+      DBG("baud rate over FOSC/16, use the highest rate");
+  }
+  if(fosc == IIC_SERIAL_FOSC){
+      for(uint8_t i = 0; i < sizeof(baudTable) / sizeof(baudTable[0]); i++){
+          unsigned long tableBaud;
+          IIC_SERIAL_READ_PROGMEM(&tableBaud, &baudTable[i].baud, sizeof(tableBaud));
+          if(tableBaud == baud){
+              sBaudDivisor_t div;
+              IIC_SERIAL_READ_PROGMEM(&div, &baudTable[i].div, sizeof(div));
+              return div;
+          }
+      }
+  }
+  return wk2132BaudDivisor(fosc, baud);
+}
+unsigned long DFRobot_IIC_Serial::getActualBaud(long *pErrorPpm){
+  if(_pChip == NULL || _baud == 0){
+      return 0;
+  }
+  DFRobot_WK2132_Guard guard(_pChip);
+  uint32_t tenths = ((uint32_t)_pChip->subSerialRegShadow(_subSerialChannel, page1, REG_WK2132_BAUD1) << 8) |
+                    _pChip->subSerialRegShadow(_subSerialChannel, page1, REG_WK2132_BAUD0);
+  tenths = tenths * 10 + (_pChip->subSerialRegShadow(_subSerialChannel, page1, REG_WK2132_PRES) & 0x0f);
+  _pChip->subSerialPageSwitch(_subSerialChannel, page0);
+  uint32_t den = 16UL * (tenths + 10);
+  unsigned long fosc = _pChip->getFosc();
+  if(pErrorPpm){
+      *pErrorPpm = (long)(((int64_t)fosc * 10 - (int64_t)_baud * den) * 1000000LL / ((int64_t)_baud * den));
+  }
+  return (fosc * 10UL + den / 2) / den;
+}
+void DFRobot_IIC_Serial::setSubSerialBaudRate(uint8_t subUartChannel, unsigned long baud){
+  setSubSerialDivisor(baud, baudDivisor(baud));
+}
+void DFRobot_IIC_Serial::setSubSerialDivisor(unsigned long baud, sBaudDivisor_t div){
+  _baud = baud;
+  DFRobot_WK2132_Guard guard(_pChip);
+  if(_pChip->subSerialRegShadow(_subSerialChannel, page1, REG_WK2132_BAUD1) == div.baud1 &&
+     _pChip->subSerialRegShadow(_subSerialChannel, page1, REG_WK2132_BAUD0) == div.baud0 &&
+     _pChip->subSerialRegShadow(_subSerialChannel, page1, REG_WK2132_PRES) == div.pres){
+      //分频值未改变，不打断收发
+      _pChip->subSerialPageSwitch(_subSerialChannel, page0);
+      return;
+  }
+  //修改波特率前先关闭收发，配置完成后只恢复收发使能位
+  uint8_t scr = _pChip->subSerialRegShadow(_subSerialChannel, page0, REG_WK2132_SCR);
+  _pChip->subSerialRegUpdate(_subSerialChannel, page0, REG_WK2132_SCR, 0x03, 0x00);
+  _pChip->subSerialRegUpdate(_subSerialChannel, page1, REG_WK2132_BAUD1, 0xff, div.baud1);
+  _pChip->subSerialRegUpdate(_subSerialChannel, page1, REG_WK2132_BAUD0, 0xff, div.baud0);
+  _pChip->subSerialRegUpdate(_subSerialChannel, page1, REG_WK2132_PRES, 0x0f, div.pres);
+  _pChip->subSerialRegUpdate(_subSerialChannel, page0, REG_WK2132_SCR, 0x03, scr);
+  _pChip->subSerialPageSwitch(_subSerialChannel, page0);
+  DBG(div.baud1, HEX);
+  DBG(div.baud0, HEX);
+  DBG(div.pres, HEX);
+}
+
+void DFRobot_IIC_Serial::setSubSerialConfigReg(uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt){
+  sLcrReg_t lcr = {.format = format, .irEn = (uint8_t)mode, .lBreak = (uint8_t)opt, .rsv = 0x00};
+  DBG("lcr: "); DBG(*(uint8_t *)&lcr, HEX);
+  _pChip->subSerialRegUpdate(_subSerialChannel, page0, REG_WK2132_LCR, 0x3f, *(uint8_t *)&lcr);
+}
+
+DFRobot_IIC_Serial::sFsrReg_t DFRobot_IIC_Serial::readFIFOStateReg(){
+  sFsrReg_t fsr;
+  readReg(REG_WK2132_FSR, &fsr, sizeof(fsr));
+  noteFsr(*(uint8_t *)&fsr);
+  return fsr;
+}
+
+int DFRobot_IIC_Serial::writeReg(uint8_t reg, const void* pBuf, size_t size){
+  if(_pChip == NULL){
+      DBG("begin() not called!");
+      return ERR_DATA_WRITE;
+  }
+  return _pChip->writeReg(_subSerialChannel, reg, pBuf, size);
+}
+
+uint8_t DFRobot_IIC_Serial::readReg(uint8_t reg, void* pBuf, size_t size){
+  if(_pChip == NULL){
+      DBG("begin() not called!");
+      return 0;
+  }
+  return _pChip->readReg(_subSerialChannel, reg, pBuf, size);
+}
+
+size_t DFRobot_IIC_Serial::readFifoCache(void* pBuf, size_t size){
+  if(_pChip == NULL){
+      DBG("begin() not called!");
+      return 0;
+  }
+  return _pChip->readFifo(_subSerialChannel, pBuf, size);
+}
+
+size_t DFRobot_IIC_Serial::writeFifo(const void* pBuf, size_t size){
+  if(_pChip == NULL){
+      DBG("begin() not called!");
+      return 0;
+  }
+  return _pChip->writeFifo(_subSerialChannel, pBuf, size);
+}
+
+DFRobot_WK2132 *DFRobot_WK2132::_chipList[IIC_SERIAL_CHIP_NUM];
+#if IIC_SERIAL_ENABLE_RTOS
+DFRobot_WK2132::sBus_t DFRobot_WK2132::_busList[IIC_SERIAL_BUS_NUM];
+#endif
+
+DFRobot_WK2132::DFRobot_WK2132(TwoWire &wire, uint8_t addr){
+  _pWire = &wire;
+  _addr = addr << 3;
+  _ready = false;
+  _autoCreated = false;
+  _page[0] = 0xff;
+  _page[1] = 0xff;
+  _gena = 0;
+  _gier = 0;
+  _globalValid = 0;
+  _regValid[0] = 0;
+  _regValid[1] = 0;
+  _verify = false;
+  _burstRead = false;
+  _burstProbed = false;
+  _channel[0] = NULL;
+  _channel[1] = NULL;
+  _irqPin = 0xff;
+  _irqFlag = false;
+  _fosc = IIC_SERIAL_FOSC;
+  _retries = IIC_SERIAL_RETRIES;
+  _backoffUs = IIC_SERIAL_BACKOFF_US;
+  _sdaPin = 0xff;
+  _sclPin = 0xff;
+  _failCount = 0;
+  _offline = false;
+  _offlineAt = 0;
+  _holdUs = IIC_SERIAL_HOLD_MIN_US;
+  _errorCount = 0;
+  _lastErr = ERR_OK;
+#if IIC_SERIAL_ENABLE_TRACE
+  _traceHead = 0;
+  _traceCount = 0;
+#endif
+#if IIC_SERIAL_ENABLE_RTOS
+  _pBus = findBus(_pWire);
+#endif
+  for(uint8_t i = 0; i < IIC_SERIAL_CHIP_NUM; i++){
+      if(_chipList[i] == NULL){
+          _chipList[i] = this;
+          break;
+      }
+  }
+}
+
+DFRobot_WK2132::~DFRobot_WK2132(){
+  for(uint8_t i = 0; i < IIC_SERIAL_CHIP_NUM; i++){
+      if(_chipList[i] == this){
+          _chipList[i] = NULL;
+      }
+  }
+  for(uint8_t i = 0; i < 2; i++){
+      if(_channel[i] && _channel[i]->_pChip == this){
+          _channel[i]->_pChip = NULL;
+      }
+  }
+}
+
+int DFRobot_WK2132::begin(void){
+  DFRobot_WK2132_Guard guard(this);
+  if(_ready){
+      return ERR_OK;
+  }
+  _pWire->begin();
+  uint8_t val = 0;
+  if(readReg(SUBUART_CHANNEL_1, REG_WK2132_GENA, &val, 1) != 1){
+      DBG("READ BYTE SIZE ERROR!");
+      return _lastErr;
+  }
+  if((val >> 6) != 0x02){
+      DBG("");
+      return ERR_DATA_BUS;
+  }
+  _gena = val;
+  _globalValid |= 0x01;
+  _ready = true;
+  return ERR_OK;
+}
+
+DFRobot_IIC_Serial *DFRobot_WK2132::channel(uint8_t subUartChannel){
+  if(subUartChannel > SUBUART_CHANNEL_2){
+      return NULL;
+  }
+  return _channel[subUartChannel];
+}
+
+DFRobot_WK2132 *DFRobot_WK2132::find(TwoWire &wire, uint8_t addr){
+  for(uint8_t i = 0; i < IIC_SERIAL_CHIP_NUM; i++){
+      if(_chipList[i] && (_chipList[i]->_pWire == &wire) && (_chipList[i]->_addr == (uint8_t)(addr << 3))){
+          return _chipList[i];
+      }
+  }
+  return NULL;
+}
+
+int DFRobot_WK2132::attachInterruptPin(uint8_t pin){
+  uint8_t index = 0;
+  while(index < IIC_SERIAL_CHIP_NUM && _chipList[index] != this){
+      index++;
+  }
+  _irqPin = pin;
+  //先置位标志，处理引脚接入前已经挂起的中断
+  _irqFlag = true;
+  if(index >= IIC_SERIAL_CHIP_NUM){
+      DBG("no free irq handler, call handleInterrupt() in your own ISR");
+      return ERR_ADDR;
+  }
+  pinMode(pin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(pin), sIrqTable<IIC_SERIAL_CHIP_NUM>::handler(index), FALLING);
+  return ERR_OK;
+}
+
+int DFRobot_WK2132::service(void){
+  if(_irqPin != 0xff && !_irqFlag){
+      return 0;
+  }
+  _irqFlag = false;
+  uint8_t gifr = 0;
+  if(readReg(SUBUART_CHANNEL_1, REG_WK2132_GIFR, &gifr, 1) != 1){
+      DBG("READ BYTE SIZE ERROR!");
+      _irqFlag = true;
+      return 0;
+  }
+  int count = 0;
+  for(uint8_t i = 0; i < 2; i++){
+      if((gifr & (1 << i)) && _channel[i]){
+          _channel[i]->serviceInterrupt();
+          count++;
+      }
+  }
+  //IRQ为低电平有效，仍为低说明还有未清除的中断源(如主控端缓存已满)，下次继续处理
+  if(_irqPin != 0xff && digitalRead(_irqPin) == LOW){
+      _irqFlag = true;
+  }
+  return count;
+}
+
+void DFRobot_WK2132::attachChannel(DFRobot_IIC_Serial *pSerial){
+  if(pSerial->_subSerialChannel > SUBUART_CHANNEL_2){
+      DBG("SUBSERIAL CHANNEL NUMBER ERROR!");
+      return;
+  }
+  _channel[pSerial->_subSerialChannel] = pSerial;
+}
 
-void DFRobot_IIC_Serial::subSerialConfig(uint8_t subUartChannel){
-  DBG("子串口时钟使能");
-  subSerialGlobalRegEnable(subUartChannel, clock);
-  DBG("软件复位子串口");
-  subSerialGlobalRegEnable(subUartChannel, rst);
-  DBG("子串口全局中断使能");
-  subSerialGlobalRegEnable(subUartChannel, intrpt);
-  
-  DBG("子串口中断配置");
-  sSierReg_t sier = {.rFTrig = 0x01, .rxOvt = 0x01, .tfTrig = 0x01, .tFEmpty = 0x01, .rsv = 0x00, .fErr = 0x01};
-  subSerialRegConfig(subUartChannel, page0, REG_WK2132_SIER, &sier);
-  DBG("使能发送/接收FIFO");
-  sFcrReg_t fcr = {.rfRst = 0x01, .tfRst = 0x00, .rfEn = 0x01, .tfEn = 0x01, .rfTrig = 0x00, .tfTrig = 0x00};
-  subSerialRegConfig(subUartChannel, page0, REG_WK2132_FCR, &fcr);
-  DBG("子串口接收/发送使能");
-  sScrReg_t scr = {.rxEn = 0x01, .txEn = 0x01, .sleepEn = 0x00, .rsv = 0x00 };
-  subSerialRegConfig(subUartChannel, page0, REG_WK2132_SCR, &scr);
+void DFRobot_WK2132::detachChannel(DFRobot_IIC_Serial *pSerial){
+  for(uint8_t i = 0; i < 2; i++){
+      if(_channel[i] == pSerial){
+          _channel[i] = NULL;
+      }
+  }
+  //由通道对象自动创建的芯片对象，在最后一个通道释放时一并释放
+  if(_autoCreated && _channel[0] == NULL && _channel[1] == NULL){
+      delete this;
+  }
 }
 
-void DFRobot_IIC_Serial::subSerialGlobalRegEnable(uint8_t subUartChannel, eGlobalRegType_t type){
+void DFRobot_WK2132::subSerialGlobalRegEnable(uint8_t subUartChannel, eGlobalRegType_t type){
   if(subUartChannel > SUBUART_CHANNEL_ALL)
   {
       DBG("SUBSERIAL CHANNEL NUMBER ERROR!");
       return;
   }
-  uint8_t val = 0;
+  uint8_t mask = 0;
   uint8_t regAddr = getGlobalRegType(type);
-  _addr = updateAddr(_addr, SUBUART_CHANNEL_1, OBJECT_REGISTER);
   DBG("reg");DBG(regAddr, HEX);
-  if(readReg(regAddr, &val, 1) != 1){
-        DBG("READ BYTE SIZE ERROR!");
-      return;//ERR_DATA_READ;
-  }
-  DBG("before:");DBG(val, HEX);
   switch(subUartChannel){
       case SUBUART_CHANNEL_1:
-                             val |= 0x01;
+                             mask = 0x01;
                              break;
       case SUBUART_CHANNEL_2:
-                             val |= 0x02;
+                             mask = 0x02;
                              break;
       default:
-              val |= 0x03;
+              mask = 0x03;
               break;
   }
-  writeReg(regAddr, &val, 1);
-  readReg(regAddr, &val, 1);
-  DBG("after:");DBG(val, HEX);
+  DFRobot_WK2132_Guard guard(this);
+  if(type == DFRobot_IIC_Serial::rst){
+      //复位位写1后由芯片自动清零，无需读改写；复位后子串口寄存器回到第0页，配置寄存器恢复默认值0
+      writeReg(SUBUART_CHANNEL_1, regAddr, &mask, 1);
+      for(uint8_t i = 0; i < 2; i++){
+          if(mask & (1 << i)){
+              _page[i] = DFRobot_IIC_Serial::page0;
+              memset(_reg[i], 0, IIC_SERIAL_SHADOW_NUM);
+              _regValid[i] = (1 << IIC_SERIAL_SHADOW_NUM) - 1;
+          }
+      }
+      return;
+  }
+  globalRegUpdate(type, mask, mask);
 }
 
-/*void DFRobot_IIC_Serial::subSerialGlobalRegDisable(uint8_t subUartChannel, eGlobalRegType_t type){
-  if(subUartChannel > SUBUART_CHANNEL_ALL)
+void DFRobot_WK2132::subSerialGlobalRegDisable(uint8_t subUartChannel, eGlobalRegType_t type){
+  if(subUartChannel > SUBUART_CHANNEL_ALL || type == DFRobot_IIC_Serial::rst)
   {
-      DBG("SUBSERIAL CHANNEL NUMBER ERROR!");
+      DBG("PARAMETER ERROR!");
       return;
   }
-  uint8_t val = 0;
+  uint8_t mask = (subUartChannel == SUBUART_CHANNEL_ALL) ? 0x03 : (1 << subUartChannel);
+  globalRegUpdate(type, mask, 0);
+}
+
+void DFRobot_WK2132::globalRegUpdate(eGlobalRegType_t type, uint8_t mask, uint8_t value){
+  DFRobot_WK2132_Guard guard(this);
   uint8_t regAddr = getGlobalRegType(type);
-  _addr = updateAddr(_addr, subUartChannel, OBJECT_REGISTER);
-  if(readReg(regAddr, &val, 1) != 1){
-      DBG("READ BYTE SIZE ERROR!");
-      return;//ERR_DATA_READ;
+  uint8_t *pShadow = (type == DFRobot_IIC_Serial::clock) ? &_gena : &_gier;
+  uint8_t validBit = (type == DFRobot_IIC_Serial::clock) ? 0x01 : 0x02;
+  if(!(_globalValid & validBit)){
+      if(readReg(SUBUART_CHANNEL_1, regAddr, pShadow, 1) != 1){
+          DBG("READ BYTE SIZE ERROR!");
+          return;
+      }
+      _globalValid |= validBit;
   }
-  switch(subUartChannel){
-      case SUBUART_CHANNEL_1:
-                             val &= 0xfE;
-                             break;
-      case SUBUART_CHANNEL_2:
-                             val &= 0xFD;
-                             break;
-      default:
-              val &= 0xFC;
-              break;
+  uint8_t val = (*pShadow & ~mask) | (value & mask);
+  if(val == *pShadow){
+      return;
+  }
+  if(writeReg(SUBUART_CHANNEL_1, regAddr, &val, 1) != ERR_OK){
+      _globalValid &= ~validBit;
+      return;
+  }
+  *pShadow = val;
+  if(_verify){
+      //GENA高两位为只读位，只比较子串口对应的位
+      readReg(SUBUART_CHANNEL_1, regAddr, &val, 1);
+      if((val & 0x03) != (*pShadow & 0x03)){
+          DBG("verify error, reg:");DBG(regAddr, HEX);DBG(val, HEX);
+      }
   }
-  writeReg(regAddr, &val, 1);
-  readReg(regAddr, &val, 1);
-  DBG(val, HEX);
 }
-*/
 
-void DFRobot_IIC_Serial::subSerialPageSwitch(uint8_t subUartChannel, ePageNumber_t page){
-  if((_page == page) || (page < page0) || (page >= pageTotal)){
+void DFRobot_WK2132::subSerialPageSwitch(uint8_t subUartChannel, ePageNumber_t page){
+  DFRobot_WK2132_Guard guard(this);
+  if((subUartChannel > SUBUART_CHANNEL_2) || (_page[subUartChannel] == page) || (page < DFRobot_IIC_Serial::page0) || (page >= DFRobot_IIC_Serial::pageTotal)){
       return;
   }
-  uint8_t val = 0;
-  _addr = updateAddr(_addr, subUartChannel, OBJECT_REGISTER);
-  if(readReg(REG_WK2132_SPAGE, &val, 1) != 1){
-      DBG("READ BYTE SIZE ERROR!");
-      return;//ERR_DATA_READ;
+  //SPAGE只有第0位有效，页状态由芯片对象缓存，直接写入目标页即可
+  uint8_t val = (page == DFRobot_IIC_Serial::page1) ? 0x01 : 0x00;
+  if(writeReg(subUartChannel, REG_WK2132_SPAGE, &val, 1) != ERR_OK){
+      //写入是否生效未知，下次访问时重新写SPAGE
+      _page[subUartChannel] = 0xff;
+      return;
   }
-  switch(page){
-      case page0:
-                 val &= 0xFE;
-                 break;
-      case page1:
-                 val |= 0x01;
-                 break;
-      default:
-              break;
+  _page[subUartChannel] = page;
+#if IIC_SERIAL_ENABLE_STATS
+  if(_channel[subUartChannel]){
+      _channel[subUartChannel]->_stats.pageSwitches++;
   }
-  DBG("before: "); DBG(val);
-  writeReg(REG_WK2132_SPAGE, &val, 1);
-  _page = page;
-  readReg(REG_WK2132_SPAGE, &val, 1);
-  DBG("after: ");DBG(val, HEX);
+#endif
+  DBG("page: ");DBG(val, HEX);
 }
 
-void DFRobot_IIC_Serial::subSerialRegConfig(uint8_t subUartChannel, ePageNumber_t page, uint8_t reg, void *pValue){
-  _addr = updateAddr(_addr, subUartChannel, OBJECT_REGISTER);
+void DFRobot_WK2132::subSerialRegConfig(uint8_t subUartChannel, ePageNumber_t page, uint8_t reg, void *pValue){
+  subSerialRegUpdate(subUartChannel, page, reg, 0xff, *(uint8_t *)pValue);
+}
+
+int DFRobot_WK2132::subSerialRegUpdate(uint8_t subUartChannel, ePageNumber_t page, uint8_t reg, uint8_t mask, uint8_t value){
+  DFRobot_WK2132_Guard guard(this);
+  int8_t index = shadowIndex(page, reg);
+  if(subUartChannel > SUBUART_CHANNEL_2 || index < 0){
+      DBG("PARAMETER ERROR!");
+      return ERR_DATA_READ;
+  }
+  //FCR的复位位写1后自动清零，只作为动作写入，不计入缓存
+  uint8_t selfClear = (page == DFRobot_IIC_Serial::page0 && reg == REG_WK2132_FCR) ? 0x03 : 0x00;
+  uint8_t action = value & mask & selfClear;
+  mask &= ~selfClear;
+  uint8_t *pShadow = &_reg[subUartChannel][index];
+  if(!(_regValid[subUartChannel] & (1 << index))){
+      subSerialPageSwitch(subUartChannel, page);
+      if(readReg(subUartChannel, reg, pShadow, 1) != 1){
+          DBG("READ BYTE SIZE ERROR!");
+          return ERR_DATA_READ;
+      }
+      *pShadow &= ~selfClear;
+      _regValid[subUartChannel] |= (1 << index);
+  }
+  uint8_t val = (*pShadow & ~mask) | (value & mask);
+  if(val == *pShadow && action == 0){
+      return ERR_OK;
+  }
   subSerialPageSwitch(subUartChannel, page);
-  uint8_t val = 0;
-  readReg(reg, &val, 1);
-  DBG("before: "); DBG(val);
-  val |= *(uint8_t *)pValue;
-  writeReg(reg, &val, 1);
-  readReg(reg, &val, 1);
-  DBG("after: ");DBG(val, HEX);
+  *pShadow = val;
+  val |= action;
+  if(writeReg(subUartChannel, reg, &val, 1) != ERR_OK){
+      //写入是否生效未知，缓存作废，下次访问时重新读取
+      _regValid[subUartChannel] &= ~(1 << index);
+      return _lastErr;
+  }
+  if(_verify){
+      readReg(subUartChannel, reg, &val, 1);
+      if(val != *pShadow){
+          DBG("verify error, reg:");DBG(reg, HEX);DBG(val, HEX);
+          return ERR_DATA_READ;
+      }
+  }
+  return ERR_OK;
+}
+
+uint8_t DFRobot_WK2132::subSerialRegShadow(uint8_t subUartChannel, ePageNumber_t page, uint8_t reg){
+  DFRobot_WK2132_Guard guard(this);
+  int8_t index = shadowIndex(page, reg);
+  if(subUartChannel > SUBUART_CHANNEL_2 || index < 0){
+      DBG("PARAMETER ERROR!");
+      return 0;
+  }
+  if(!(_regValid[subUartChannel] & (1 << index))){
+      subSerialPageSwitch(subUartChannel, page);
+      if(readReg(subUartChannel, reg, &_reg[subUartChannel][index], 1) != 1){
+          DBG("READ BYTE SIZE ERROR!");
+          return 0;
+      }
+      _regValid[subUartChannel] |= (1 << index);
+  }
+  return _reg[subUartChannel][index];
+}
+
+void DFRobot_WK2132::probeBurstRead(uint8_t subUartChannel){
+  DFRobot_WK2132_Guard guard(this);
+  if(_burstProbed || subUartChannel > SUBUART_CHANNEL_2){
+      return;
+  }
+  uint8_t expect[4], val[4];
+  for(uint8_t i = 0; i < 4; i++){
+      expect[i] = subSerialRegShadow(subUartChannel, DFRobot_IIC_Serial::page0, REG_WK2132_SCR + i);
+  }
+  subSerialPageSwitch(subUartChannel, DFRobot_IIC_Serial::page0);
+  if(readReg(subUartChannel, REG_WK2132_SCR, val, 4) != 4){
+      DBG("READ BYTE SIZE ERROR!");
+      return;
+  }
+  //不支持自动递增时读到的是4个相同的SCR，缓存的4个值相同时无法区分，留到下次检测
+  if(expect[0] == expect[1] && expect[1] == expect[2] && expect[2] == expect[3]){
+      return;
+  }
+  _burstRead = (memcmp(expect, val, 4) == 0);
+  _burstProbed = true;
+  DBG("burst read: ");DBG(_burstRead);
+}
+
+int DFRobot_WK2132::loadShadows(uint8_t subUartChannel){
+  DFRobot_WK2132_Guard guard(this);
+  if(subUartChannel > SUBUART_CHANNEL_2){
+      return ERR_DATA_READ;
+  }
+  uint8_t val[4];
+  subSerialPageSwitch(subUartChannel, DFRobot_IIC_Serial::page0);
+  if(readReg(subUartChannel, REG_WK2132_SCR, val, 4) != 4){
+      DBG("READ BYTE SIZE ERROR!");
+      return ERR_DATA_READ;
+  }
+  //不支持自动递增时读到4个相同的SCR；读到不同的值即确认支持，否则逐个补读
+  if(!(val[0] == val[1] && val[1] == val[2] && val[2] == val[3])){
+      _burstRead = true;
+      _burstProbed = true;
+  }
+  if(!_burstRead){
+      for(uint8_t i = 1; i < 4; i++){
+          if(readReg(subUartChannel, REG_WK2132_SCR + i, &val[i], 1) != 1){
+              DBG("READ BYTE SIZE ERROR!");
+              return ERR_DATA_READ;
+          }
+      }
+  }
+  memcpy(&_reg[subUartChannel][0], val, 4);
+  uint8_t val1[5];
+  subSerialPageSwitch(subUartChannel, DFRobot_IIC_Serial::page1);
+  if(_burstRead){
+      if(readReg(subUartChannel, REG_WK2132_BAUD1, val1, 5) != 5){
+          DBG("READ BYTE SIZE ERROR!");
+          return ERR_DATA_READ;
+      }
+  }else{
+      for(uint8_t i = 0; i < 5; i++){
+          if(readReg(subUartChannel, REG_WK2132_BAUD1 + i, &val1[i], 1) != 1){
+              DBG("READ BYTE SIZE ERROR!");
+              return ERR_DATA_READ;
+          }
+      }
+  }
+  memcpy(&_reg[subUartChannel][4], val1, 5);
+  _regValid[subUartChannel] = (1 << IIC_SERIAL_SHADOW_NUM) - 1;
+  subSerialPageSwitch(subUartChannel, DFRobot_IIC_Serial::page0);
+  return ERR_OK;
+}
+int8_t DFRobot_WK2132::shadowIndex(ePageNumber_t page, uint8_t reg){
+  if(page == DFRobot_IIC_Serial::page0 && reg >= REG_WK2132_SCR && reg <= REG_WK2132_SIER){
+      return reg - REG_WK2132_SCR;
+  }
+  if(page == DFRobot_IIC_Serial::page1 && reg >= REG_WK2132_BAUD1 && reg <= REG_WK2132_TFTL){
+      return reg - REG_WK2132_BAUD1 + 4;
+  }
+  return -1;
 }
 
-uint8_t DFRobot_IIC_Serial::getGlobalRegType(eGlobalRegType_t type){
-  if((type < clock) || (type > intrpt)){
+uint8_t DFRobot_WK2132::getGlobalRegType(eGlobalRegType_t type){
+  if((type < DFRobot_IIC_Serial::clock) || (type > DFRobot_IIC_Serial::intrpt)){
       DBG("Global Reg Type Error!");
       return 0;
   }
   uint8_t regAddr = 0;
   switch(type){
-      case clock:
+      case DFRobot_IIC_Serial::clock:
                  regAddr = REG_WK2132_GENA;
                  break;
-      case rst:
+      case DFRobot_IIC_Serial::rst:
                  regAddr = REG_WK2132_GRST;
                  break;
       default:
@@ -243,116 +1787,551 @@ uint8_t DFRobot_IIC_Serial::getGlobalRegType(eGlobalRegType_t type){
   return regAddr;
 }
 
-void DFRobot_IIC_Serial::setSubSerialBaudRate(uint8_t subUartChannel, unsigned long baud){
-  uint8_t scr = 0x00,clear = 0x00;
-  _addr = updateAddr(_addr, subUartChannel, OBJECT_REGISTER);
-  subSerialPageSwitch(subUartChannel, page0);
-  readReg(REG_WK2132_SCR, &scr, 1);
-  subSerialRegConfig(subUartChannel, page0, REG_WK2132_SCR, &clear);
-  uint8_t baud1 = 0,baud0 = 0, baudPres = 0;
-  uint16_t valIntger  = FOSC/(baud * 16) - 1;
-  uint16_t valDecimal = (FOSC%(baud * 16))/(baud * 16); 
-  baud1 = (uint8_t)(valIntger >> 8);
-  baud0 = (uint8_t)(valIntger & 0x00ff);
-  while(valDecimal > 0x0A){
-      valDecimal /= 0x0A;
-  }
-  baudPres = (uint8_t)(valDecimal);
-  subSerialRegConfig(subUartChannel, page1, REG_WK2132_BAUD1, &baud1);
-  subSerialRegConfig(subUartChannel, page1, REG_WK2132_BAUD0, &baud0);
-  subSerialRegConfig(subUartChannel, page1, REG_WK2132_PRES, &baudPres);
-  subSerialRegConfig(subUartChannel, page0, REG_WK2132_SCR, &scr);
-
-  readReg(REG_WK2132_BAUD1, &baud1, 1);
-  readReg(REG_WK2132_BAUD0, &baud0, 1);
-  readReg(REG_WK2132_PRES, &baudPres, 1);
-  DBG(baud1, HEX);
-  DBG(baud0, HEX);
-  DBG(baudPres, HEX);
+
+int DFRobot_WK2132::writeReg(uint8_t subUartChannel, uint8_t reg, const void* pBuf, size_t size){
+  if(pBuf == NULL){
+      DBG("pBuf ERROR!! : null pointer");
+      return ERR_DATA_WRITE;
+  }
+  DFRobot_WK2132_Guard guard(this);
+  if(!busAllowed()){
+      return ERR_BUS_OFF;
+  }
+  const uint8_t * _pBuf = (const uint8_t *)pBuf;
+  uint8_t ret = 0;
+  //寄存器写入可重复执行，任何失败都整次重试；FDAT写入的是发送数据，同writeFifo()只在地址无应答(返回2)时重试
+  for(uint8_t attempt = 0; ; attempt++){
+#if IIC_SERIAL_ENABLE_STATS || IIC_SERIAL_ENABLE_TRACE
+      unsigned long start = micros();
+#endif
+      _pWire->beginTransmission(updateAddr(subUartChannel, OBJECT_REGISTER));
+      _pWire->write(&reg, 1);
+      for(uint16_t i = 0; i < size; i++){
+        _pWire->write(_pBuf[i]);
+      }
+      ret = _pWire->endTransmission();
+#if IIC_SERIAL_ENABLE_STATS
+      recordStats(subUartChannel, 1, size + 1, 0, ret != 0, start);
+#endif
+#if IIC_SERIAL_ENABLE_TRACE
+      traceRecord(updateAddr(subUartChannel, OBJECT_REGISTER), reg, 0, size, size ? _pBuf[0] : 0, ret, start);
+#endif
+      if(ret == 0 || attempt >= _retries || (reg == REG_WK2132_FDAT && ret != 2)){
+          break;
+      }
+      retryWait(attempt);
+  }
+  noteAccess(ret ? ERR_DATA_WRITE : ERR_OK);
+  return ret ? ERR_DATA_WRITE : ERR_OK;
 }
 
-void DFRobot_IIC_Serial::setSubSerialConfigReg(uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt){
-  uint8_t _mode = (uint8_t)mode;
-  uint8_t _opt = (uint8_t)opt;
-  uint8_t val = 0;
-  subSerialPageSwitch(_subSerialChannel, page0);
-  _addr = updateAddr(_addr, _subSerialChannel, OBJECT_REGISTER);
-  if(readReg(REG_WK2132_LCR, &val, 1) != 1){
-      DBG("数据字节读取错误！");
+uint8_t DFRobot_WK2132::readReg(uint8_t subUartChannel, uint8_t reg, void* pBuf, size_t size){
+  if(pBuf == NULL){
+    DBG("pBuf ERROR!! : null pointer");
+    return 0;
+  }
+  DFRobot_WK2132_Guard guard(this);
+  uint8_t * _pBuf = (uint8_t *)pBuf;
+  if(!busAllowed()){
+      memset(_pBuf, 0, size);
+      return 0;
+  }
+  uint8_t addr = updateAddr(subUartChannel, OBJECT_REGISTER);
+  bool ok = false;
+  for(uint8_t attempt = 0; ; attempt++){
+#if IIC_SERIAL_ENABLE_STATS || IIC_SERIAL_ENABLE_TRACE
+      unsigned long start = micros();
+#endif
+      _pWire->beginTransmission(addr);
+      _pWire->write(&reg, 1);
+      uint8_t err = _pWire->endTransmission();
+      if(err != 0){
+#if IIC_SERIAL_ENABLE_STATS
+          recordStats(subUartChannel, 1, 1, 0, true, start);
+#endif
+#if IIC_SERIAL_ENABLE_TRACE
+          traceRecord(addr, reg, IIC_SERIAL_TRACE_READ, size, 0, err, start);
+#endif
+      }else{
+          uint8_t ret = _pWire->requestFrom(addr, (uint8_t) size);
+          for(uint16_t i = 0; i < ret; i++){
+            _pBuf[i] = (uint8_t)_pWire->read();
+          }
+#if IIC_SERIAL_ENABLE_STATS
+          recordStats(subUartChannel, 2, 1, ret, ret != size, start);
+#endif
+#if IIC_SERIAL_ENABLE_TRACE
+          traceRecord(addr, reg, IIC_SERIAL_TRACE_READ, size, ret ? _pBuf[0] : 0, (ret == size) ? 0 : IIC_SERIAL_TRACE_SHORT, start);
+#endif
+          ok = (ret == size);
+      }
+      if(ok || attempt >= _retries){
+          break;
+      }
+      retryWait(attempt);
+  }
+  noteAccess(ok ? ERR_OK : ERR_DATA_READ);
+  if(!ok){
+      //失败时不把上次或栈上的旧数据当作读到的值
+      memset(_pBuf, 0, size);
+      return 0;
+  }
+  return size;
+}
+
+size_t DFRobot_WK2132::readFifo(uint8_t subUartChannel, void* pBuf, size_t size){
+  if(pBuf == NULL){
+    DBG("pBuf ERROR!! : null pointer");
+    return 0;
+  }
+  DFRobot_WK2132_Guard guard(this);
+  if(!busAllowed()){
+    return 0;
+  }
+  uint8_t * _pBuf = (uint8_t *)pBuf;
+  uint8_t addr = updateAddr(subUartChannel, OBJECT_FIFO);
+  size_t count = 0;
+  uint8_t attempt = 0;
+  while(count < size){
+#if IIC_SERIAL_ENABLE_STATS || IIC_SERIAL_ENABLE_TRACE
+    unsigned long start = micros();
+#endif
+    uint8_t len = (size - count) > IIC_SERIAL_FIFO_CHUNK ? IIC_SERIAL_FIFO_CHUNK : (uint8_t)(size - count);
+    uint8_t ret = _pWire->requestFrom(addr, len);
+    for(uint8_t i = 0; i < ret; i++){
+      _pBuf[count++] = _pWire->read();
+    }
+#if IIC_SERIAL_ENABLE_STATS
+    recordStats(subUartChannel, 1, 0, ret, ret != len, start);
+#endif
+#if IIC_SERIAL_ENABLE_TRACE
+    traceRecord(addr, 0, IIC_SERIAL_TRACE_READ | IIC_SERIAL_TRACE_FIFO, len, ret ? _pBuf[count - ret] : 0,
+                (ret == len) ? 0 : IIC_SERIAL_TRACE_SHORT, start);
+#endif
+    if(ret != len){
+      //地址无应答时没有从FIFO取走数据，可以重试；已读到部分数据时不再重试
+      if(ret == 0 && attempt < _retries){
+        retryWait(attempt++);
+        continue;
+      }
+      DBG("READ FIFO SIZE ERROR!");
+      noteAccess(ERR_DATA_READ);
+      return count;
+    }
+    attempt = 0;
+  }
+  noteAccess(ERR_OK);
+  return count;
+}
+
+size_t DFRobot_WK2132::writeFifo(uint8_t subUartChannel, const void* pBuf, size_t size){
+  if(pBuf == NULL){
+    DBG("pBuf ERROR!! : null pointer");
+    return 0;
+  }
+  DFRobot_WK2132_Guard guard(this);
+  if(!busAllowed()){
+    return 0;
+  }
+  const uint8_t * _pBuf = (const uint8_t *)pBuf;
+  uint8_t addr = updateAddr(subUartChannel, OBJECT_FIFO);
+  size_t count = 0;
+  uint8_t attempt = 0;
+  while(count < size){
+#if IIC_SERIAL_ENABLE_STATS || IIC_SERIAL_ENABLE_TRACE
+    unsigned long start = micros();
+#endif
+    uint8_t len = (size - count) > IIC_SERIAL_FIFO_CHUNK ? IIC_SERIAL_FIFO_CHUNK : (uint8_t)(size - count);
+    _pWire->beginTransmission(addr);
+    _pWire->write(_pBuf + count, len);
+    uint8_t ret = _pWire->endTransmission();
+#if IIC_SERIAL_ENABLE_STATS
+    recordStats(subUartChannel, 1, len, 0, ret != 0, start);
+#endif
+#if IIC_SERIAL_ENABLE_TRACE
+    traceRecord(addr, 0, IIC_SERIAL_TRACE_FIFO, len, _pBuf[count], ret, start);
+#endif
+    if(ret != 0){
+      //只有地址无应答(返回2)能确定没有数据写入FIFO，其他错误重试可能重复发送
+      if(ret == 2 && attempt < _retries){
+        retryWait(attempt++);
+        continue;
+      }
+      DBG("WRITE FIFO ERROR!");
+      noteAccess(ERR_DATA_WRITE);
+      return count;
+    }
+    attempt = 0;
+    count += len;
+  }
+  noteAccess(ERR_OK);
+  return count;
+}
+
+bool DFRobot_WK2132::busAllowed(void){
+  if(_offline && (micros() - _offlineAt) < _holdUs){
+      _lastErr = ERR_BUS_OFF;
+      return false;
+  }
+  //退避期已过，放行一次访问作为探测，成功后恢复，失败则加倍退避
+  return true;
+}
+
+void DFRobot_WK2132::noteAccess(int err){
+  if(err == ERR_OK){
+      if(_failCount || _offline){
+          DBG("chip back online");
+      }
+      _failCount = 0;
+      _offline = false;
+      _holdUs = IIC_SERIAL_HOLD_MIN_US;
+      return;
+  }
+  _errorCount++;
+  _lastErr = err;
+  //出错后芯片是否收到了SPAGE未知，下次访问时重新写入
+  _page[0] = 0xff;
+  _page[1] = 0xff;
+  if(_offline){
+      //探测失败
+      _holdUs = (_holdUs >= IIC_SERIAL_HOLD_MAX_US / 2) ? IIC_SERIAL_HOLD_MAX_US : (_holdUs * 2);
+      _offlineAt = micros();
       return;
   }
-  DBG("before: "); DBG(val, HEX);
-  sLcrReg_t lcr = *((sLcrReg_t *)(&val));
-  lcr.format = format;
-  lcr.irEn = _mode;
-  lcr.lBreak = _opt;
-  val = *(uint8_t *)&lcr;
-  writeReg(REG_WK2132_LCR, &val, 1);
-  readReg(REG_WK2132_LCR, &val, 1);
-  DBG("after: "); DBG(val, HEX);
+  if(++_failCount >= IIC_SERIAL_FAIL_LIMIT){
+      DBG("chip offline");
+      _offline = true;
+      _offlineAt = micros();
+      recoverBus();
+  }
 }
 
-uint8_t DFRobot_IIC_Serial::updateAddr(uint8_t pre, uint8_t subUartChannel, uint8_t obj){
-  if(((pre&0x01) == obj) && (((pre >> 1)&0x03)== subUartChannel)){
-      return pre;
+DFRobot_WK2132::eHealth_t DFRobot_WK2132::getHealth(void){
+  if(_offline){
+      return ((micros() - _offlineAt) < _holdUs) ? eHealthOffline : eHealthDegraded;
   }
-  sIICAddr_t addr ={.type = obj, .uart = subUartChannel, .addrPre = (uint8_t)((int)pre >> 3)};
-  DBG(*(uint8_t *)&addr, HEX);
-  _cacheObject = obj;
-  return *(uint8_t *)&addr;
+  return _failCount ? eHealthDegraded : eHealthOk;
 }
 
-DFRobot_IIC_Serial::sFsrReg_t DFRobot_IIC_Serial::readFIFOStateReg(){
-  sFsrReg_t fsr;
-  readReg(REG_WK2132_FSR, &fsr, sizeof(fsr));
-  return fsr;
+int DFRobot_WK2132::recoverBus(void){
+  DFRobot_WK2132_Guard guard(this);
+  if(_sdaPin == 0xff || _sclPin == 0xff){
+      return ERR_PIN;
+  }
+  _pWire->end();
+  pinMode(_sdaPin, INPUT_PULLUP);
+  pinMode(_sclPin, OUTPUT);
+  //从机在输出数据位时被打断会一直拉住SDA，每个时钟让它移出1位，最多9个时钟(8位数据+ACK)后释放
+  for(uint8_t i = 0; i < 9 && digitalRead(_sdaPin) == LOW; i++){
+      digitalWrite(_sclPin, LOW);
+      delayMicroseconds(5);
+      digitalWrite(_sclPin, HIGH);
+      delayMicroseconds(5);
+  }
+  bool released = (digitalRead(_sdaPin) == HIGH);
+  //SCL为高时SDA由低变高，产生STOP，让所有从机回到空闲状态
+  pinMode(_sdaPin, OUTPUT);
+  digitalWrite(_sdaPin, LOW);
+  delayMicroseconds(5);
+  digitalWrite(_sclPin, HIGH);
+  delayMicroseconds(5);
+  digitalWrite(_sdaPin, HIGH);
+  delayMicroseconds(5);
+  pinMode(_sdaPin, INPUT);
+  pinMode(_sclPin, INPUT);
+  _pWire->begin();
+  return released ? ERR_OK : ERR_DATA_BUS;
 }
 
-void DFRobot_IIC_Serial::writeReg(uint8_t reg, const void* pBuf, size_t size){
-  if(pBuf == NULL){
-      DBG("pBuf ERROR!! : null pointer");
+#if IIC_SERIAL_ENABLE_STATS
+void DFRobot_WK2132::recordStats(uint8_t subUartChannel, uint8_t transactions, size_t bytesOut, size_t bytesIn, bool nack, unsigned long start){
+  if(subUartChannel > SUBUART_CHANNEL_2 || _channel[subUartChannel] == NULL){
+      return;
   }
-  uint8_t * _pBuf = (uint8_t *)pBuf;
-  _pWire->beginTransmission(_addr);
-  _pWire->write(&reg, 1);
+  DFRobot_IIC_Serial::sStats_t &stats = _channel[subUartChannel]->_stats;
+  unsigned long us = micros() - start;
+  uint8_t bucket = 0;
+  while(us >= 64 && bucket < IIC_SERIAL_STATS_BUCKETS - 1){
+      us >>= 1;
+      bucket++;
+  }
+  stats.transactions += transactions;
+  stats.bytesOut += bytesOut;
+  stats.bytesIn += bytesIn;
+  if(nack){
+      stats.nacks++;
+  }
+  stats.latency[bucket]++;
+}
+#endif
 
-  for(uint16_t i = 0; i < size; i++){
-    _pWire->write(_pBuf[i]);
+#if IIC_SERIAL_ENABLE_TRACE
+void DFRobot_WK2132::traceRecord(uint8_t addr, uint8_t reg, uint8_t flags, uint8_t len, uint8_t value, uint8_t result, unsigned long start){
+  sTraceRecord_t &r = _trace[_traceHead];
+  r.us = start;
+  r.addr = addr;
+  r.reg = reg;
+  r.flags = flags;
+  r.len = len;
+  r.value = value;
+  r.result = result;
+  _traceHead = (_traceHead + 1) % IIC_SERIAL_TRACE_SIZE;
+  if(_traceCount < IIC_SERIAL_TRACE_SIZE){
+      _traceCount++;
   }
-  _pWire->endTransmission();
 }
 
-uint8_t DFRobot_IIC_Serial::readReg(uint8_t reg, void* pBuf, size_t size){
-  if(pBuf == NULL){
-    DBG("pBuf ERROR!! : null pointer");
+size_t DFRobot_WK2132::dumpTrace(Print &out, bool hex){
+  //文件头：WKTR、版本、单条记录长度、记录条数(小端)，之后按时间顺序输出记录，时间戳为小端
+  uint8_t head[8] = {'W', 'K', 'T', 'R', IIC_SERIAL_TRACE_VERSION, sizeof(sTraceRecord_t),
+                     (uint8_t)(_traceCount & 0xff), (uint8_t)(_traceCount >> 8)};
+  size_t total = traceWrite(out, head, sizeof(head), hex);
+  uint16_t index = (_traceHead + IIC_SERIAL_TRACE_SIZE - _traceCount) % IIC_SERIAL_TRACE_SIZE;
+  for(uint16_t i = 0; i < _traceCount; i++){
+      const sTraceRecord_t &r = _trace[(index + i) % IIC_SERIAL_TRACE_SIZE];
+      uint8_t buf[sizeof(sTraceRecord_t)] = {(uint8_t)r.us, (uint8_t)(r.us >> 8), (uint8_t)(r.us >> 16), (uint8_t)(r.us >> 24),
+                                             r.addr, r.reg, r.flags, r.len, r.value, r.result};
+      total += traceWrite(out, buf, sizeof(buf), hex);
   }
-  uint8_t * _pBuf = (uint8_t *)pBuf;
-  _addr &= 0xFE;
-  _pWire->beginTransmission(_addr);
-  _pWire->write(&reg, 1);
-  if(_pWire->endTransmission() != 0){
-      return 0;
+  if(hex){
+      out.println();
   }
-  _pWire->requestFrom(_addr, (uint8_t) size);
-  for(uint16_t i = 0; i < size; i++){
-    _pBuf[i] = (char)_pWire->read();
+  return total;
+}
+
+size_t DFRobot_WK2132::traceWrite(Print &out, const uint8_t *pBuf, size_t size, bool hex){
+  if(!hex){
+      return out.write(pBuf, size);
+  }
+  //十六进制文本便于从串口监视器复制，每条记录一行
+  static const char digits[] = "0123456789ABCDEF";
+  for(size_t i = 0; i < size; i++){
+      out.write(digits[pBuf[i] >> 4]);
+      out.write(digits[pBuf[i] & 0x0f]);
   }
+  out.println();
   return size;
 }
-// uint8_t DFRobot_IIC_Serial::readFifoCache(void* pBuf, size_t size){
-   // if(pBuf == NULL){
-    // DBG("pBuf ERROR!! : null pointer");
-  // }
-  // uint8_t * _pBuf = (uint8_t *)pBuf;
-  // _addr |=0x01;
-  // _pWire->beginTransmission(_addr);
-  // _pWire->endTransmission();
-  // _pWire->requestFrom(_addr, (uint8_t) size);
-  // for(uint16_t i = 0; i < size; i++){DBG();
-    // _pBuf[i] = _pWire->read();DBG(_pBuf[i], HEX);
-  // }
-  // return size;
-// }
+#endif
+
+#if IIC_SERIAL_ENABLE_RTOS
+DFRobot_WK2132::sBus_t *DFRobot_WK2132::findBus(TwoWire *pWire){
+  for(uint8_t i = 0; i < IIC_SERIAL_BUS_NUM; i++){
+      if(_busList[i].pWire == pWire){
+          return &_busList[i];
+      }
+  }
+  for(uint8_t i = 0; i < IIC_SERIAL_BUS_NUM; i++){
+      if(_busList[i].pWire == NULL){
+          //总线锁在所有芯片对象之间共用，芯片对象释放后也保留
+          _busList[i].mutex = xSemaphoreCreateRecursiveMutex();
+          if(_busList[i].mutex == NULL){
+              DBG("create mutex failed");
+              return NULL;
+          }
+          _busList[i].pWire = pWire;
+          return &_busList[i];
+      }
+  }
+  DBG("too many buses, increase IIC_SERIAL_BUS_NUM");
+  return NULL;
+}
+
+void DFRobot_WK2132::lock(void){
+  if(_pBus == NULL){
+      return;
+  }
+  if(xSemaphoreTakeRecursive(_pBus->mutex, 0) != pdTRUE){
+      //总线被其他任务占用，只在需要等待时计时，不增加无竞争时的开销
+      unsigned long start = micros();
+      xSemaphoreTakeRecursive(_pBus->mutex, portMAX_DELAY);
+      unsigned long us = micros() - start;
+      _pBus->stats.contended++;
+      _pBus->stats.waitUs += us;
+      if(us > _pBus->stats.maxWaitUs){
+          _pBus->stats.maxWaitUs = us;
+      }
+  }
+  if(_pBus->depth++ == 0){
+      _pBus->stats.locks++;
+  }
+}
+
+void DFRobot_WK2132::unlock(void){
+  if(_pBus == NULL){
+      return;
+  }
+  _pBus->depth--;
+  xSemaphoreGiveRecursive(_pBus->mutex);
+}
+
+const DFRobot_WK2132::sLockStats_t &DFRobot_WK2132::lockStats(void){
+  static const sLockStats_t none = {0, 0, 0, 0};
+  return _pBus ? _pBus->stats : none;
+}
+
+void DFRobot_WK2132::resetLockStats(void){
+  if(_pBus == NULL){
+      return;
+  }
+  lock();
+  memset(&_pBus->stats, 0, sizeof(_pBus->stats));
+  unlock();
+}
+#endif
+
+DFRobot_WK2132_Scheduler::DFRobot_WK2132_Scheduler(TwoWire &wire)
+  :_pWire(&wire), _chipNum(0), _maxIntervalUs(0), _maxPerRun(0), _rr(0){
+  memset(_chip, 0, sizeof(_chip));
+  memset(_pending, 0, sizeof(_pending));
+  memset(_level, 0, sizeof(_level));
+  memset(_pendingUs, 0, sizeof(_pendingUs));
+  memset(_lastUs, 0, sizeof(_lastUs));
+  memset(_stats, 0, sizeof(_stats));
+}
+
+int DFRobot_WK2132_Scheduler::addChip(DFRobot_WK2132 &chip){
+  if(chip.getWire() != _pWire || _chipNum >= IIC_SERIAL_SCHED_CHIP_NUM){
+      DBG("chip not on this bus or too many chips");
+      return ERR_ADDR;
+  }
+  for(uint8_t i = 0; i < _chipNum; i++){
+      if(_chip[i] == &chip){
+          return ERR_ADDR;
+      }
+  }
+  unsigned long now = micros();
+  _lastUs[_chipNum * 2] = now;
+  _lastUs[_chipNum * 2 + 1] = now;
+  _chip[_chipNum++] = &chip;
+  return ERR_OK;
+}
+
+int DFRobot_WK2132_Scheduler::begin(void){
+  int count = 0;
+  for(uint8_t i = 0; i < IIC_SERIAL_CHIP_NUM; i++){
+      DFRobot_WK2132 *chip = DFRobot_WK2132::_chipList[i];
+      if(chip && chip->_pWire == _pWire && addChip(*chip) == ERR_OK){
+          count++;
+      }
+  }
+  return count;
+}
+
+unsigned long DFRobot_WK2132_Scheduler::slackUs(uint8_t port, unsigned long now){
+  DFRobot_IIC_Serial *serial = _chip[port >> 1]->_channel[port & 1];
+  if(serial->_baud == 0){
+      return 0xffffffffUL;
+  }
+  //每字节10位，从发现中断起按波特率估算FIFO中累积的数据
+  unsigned long byteUs = 10000000UL / serial->_baud;
+  if(byteUs == 0){
+      byteUs = 1;
+  }
+  unsigned long fill = _level[port] + (now - _pendingUs[port]) / byteUs;
+  if(fill >= 256){
+      return 0;
+  }
+  return (256 - fill) * byteUs;
+}
+
+void DFRobot_WK2132_Scheduler::servicePort(uint8_t port){
+  DFRobot_IIC_Serial *serial = _chip[port >> 1]->_channel[port & 1];
+  if(_pending[port] == 1){
+      serial->serviceInterrupt();
+  }else{
+      serial->fillRxBuffer();
+      serial->poll();
+      _stats[port].forced++;
+  }
+  unsigned long done = micros();
+  if(_pending[port] == 1 && done - _pendingUs[port] > _stats[port].maxLatencyUs){
+      _stats[port].maxLatencyUs = done - _pendingUs[port];
+  }
+  _stats[port].services++;
+  _pending[port] = 0;
+  _lastUs[port] = done;
+}
+
+int DFRobot_WK2132_Scheduler::run(void){
+  unsigned long now = micros();
+  for(uint8_t c = 0; c < _chipNum; c++){
+      DFRobot_WK2132 *chip = _chip[c];
+      uint8_t gifr = 0;
+      //接了IRQ引脚且没有中断时不读GIFR
+      if(chip->_irqPin == 0xff || chip->_irqFlag){
+          chip->_irqFlag = false;
+          if(chip->readReg(SUBUART_CHANNEL_1, REG_WK2132_GIFR, &gifr, 1) != 1){
+              DBG("READ BYTE SIZE ERROR!");
+              chip->_irqFlag = true;
+              gifr = 0;
+          }
+      }
+      for(uint8_t ch = 0; ch < 2; ch++){
+          uint8_t port = c * 2 + ch;
+          DFRobot_IIC_Serial *serial = chip->_channel[ch];
+          if(serial == NULL){
+              _pending[port] = 0;
+              continue;
+          }
+          if((gifr & (1 << ch)) && _pending[port] != 1){
+              //中断发生时FIFO中至少有触发点个数的数据
+              _pending[port] = 1;
+              _pendingUs[port] = now;
+              _level[port] = serial->getRxTriggerLevel();
+          }else if(_pending[port] == 0 && _maxIntervalUs && now - _lastUs[port] >= _maxIntervalUs){
+              //没有中断标志的端口，按上次服务以来的时间估算FIFO中的数据
+              _pending[port] = 2;
+              _pendingUs[port] = _lastUs[port];
+              _level[port] = 0;
+          }
+      }
+  }
+  int count = 0;
+  uint8_t portNum = _chipNum * 2;
+  while(_maxPerRun == 0 || count < _maxPerRun){
+      //剩余时间最短的端口优先，相同时从上次服务的下一个端口开始轮转
+      int8_t best = -1;
+      unsigned long bestSlack = 0;
+      for(uint8_t i = 0; i < portNum; i++){
+          uint8_t port = (_rr + i) % portNum;
+          if(_pending[port] == 0){
+              continue;
+          }
+          unsigned long slack = slackUs(port, now);
+          if(best < 0 || slack < bestSlack){
+              best = port;
+              bestSlack = slack;
+          }
+      }
+      if(best < 0){
+          break;
+      }
+      servicePort(best);
+      _rr = (best + 1) % portNum;
+      count++;
+  }
+  //IRQ为低电平有效，仍为低说明还有未处理的中断源，下次继续读GIFR
+  for(uint8_t c = 0; c < _chipNum; c++){
+      if(_chip[c]->_irqPin != 0xff && digitalRead(_chip[c]->_irqPin) == LOW){
+          _chip[c]->_irqFlag = true;
+      }
+  }
+  return count;
+}
+
+DFRobot_WK2132_Scheduler::sPortStats_t DFRobot_WK2132_Scheduler::getStats(DFRobot_IIC_Serial &serial){
+  sPortStats_t stats = {0, 0, 0};
+  for(uint8_t c = 0; c < _chipNum; c++){
+      for(uint8_t ch = 0; ch < 2; ch++){
+          if(_chip[c]->_channel[ch] == &serial){
+              stats = _stats[c * 2 + ch];
+          }
+      }
+  }
+  return stats;
+}
+
 // void DFRobot_IIC_Serial::witeByte(void *pBuf, size_t size){
   // if(pBuf == NULL){
     // DBG("pBuf ERROR!! : null pointer");
@@ -376,25 +2355,87 @@ uint8_t DFRobot_IIC_Serial::readReg(uint8_t reg, void* pBuf, size_t size){
     //readReg( REG_WK2132_TFCNT, &val, 1);
     // DBG("tx_after:");DBG(val,HEX);
 // }
-// void DFRobot_IIC_Serial::writeFifo(void* pBuf, size_t size){
-  // if(pBuf == NULL){
-    // DBG("pBuf ERROR!! : null pointer");
-  // }
-  // uint8_t val = 0;
-  // readReg(REG_WK2132_TFCNT, &val, 1);
-  // DBG("tx_before:");DBG(val);
-  // uint8_t * _pBuf = (uint8_t *)pBuf;
-  // _addr |=0x01;
-  // _pWire->beginTransmission(_addr);
-  // for(uint16_t i = 0; i < 43; i++){
-    // _pWire->write(_pBuf[i]);
-  // }
-  // _pWire->endTransmission();
-  // readReg( REG_WK2132_TFCNT, &val, 1);
-  // DBG("tx_after:");DBG(val);
-// }
-
 // void DFRobot_IIC_Serial::test(){
     
     
-// }
\ No newline at end of file
+// }
+
+DFRobot_WK2132_Bridge::DFRobot_WK2132_Bridge(DFRobot_IIC_Serial &a, DFRobot_IIC_Serial &b)
+  :_pHost(NULL){
+  _pSerial[0] = &a;
+  _pSerial[1] = &b;
+  memset(_len, 0, sizeof(_len));
+  memset(_stats, 0, sizeof(_stats));
+}
+
+DFRobot_WK2132_Bridge::DFRobot_WK2132_Bridge(Stream &host, DFRobot_IIC_Serial &b)
+  :_pHost(&host){
+  _pSerial[0] = NULL;
+  _pSerial[1] = &b;
+  memset(_len, 0, sizeof(_len));
+  memset(_stats, 0, sizeof(_stats));
+}
+
+size_t DFRobot_WK2132_Bridge::run(void){
+  size_t total = 0;
+  for(uint8_t dir = 0; dir < 2; dir++){
+      //先写出上次暂存的数据，保证顺序，再读源，暂存缓存满时数据留在源接收FIFO中
+      total += flushHeld(dir);
+      uint16_t before = _len[dir];
+      if(before >= IIC_SERIAL_BRIDGE_BUFFER_SIZE){
+          continue;
+      }
+      size_t n = pull(dir, _buf[dir] + before, IIC_SERIAL_BRIDGE_BUFFER_SIZE - before);
+      if(n == 0){
+          continue;
+      }
+      _len[dir] += n;
+      if(_len[dir] > _stats[dir].maxHeld){
+          _stats[dir].maxHeld = _len[dir];
+      }
+      total += flushHeld(dir);
+      //本次读出而没有写出的部分
+      _stats[dir].held += (_len[dir] < n) ? _len[dir] : n;
+  }
+  return total;
+}
+
+size_t DFRobot_WK2132_Bridge::flushHeld(uint8_t dir){
+  if(_len[dir] == 0){
+      return 0;
+  }
+  size_t n = push(1 - dir, _buf[dir], _len[dir]);
+  if(n){
+      _len[dir] -= n;
+      memmove(_buf[dir], _buf[dir] + n, _len[dir]);
+      _stats[dir].forwarded += n;
+  }
+  return n;
+}
+
+size_t DFRobot_WK2132_Bridge::pull(uint8_t side, uint8_t *pBuf, size_t size){
+  if(_pSerial[side] == NULL){
+      int n = _pHost->available();
+      if(n <= 0){
+          return 0;
+      }
+      return _pHost->readBytes((char *)pBuf, ((size_t)n < size) ? (size_t)n : size);
+  }
+  return _pSerial[side]->readAvailable(pBuf, size);
+}
+
+size_t DFRobot_WK2132_Bridge::push(uint8_t side, const uint8_t *pBuf, size_t size){
+  DFRobot_IIC_Serial *pSerial = _pSerial[side];
+  if(pSerial == NULL){
+      return _pHost->write(pBuf, size);
+  }
+  //_txFree用完才重新读取发送FIFO计数
+  int space = pSerial->_txFree ? pSerial->_txFree : pSerial->getTxFifoSpace();
+  if(space <= 0){
+      return 0;
+  }
+  size_t len = (size > (size_t)space) ? (size_t)space : size;
+  size_t n = pSerial->writeFifo(pBuf, len);
+  pSerial->_txFree = (n < pSerial->_txFree) ? (pSerial->_txFree - n) : 0;
+  return n;
+}
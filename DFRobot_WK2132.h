@@ -53,6 +53,10 @@
 #define REG_WK2132_RFCNT  0x0A   //子串口接收FIFO计数寄存器，只读(OR)寄存器
 #define REG_WK2132_FSR    0x0B   //子串口FIFO状态寄存器，只读(OR)寄存器
 #define REG_WK2132_LSR    0x0C   //子串口接收状态寄存器，只读(OR)寄存器
+#define IIC_SERIAL_LSR_PE  0x01   //LSR：接收FIFO顶部数据校验错误
+#define IIC_SERIAL_LSR_FE  0x02   //LSR：接收FIFO顶部数据停止位错误
+#define IIC_SERIAL_LSR_BI  0x04   //LSR：接收FIFO顶部数据为Line-Break
+#define IIC_SERIAL_LSR_OE  0x08   //LSR：接收FIFO溢出
 #define REG_WK2132_FDAT   0x0D   //子串口FIFO数据寄存器
 /*子串口寄存器 SPAGE1*/
 #define REG_WK2132_BAUD1  0x04   //子串口波特率配置寄存器高字节
@@ -64,8 +68,95 @@
 #define SUBUART_CHANNEL_2    0x01    //子串口通道2
 #define SUBUART_CHANNEL_ALL  0x11    //所有子通道
 
+//主控端接收环形缓存的默认长度，需作为编译选项(如-DIIC_SERIAL_RX_BUFFER_SIZE=128)对库和工程统一定义，也可运行时用setRxBuffer()替换
+#ifndef IIC_SERIAL_RX_BUFFER_SIZE
 #define IIC_SERIAL_RX_BUFFER_SIZE    32
+#endif
+//主控端发送队列的默认长度，在异步写(eWriteAsync)、RTOS任务模式和软件流控对端暂停期间使用，可用编译选项修改，也可运行时用setTxBuffer()替换
+#ifndef IIC_SERIAL_TX_BUFFER_SIZE
 #define IIC_SERIAL_TX_BUFFER_SIZE    32
+#endif
+
+//主控Wire库单次事务可收发的最大字节数，批量读写FIFO时按此长度分包，可在包含本头文件前自行定义
+#ifndef IIC_SERIAL_WIRE_BUFFER_SIZE
+#if defined(I2C_BUFFER_LENGTH)
+#define IIC_SERIAL_WIRE_BUFFER_SIZE  I2C_BUFFER_LENGTH
+#elif defined(BUFFER_LENGTH)
+#define IIC_SERIAL_WIRE_BUFFER_SIZE  BUFFER_LENGTH
+#else
+#define IIC_SERIAL_WIRE_BUFFER_SIZE  32
+#endif
+#endif
+
+//同时管理的WK2132芯片个数上限(每条IIC总线最多4个地址)
+#ifndef IIC_SERIAL_CHIP_NUM
+#define IIC_SERIAL_CHIP_NUM    8
+#endif
+
+//IIC访问失败后的重试次数和第1次重试前的等待时间(us，之后每次加倍)，可用setRetryPolicy()按芯片修改
+#ifndef IIC_SERIAL_RETRIES
+#define IIC_SERIAL_RETRIES     2
+#endif
+#ifndef IIC_SERIAL_BACKOFF_US
+#define IIC_SERIAL_BACKOFF_US  50
+#endif
+//连续失败多少次访问后芯片进入退避，退避时长从HOLD_MIN开始，每次再进入时加倍，不超过HOLD_MAX(us)
+#ifndef IIC_SERIAL_FAIL_LIMIT
+#define IIC_SERIAL_FAIL_LIMIT  3
+#endif
+#ifndef IIC_SERIAL_HOLD_MIN_US
+#define IIC_SERIAL_HOLD_MIN_US 2000UL
+#endif
+#ifndef IIC_SERIAL_HOLD_MAX_US
+#define IIC_SERIAL_HOLD_MAX_US 1000000UL
+#endif
+
+//总线统计开关，需作为编译选项(如-DIIC_SERIAL_ENABLE_STATS=1)对库和工程统一定义，关闭时不占用任何代码和内存
+#ifndef IIC_SERIAL_ENABLE_STATS
+#define IIC_SERIAL_ENABLE_STATS  0
+#endif
+//总线事务跟踪开关，需作为编译选项(如-DIIC_SERIAL_ENABLE_TRACE=1)对库和工程统一定义，
+//打开后每个芯片对象记录最近IIC_SERIAL_TRACE_SIZE次IIC事务，用DFRobot_WK2132::dumpTrace()导出，在主机上用wk2132_trace分析和回放
+#ifndef IIC_SERIAL_ENABLE_TRACE
+#define IIC_SERIAL_ENABLE_TRACE  0
+#endif
+#ifndef IIC_SERIAL_TRACE_SIZE
+#define IIC_SERIAL_TRACE_SIZE    64
+#endif
+//RTOS模式开关，需作为编译选项(如-DIIC_SERIAL_ENABLE_RTOS=1)对库和工程统一定义，用于ESP32等FreeRTOS平台上多个任务共用IIC总线：
+//每个TwoWire一个递归互斥锁，页切换和寄存器访问等一组操作在同一次加锁内完成；主控端收发缓存的读写指针按单生产者/单消费者无锁访问
+#ifndef IIC_SERIAL_ENABLE_RTOS
+#define IIC_SERIAL_ENABLE_RTOS   0
+#endif
+//RTOS模式下不同TwoWire对象(IIC总线)的个数上限
+#ifndef IIC_SERIAL_BUS_NUM
+#define IIC_SERIAL_BUS_NUM       2
+#endif
+#if IIC_SERIAL_ENABLE_RTOS
+#if defined(ARDUINO_ARCH_ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#else
+#include <FreeRTOS.h>
+#include <semphr.h>
+#endif
+//环形缓存读写指针：生产者写入数据后以release写头指针，消费者以acquire读头指针后再读数据，尾指针反之
+#define IIC_SERIAL_RING_LOAD(x)      __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define IIC_SERIAL_RING_STORE(x, v)  __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#else
+#define IIC_SERIAL_RING_LOAD(x)      (x)
+#define IIC_SERIAL_RING_STORE(x, v)  ((x) = (v))
+#endif
+//每次寄存器/FIFO访问耗时直方图的桶数，第i个桶统计[32<<i, 64<<i)微秒，第0个桶从0开始，最后一个桶不设上限
+#define IIC_SERIAL_STATS_BUCKETS 8
+
+//外部晶振频率，板子换用其他晶振(如14.7456MHz，可支持921600波特率)时在包含本头文件前定义，也可运行时用DFRobot_WK2132::setFosc()修改
+#ifndef IIC_SERIAL_FOSC
+#define IIC_SERIAL_FOSC  11059200UL
+#endif
+
+//芯片对象中缓存的子串口配置寄存器个数(第0页SCR~SIER，第1页BAUD1~TFTL)
+#define IIC_SERIAL_SHADOW_NUM  9
 
 //数据格式:N表示无校验位，Z表示0校验，O表示奇校验, E表示偶校验，F表示偶校验。前面一个数字表示发送数据的位数，后面一个数字表示停止位数
 #define IIC_SERIAL_8N1    0x00
@@ -80,18 +171,153 @@
 #define IIC_SERIAL_8F2    0x0F
 
 
+//中断服务函数属性，ESP系列需要将中断服务函数放在IRAM中
+#if defined(ARDUINO_ARCH_ESP32)
+#define IIC_SERIAL_ISR_ATTR  IRAM_ATTR
+#elif defined(ARDUINO_ARCH_ESP8266)
+#define IIC_SERIAL_ISR_ATTR  ICACHE_RAM_ATTR
+#else
+#define IIC_SERIAL_ISR_ATTR
+#endif
+
+class DFRobot_WK2132;
+class DFRobot_IIC_Serial;
+class DFRobot_WK2132_Scheduler;
+class DFRobot_WK2132_Bridge;
+
+/**
+ * @brief 子串口中断回调函数原型
+ * @param pSerial 发生中断的子串口通道对象
+ * @param sifr 本次处理的子串口中断标志(SIFR寄存器的值)，可与IIC_SERIAL_INT_xxx按位与判断中断源
+ */
+typedef void(*IIC_SERIAL_INT_CB)(DFRobot_IIC_Serial *pSerial, uint8_t sifr);
+#define IIC_SERIAL_INT_RFTRIG   0x01    //接收FIFO触点中断
+#define IIC_SERIAL_INT_RXOVT    0x02    //接收FIFO超时中断
+#define IIC_SERIAL_INT_TFTRIG   0x04    //发送FIFO触点中断
+#define IIC_SERIAL_INT_TFEMPTY  0x08    //发送FIFO空中断
+#define IIC_SERIAL_INT_FERR     0x80    //接收FIFO数据错误中断
+
+/**
+ * @brief 帧接收回调函数原型，帧模式下每收到一个完整的帧调用一次
+ * @param pSerial 收到帧的子串口通道对象
+ * @param length 帧长度，帧数据已在主控端接收缓存中，在回调中用readFrame()取出
+ * @param flags 帧中出现过的错误，IIC_SERIAL_FRAME_xxx按位或，0表示无错误
+ */
+typedef void(*IIC_SERIAL_FRAME_CB)(DFRobot_IIC_Serial *pSerial, uint16_t length, uint8_t flags);
+#define IIC_SERIAL_FRAME_PE       0x01    //帧中有校验错误的字节，与LSR寄存器的位定义相同
+#define IIC_SERIAL_FRAME_FE       0x02    //帧中有停止位错误的字节
+#define IIC_SERIAL_FRAME_BI       0x04    //帧中有Line-Break
+#define IIC_SERIAL_FRAME_OE       0x08    //接收FIFO溢出，帧中有字节丢失
+#define IIC_SERIAL_FRAME_OVERRUN  0x80    //主控端接收缓存或用户缓存放不下，帧被截断
+/**
+ * @brief 接收数据接收函数原型，设置后从接收FIFO读出的数据按Wire分包直接交给它，不经过主控端接收缓存
+ * @param pSerial 数据所属的子串口通道对象
+ * @param pData 本次读出的数据，只在回调期间有效
+ * @param size 数据长度，不超过IIC_SERIAL_WIRE_BUFFER_SIZE
+ */
+typedef void(*IIC_SERIAL_RX_SINK)(DFRobot_IIC_Serial *pSerial, const uint8_t *pData, size_t size);
+
+/**
+ * @brief 子串口波特率分频值，对应第1页的BAUD1、BAUD0、PRES寄存器
+ */
+typedef struct{
+  uint8_t baud1;   /*!< 分频值整数部分的高8位 */
+  uint8_t baud0;   /*!< 分频值整数部分的低8位 */
+  uint8_t pres;    /*!< 分频值的小数部分 */
+} sBaudDivisor_t;
+
+/**
+ * @brief 计算以0.1为单位的分频系数，分频系数 = FOSC/(16*baud) - 1，整数部分写BAUD1/BAUD0，小数部分×10写PRES
+ * @n 四舍五入到0.1；波特率高于FOSC/16时分频系数为0，即芯片能达到的最高波特率
+ * @param fosc 晶振频率(Hz)
+ * @param baud 波特率
+ */
+constexpr uint32_t wk2132DivisorTenths(unsigned long fosc, unsigned long baud){
+  return ((fosc * 10UL + baud * 8UL) / (baud * 16UL) > 10UL) ? ((fosc * 10UL + baud * 8UL) / (baud * 16UL) - 10UL) : 0;
+}
+/**
+ * @brief 由晶振频率和波特率计算分频寄存器的值，参数为常量时在编译期完成计算
+ * @param fosc 晶振频率(Hz)
+ * @param baud 波特率
+ */
+constexpr sBaudDivisor_t wk2132BaudDivisor(unsigned long fosc, unsigned long baud){
+  return {(uint8_t)((wk2132DivisorTenths(fosc, baud) / 10) >> 8), (uint8_t)((wk2132DivisorTenths(fosc, baud) / 10) & 0xff),
+          (uint8_t)(wk2132DivisorTenths(fosc, baud) % 10)};
+}
+/**
+ * @brief 计算按wk2132BaudDivisor()配置后实际得到的波特率
+ * @param fosc 晶振频率(Hz)
+ * @param baud 期望的波特率
+ */
+constexpr unsigned long wk2132ActualBaud(unsigned long fosc, unsigned long baud){
+  return (fosc * 10UL + 8UL * (wk2132DivisorTenths(fosc, baud) + 10)) / (16UL * (wk2132DivisorTenths(fosc, baud) + 10));
+}
+/**
+ * @brief 计算按wk2132BaudDivisor()配置后实际波特率相对期望值的误差，用于选择可靠的最高波特率(一般要求在±2%以内)
+ * @param fosc 晶振频率(Hz)
+ * @param baud 期望的波特率
+ * @return 返回误差，单位ppm，正值表示实际波特率偏高
+ */
+constexpr long wk2132BaudErrorPpm(unsigned long fosc, unsigned long baud){
+  return (long)(((int64_t)fosc * 10 - (int64_t)baud * 16 * (wk2132DivisorTenths(fosc, baud) + 10)) * 1000000LL /
+                ((int64_t)baud * 16 * (wk2132DivisorTenths(fosc, baud) + 10)));
+}
+
+/**
+ * @brief 错误字节回调函数原型，设置后接收数据中有错误时逐字节读取LSR，每个出错的字节调用一次
+ * @param pSerial 数据所属的子串口通道对象
+ * @param data 出错的字节，回调返回后照常放入主控端接收缓存(或交给接收函数)
+ * @param lsr 该字节的错误标志，IIC_SERIAL_LSR_xxx按位或
+ */
+typedef void(*IIC_SERIAL_ERR_CB)(DFRobot_IIC_Serial *pSerial, uint8_t data, uint8_t lsr);
+
+#define IIC_SERIAL_TRACE_VERSION  1       //dumpTrace()输出格式的版本
+#define IIC_SERIAL_TRACE_READ     0x01    //跟踪记录flags：读事务
+#define IIC_SERIAL_TRACE_FIFO     0x02    //跟踪记录flags：FIFO访问(没有寄存器地址)
+#define IIC_SERIAL_TRACE_SHORT    0xff    //跟踪记录result：读到的字节数少于请求的
+/**
+ * @brief 一次IIC事务的跟踪记录，dumpTrace()按此顺序以小端输出，共10字节
+ */
+typedef struct{
+  uint32_t us;       /*!< 事务开始时的micros() */
+  uint8_t addr;      /*!< 7位IIC地址，含子串口通道号和寄存器/FIFO对象位 */
+  uint8_t reg;       /*!< 寄存器地址，FIFO访问为0 */
+  uint8_t flags;     /*!< IIC_SERIAL_TRACE_READ、IIC_SERIAL_TRACE_FIFO按位或 */
+  uint8_t len;       /*!< 数据字节数(不含寄存器地址) */
+  uint8_t value;     /*!< 第一个数据字节，单字节寄存器访问即为寄存器的值 */
+  uint8_t result;    /*!< 0表示成功，否则为endTransmission()的返回值或IIC_SERIAL_TRACE_SHORT */
+} __attribute__ ((packed)) sTraceRecord_t;
+
+#define IIC_SERIAL_XON   0x11    //软件流控：允许对端发送
+#define IIC_SERIAL_XOFF  0x13    //软件流控：暂停对端发送
+
+#define IIC_SERIAL_DMX_BREAK_US   176     //DMX512的Break时长，标准最小92us
+#define IIC_SERIAL_DMX_MAB_US     12      //DMX512的Mark-After-Break时长，标准最小12us
+//Break或MAB剩余时间不超过此值(us)时在函数内等待，否则返回，由poll()继续
+#ifndef IIC_SERIAL_BREAK_SPIN_US
+#define IIC_SERIAL_BREAK_SPIN_US  1000
+#endif
+
+#ifndef IIC_SERIAL_FRAME_NUM
+#define IIC_SERIAL_FRAME_NUM  4    //帧模式下主控端接收缓存中最多排队的完整帧个数
+#endif
+
 #ifdef ARDUINO_ARCH_NRF5
 class DFRobot_IIC_Serial : public _Stream{
 #else
 class DFRobot_IIC_Serial : public Stream{
 #endif
 public:
-  #define FOSC                11059851L //外部晶振频率11.059851MHz
+  #define FOSC                IIC_SERIAL_FOSC //外部晶振频率，兼容旧代码，新代码使用IIC_SERIAL_FOSC
   #define ERR_OK                0      //无错误
   #define ERR_PIN              -1      //引脚编号错误
-  #define ERR_DATA_BUS         -1
+  #define ERR_DATA_BUS         -7      //芯片应答异常(ID不符)或SDA被拉低无法释放
+  #define ERR_FOSC             -8      //编译期给出的晶振频率与芯片对象的setFosc()不一致
   #define ERR_DATA_READ        -2      //数据总线读取失败
   #define ERR_ADDR             -3      //I2C地址错误
+  #define ERR_DATA_WRITE       -4      //数据总线写入失败
+  #define ERR_BUS_OFF          -5      //芯片连续出错处于退避期，未访问总线
+  #define ERR_BUSY             -6      //上一个Break帧还未发完
   #define OBJECT_REGISTER      0x00    //寄存器对象
   #define OBJECT_FIFO          0x01    //FIFO缓存对象
   #define FSR_FLAG_ERR         0X01
@@ -131,6 +357,23 @@ public:
       uint8_t rsv : 3; /*!< 保留位 */
       uint8_t fErr: 1; /*!< 接收FIFO数据错误中断使能位，1-使能，0-禁止 */
   } __attribute__ ((packed)) sSierReg_t; 
+
+  /*
+   WK2132子串口中断标志寄存器SIFR描述，各位与SIER中的使能位一一对应:
+     * --------------------------------------------------------------------------------------------
+     * |    b7    |   b6   |   b5   |   b4   |      b3     |     b2     |     b1     |     b0     |
+     * --------------------------------------------------------------------------------------------
+     * | FERR_INT |          RSV             | TFEMPTY_INT | TFTRIG_INT | RXOVT_INT  | RFTRIG_INT |
+     * --------------------------------------------------------------------------------------------
+  */
+  typedef struct{
+      uint8_t rFTrig : 1; /*!< 接收FIFO触点中断标志，接收FIFO中的数据达到触发点 */
+      uint8_t rxOvt : 1; /*!< 接收FIFO超时中断标志，接收FIFO中有数据且线路空闲超时 */
+      uint8_t tfTrig : 1; /*!< 发送FIFO触点中断标志，发送FIFO中的数据低于触发点 */
+      uint8_t tFEmpty : 1; /*!< 发送FIFO空中断标志 */
+      uint8_t rsv : 3; /*!< 保留位 */
+      uint8_t fErr: 1; /*!< 接收FIFO数据错误中断标志 */
+  } __attribute__ ((packed)) sSifrReg_t;
   
   /*
    WK2132子串口FIFO控制寄存器FCR描述:
@@ -145,8 +388,8 @@ public:
       uint8_t tfRst : 1; /*!< 子串口发送FIFO复位位，1-复位FIFO，0-未使能复位，写1复位，完成后自动置0 */
       uint8_t rfEn : 1; /*!< 子串口接收FIFO使能位，1-使能，0-不使能 */
       uint8_t tfEn : 1; /*!< 子串口发送FIFO使能位，1-使能，0-不使能 */
-      uint8_t rfTrig : 2; /*!< 子串口接收FIFO触点设置位，00-8Byte(默认),01-16Byte,10-24Byte,11-18Byte */
-      uint8_t tfTrig: 2; /*!< 子串口接收FIFO触点设置位，00-8Byte(默认),01-16Byte,10-24Byte,11-18Byte */
+      uint8_t rfTrig : 2; /*!< 子串口接收FIFO触点设置位，00-8Byte(默认),01-16Byte,10-24Byte,11-28Byte */
+      uint8_t tfTrig: 2; /*!< 子串口发送FIFO触点设置位，00-8Byte(默认),01-16Byte,10-24Byte,11-30Byte */
   } __attribute__ ((packed)) sFcrReg_t; 
   
   /*
@@ -200,6 +443,15 @@ public:
       uint8_t rFoe : 1; /*!< 子串口接收FIFO中数据溢出出错标志位，0-无OE错误，1-有OE错误 */
   } __attribute__ ((packed)) sFsrReg_t;
 
+  /**
+   * @brief 子串口状态快照，对应连续的TFCNT(0x09)、RFCNT(0x0A)、FSR(0x0B)、LSR(0x0C)寄存器
+   */
+  typedef struct{
+      uint16_t txCount; /*!< 发送FIFO中的字节数(0~256) */
+      uint16_t rxCount; /*!< 接收FIFO中的字节数(0~256) */
+      sFsrReg_t fsr;    /*!< FIFO状态寄存器 */
+      uint8_t lsr;      /*!< 线路状态寄存器，当前接收FIFO顶部数据的错误标志 */
+  } sStatus_t;
   
   typedef enum{
       clock = 0, /*!< 操作全局控制寄存器，控制子串口时钟 */
@@ -223,6 +475,50 @@ public:
       eLineBreak
   }eLineBreakOutput_t;
 
+  typedef enum{
+      eWriteBlocking, /*!< 发送FIFO空间不足时等待FIFO腾出空间，直到全部写入或超过Stream超时时间(setTimeout) */
+      eWritePartial,  /*!< 只写入发送FIFO当前能容纳的部分，立即返回实际写入的字节数 */
+      eWriteAsync     /*!< 写入主控端发送队列后立即返回，由poll()或DFRobot_WK2132::service()在发送FIFO有空间时批量写入 */
+  }eWritePolicy_t;
+
+  /**
+   * @brief 子串口的接收错误统计，计数由读取接收FIFO时已读出的FSR得到，不额外访问总线
+   * @n 没有设置错误字节回调时，校验/停止位/Line-Break错误按"读出一批数据中出现过该错误"计1次，设置后按字节计数
+   */
+  typedef struct{
+      uint16_t parity;      /*!< 校验错误 */
+      uint16_t framing;     /*!< 停止位错误 */
+      uint16_t breaks;      /*!< Line-Break */
+      uint16_t overruns;    /*!< 接收FIFO溢出(有数据丢失)的次数 */
+      uint16_t rxHighWater; /*!< 读取时接收FIFO中字节数的最高值，接近256说明轮询或中断处理不够及时 */
+  } sLineStats_t;
+
+#if IIC_SERIAL_ENABLE_STATS
+  /**
+   * @brief 子串口的总线统计，IIC_SERIAL_ENABLE_STATS为1时有效，全局寄存器的访问计入通道1
+   */
+  typedef struct{
+      uint32_t transactions; /*!< IIC事务数，读寄存器为写地址和读数据2个事务 */
+      uint32_t bytesOut;     /*!< 主控发出的字节数(不含器件地址) */
+      uint32_t bytesIn;      /*!< 主控读到的字节数 */
+      uint32_t pageSwitches; /*!< SPAGE寄存器的写次数 */
+      uint32_t fifoFull;     /*!< 发送FIFO满导致写入被拒绝或需要等待的次数 */
+      uint32_t fifoEmpty;    /*!< 接收FIFO和主控端缓存都为空导致read()/peek()返回-1的次数 */
+      uint32_t nacks;        /*!< 从机无应答或读到的字节数不足的事务数 */
+      uint32_t latency[IIC_SERIAL_STATS_BUCKETS]; /*!< 每次寄存器/FIFO访问耗时的直方图 */
+  } sStats_t;
+#endif
+
+  /**
+   * @brief FCR寄存器中预设的FIFO中断触发点，RFTL/TFTL为0时生效
+   */
+  typedef enum{
+      eTriggerLevel8 = 0, /*!< 8字节(默认) */
+      eTriggerLevel16,    /*!< 16字节 */
+      eTriggerLevel24,    /*!< 24字节 */
+      eTriggerLevelMax    /*!< 接收FIFO为28字节，发送FIFO为30字节 */
+  }eFifoTrigger_t;
+
 public:
   /**
    * @brief 构造函数
@@ -247,13 +543,20 @@ public:
      @n IIC实际地址:_addr = (addr << 3) | SUBUART_CHANNEL_N | OBJECT_REGISTER/OBJECT_FIFO
    */
   DFRobot_IIC_Serial(TwoWire &wire = Wire, uint8_t subUartChannel = SUBUART_CHANNEL_1, uint8_t addr = 0x0E);
+  /**
+   * @brief 构造函数，从已有的芯片对象上取一个子串口通道
+   * @n 同一芯片的两个子串口共享芯片对象中的总线地址、全局寄存器和页状态
+   * @param chip DFRobot_WK2132芯片对象
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
+   */
+  DFRobot_IIC_Serial(DFRobot_WK2132 &chip, uint8_t subUartChannel);
   ~DFRobot_IIC_Serial();
 
   /**
    * @brief 初始化函数，设置子串口的波特率
    * @param baud 串口波特率
    */
-  void begin(long unsigned baud){begin(baud, IIC_SERIAL_8N1, eNormalMode, eNormal);};
+  int begin(long unsigned baud){return begin(baud, IIC_SERIAL_8N1, eNormalMode, eNormal);};
   /**
    * @brief 初始化函数，设置子串口的波特率，数据格式
    * @param baud 串口波特率
@@ -261,7 +564,7 @@ public:
    * @n IIC_SERIAL_8Z2、IIC_SERIAL_8O1、IIC_SERIAL_8O2、IIC_SERIAL_8E1、IIC_SERIAL_8E2
    * @n IIC_SERIAL_8F1、IIC_SERIAL_8F2等参数
    */
-  void begin(long unsigned baud, uint8_t format){begin(baud, format, eNormalMode, eNormal);};
+  int begin(long unsigned baud, uint8_t format){return begin(baud, format, eNormalMode, eNormal);};
    /**
    * @brief 初始化函数，设置子串口的波特率，数据格式，通信模式
    * @param baud 串口波特率
@@ -270,8 +573,8 @@ public:
    * @n IIC_SERIAL_8F1、IIC_SERIAL_8F2等参数
    * @param mode 自串口通信模式，可设置为红外模式（1）或普通模式（0），可填eCommunicationMode_t的所有枚举值，或0或1
    */
-  void begin(long unsigned baud, uint8_t format, eCommunicationMode_t mode){begin(baud, format, mode, eNormal);};
-  void begin(long unsigned baud, uint8_t format, uint8_t mode){begin(baud, format, mode, eNormal);};
+  int begin(long unsigned baud, uint8_t format, eCommunicationMode_t mode){return begin(baud, format, mode, eNormal);};
+  int begin(long unsigned baud, uint8_t format, uint8_t mode){return begin(baud, format, mode, eNormal);};
   /**
    * @brief 初始化函数，设置子串口的波特率，数据格式，通信模式，和Line-Break输出
    * @param baud 串口波特率
@@ -280,16 +583,102 @@ public:
    * @n IIC_SERIAL_8F1、IIC_SERIAL_8F2等参数
    * @param mode 自串口通信模式，可设置为红外模式（1）或普通模式（0），可填eCommunicationMode_t的所有枚举值，或0或1
    * @param opt 子串口Line-Break输出控制位，可设置为正常输出（0）和Line-Break输出（1），可填eLineBreakOutput_t的所有枚举值，或0或1
+   * @return 返回ERR_OK表示成功，ERR_DATA_READ/ERR_DATA_WRITE表示IIC读写失败，ERR_DATA_BUS表示芯片应答异常，ERR_BUS_OFF表示芯片处于退避期
+   * @n 各重载的返回值相同
+   */
+  int begin(long unsigned baud, uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt);
+  int begin(long unsigned baud, uint8_t format, uint8_t mode, uint8_t opt);
+  /**
+   * @brief 热连接初始化，用于主控复位后重新接管仍在工作的子串口
+   * @n 子串口时钟已打开时，一次读出第0页SCR~SIER和第1页BAUD1~TFTL，与要求的配置比较后只写不同的寄存器，
+   * @n 不软件复位子串口、不清空收发FIFO，复位前已收到的数据仍可读取；子串口未配置过(如芯片刚上电)时按begin()完整初始化
+   * @param baud 串口波特率
+   * @param format 子串口数据格式，同begin()
+   * @param mode 子串口通信模式，可填eCommunicationMode_t的所有枚举值
+   * @param opt 子串口Line-Break输出控制位，可填eLineBreakOutput_t的所有枚举值
+   * @n 热连接过程中任何一次IIC访问失败时也退回完整初始化
+   * @return 返回true表示热连接成功，FIFO中的数据被保留；false表示已按begin()完整初始化或芯片无应答，
+   * @n 完整初始化是否成功用getChip()->getLastError()判断
+   */
+  bool beginWarm(unsigned long baud, uint8_t format = IIC_SERIAL_8N1, eCommunicationMode_t mode = eNormalMode, eLineBreakOutput_t opt = eNormal);
+  /**
+   * @brief 获取最近一次begin()或beginWarm()的耗时
+   * @return 返回耗时，单位微秒
    */
-  void begin(long unsigned baud, uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt);
-  void begin(long unsigned baud, uint8_t format, uint8_t mode, uint8_t opt);
+  unsigned long getBeginTime(void){return _beginUs;}
 
+  /**
+   * @brief 关闭子串口的时钟和中断，并清空主控端接收缓存，再次使用前需调用begin()
+   */
   void end();
+  /**
+   * @brief 获取可读取的字节数，主控端接收缓存非空时直接返回缓存中的字节数，不访问IIC总线
+   * @n 缓存为空时，从子串口接收FIFO批量读取数据填充缓存
+   * @return 返回可读取的字节数
+   */
   virtual int available(void);
+  /**
+   * @brief 查看下一个字节但不取出，优先从主控端接收缓存中获取
+   * @return 返回下一个字节，无数据返回-1
+   */
   virtual int peek(void);
+  /**
+   * @brief 读取一个字节，优先从主控端接收缓存中获取，缓存为空时从接收FIFO批量填充
+   * @return 返回读取的字节，无数据返回-1
+   */
   virtual int read(void);
-  virtual void flush(void){}
+  /**
+   * @brief 等待发送完成：主控端发送队列清空，且发送FIFO和发送移位寄存器都为空(FSR的TDAT、TBUSY为0)
+   * @n 开启软件流控且对端暂停时继续读取接收FIFO等待XON，暂停超过Stream超时时间(setTimeout)后返回，队列中的数据保留
+   */
+  virtual void flush(void);
   virtual size_t write(uint8_t);
+  /**
+   * @brief 批量写数据到子串口发送FIFO
+   * @n 剩余空间取上次读到的值减去之后写入的字节数，用完时才重新读取，再通过FIFO地址按Wire缓存长度分包连续写入
+   * @param pBuf 要发送数据的存放缓存
+   * @param size 要发送的字节数
+   * @return 返回实际写入发送FIFO的字节数，FIFO满时的行为由setWritePolicy()决定
+   */
+  virtual size_t write(const uint8_t *pBuf, size_t size);
+  /**
+   * @brief 获取还能写入的字节数
+   * @return 异步写时返回主控端发送队列的剩余空间，否则返回发送FIFO的剩余空间
+   */
+  virtual int availableForWrite(void);
+  /**
+   * @brief 获取本通道的接收错误统计，可据此在链路变差时降低波特率
+   * @return 返回统计结构体，各项含义见sLineStats_t
+   */
+  const sLineStats_t &lineStats(void){return _lineStats;}
+  /**
+   * @brief 清零本通道的接收错误统计
+   */
+  void resetLineStats(void){memset(&_lineStats, 0, sizeof(_lineStats));}
+  /**
+   * @brief 设置错误字节回调函数，用于标记出错的数据
+   * @n 只在读出的数据中有错误(FSR错误位或FERR中断)时才逐字节读取LSR，没有错误时不增加总线访问
+   * @param cb 回调函数，原型见IIC_SERIAL_ERR_CB，传NULL取消
+   */
+  void setErrorCallback(IIC_SERIAL_ERR_CB cb){_errCb = cb;}
+#if IIC_SERIAL_ENABLE_STATS
+  /**
+   * @brief 获取本通道的总线统计，需定义IIC_SERIAL_ENABLE_STATS为1
+   * @return 返回统计结构体，各项含义见sStats_t
+   */
+  const sStats_t &stats(void){return _stats;}
+  /**
+   * @brief 清零本通道的总线统计
+   */
+  void resetStats(void){memset(&_stats, 0, sizeof(_stats));}
+#endif
+  /**
+   * @brief 读取子串口状态快照
+   * @n 芯片支持寄存器地址自动递增时(begin()中检测)，用一次4字节的连续读取得到TFCNT、RFCNT、FSR、LSR，否则依次读取4个寄存器
+   * @param pStatus 状态的存放缓存
+   * @return 返回ERR_OK表示成功，ERR_DATA_READ表示读取失败
+   */
+  int status(sStatus_t *pStatus);
   inline size_t write(unsigned long n) { return write((uint8_t)n); }
   inline size_t write(long n) { return write((uint8_t)n); }
   inline size_t write(unsigned int n) { return write((uint8_t)n); }
@@ -297,12 +686,208 @@ public:
   using Print::write; // pull in write(str) and write(buf, size) from Print
   operator bool() { return true; }
 
+  /**
+   * @brief 设置批量写时发送FIFO空间不足的处理方式，从eWriteAsync切换到其他方式前先调用flush()
+   * @param policy 可填eWritePolicy_t的所有枚举值，默认eWriteBlocking
+   */
+  void setWritePolicy(eWritePolicy_t policy){_writePolicy = policy;}
+  /**
+   * @brief 替换主控端发送队列，队列中尚未写入发送FIFO的数据会被丢弃
+   * @param pBuf 用户提供的缓存，生命周期需长于本对象，传NULL恢复为内部默认缓存
+   * @param size 缓存长度，实际可排队size-1个字节
+   */
+  void setTxBuffer(uint8_t *pBuf, uint16_t size);
+  /**
+   * @brief 异步写时把主控端发送队列中的数据批量写入发送FIFO，不等待，在loop()中调用
+   * @n 队列非空时打开发送FIFO触点中断，接了IRQ引脚时DFRobot_WK2132::service()也会自动补充发送FIFO
+   * @return 返回本次写入发送FIFO的字节数
+   */
+  int poll(void);
+
+#if IIC_SERIAL_ENABLE_RTOS
+  /**
+   * @brief 任务模式下主控端收发缓存的统计，需定义IIC_SERIAL_ENABLE_RTOS为1
+   */
+  typedef struct{
+      uint32_t rxFull;       /*!< poll()时主控端接收缓存已满、数据只能留在接收FIFO中的次数 */
+      uint32_t txFull;       /*!< write()时主控端发送队列已满的次数 */
+      uint16_t rxHighWater;  /*!< 主控端接收缓存的最高占用 */
+      uint16_t txHighWater;  /*!< 主控端发送队列的最高占用 */
+  } sRingStats_t;
+  /**
+   * @brief 设置任务模式，需定义IIC_SERIAL_ENABLE_RTOS为1，在总线任务开始调用poll()之前设置
+   * @n 任务模式下由一个总线任务循环调用poll()：把接收FIFO读入主控端接收缓存，把发送队列写入发送FIFO；
+   * @n 应用任务的read()/peek()/available()/readAvailable()只读接收缓存，write()只写发送队列，都不访问IIC总线。
+   * @n 两个缓存都是单生产者/单消费者环形缓存，读写指针各由一方修改，不需要加锁；帧模式、接收函数和流控在总线任务中处理，不适用于任务模式
+   * @param enable true打开，false恢复为调用者直接访问总线
+   */
+  void setTaskMode(bool enable);
+  const sRingStats_t &ringStats(void){return _ringStats;}
+  void resetRingStats(void){memset(&_ringStats, 0, sizeof(_ringStats));}
+#endif
+
+  /**
+   * @brief 发送"Break + Mark-After-Break + 数据"序列，用于DMX512、LIN等以Break开始一帧的协议
+   * @n 等发送FIFO中已有的数据全部发出后，置位LCR的Line-Break位保持breakUs，清除后等待mabUs，再把数据批量写入发送FIFO，
+   * @n 数据超过FIFO剩余空间时由poll()或service()(发送FIFO触点中断)继续补充；不需要重新begin()，也不复位子串口。
+   * @n 实际MAB包含写入第一包数据的IIC时间，会比mabUs长(400kHz时约0.1~1ms)。Break和MAB不超过IIC_SERIAL_BREAK_SPIN_US时在函数内等待。
+   * @n 数据缓存由调用者提供，发完(breakFrameBusy()返回false)之前不能修改；期间不要调用write()
+   * @param pBuf 要发送的数据
+   * @param size 数据长度
+   * @param breakUs Break时长(us)
+   * @param mabUs Mark-After-Break时长(us)
+   * @return 返回ERR_OK表示已开始发送，ERR_BUSY表示上一帧还未发完，其他为IIC错误
+   */
+  int sendBreakFrame(const uint8_t *pBuf, size_t size, unsigned long breakUs, unsigned long mabUs);
+  /**
+   * @brief 发送一个DMX512帧(Break、MAB、起始码和最多512个通道值)，子串口需按begin(250000, IIC_SERIAL_8N2)配置
+   * @param pUniverse 起始码(调光数据为0)和通道值
+   * @param size 数据长度，完整的一帧为513
+   * @return 同sendBreakFrame()
+   */
+  int sendDmx(const uint8_t *pUniverse, size_t size = 513){return sendBreakFrame(pUniverse, size, IIC_SERIAL_DMX_BREAK_US, IIC_SERIAL_DMX_MAB_US);}
+  /**
+   * @brief 作为LIN主机发送一帧：13位的Break、1位的分隔符、同步字节0x55、受保护ID，再跟数据和校验和
+   * @param id 帧ID，0~63，校验位由函数计算
+   * @param pData 数据，len为0时只发送帧头，由从机应答
+   * @param len 数据长度，0~8
+   * @param enhanced true使用增强型校验和(含受保护ID，LIN 2.x)，false使用经典校验和
+   * @return 同sendBreakFrame()
+   */
+  int sendLinFrame(uint8_t id, const uint8_t *pData = NULL, uint8_t len = 0, bool enhanced = true);
+  /**
+   * @brief Break帧是否还在发送(等待、Break、MAB或数据未全部写入发送FIFO)
+   */
+  bool breakFrameBusy(void){return _bfState != eBfIdle;}
+
+  /**
+   * @brief 替换主控端接收环形缓存，缓存中尚未读取的数据会被丢弃
+   * @param pBuf 用户提供的缓存，生命周期需长于本对象，传NULL恢复为内部默认缓存
+   * @param size 缓存长度，实际可缓存size-1个字节
+   */
+  void setRxBuffer(uint8_t *pBuf, uint16_t size);
+
+  /**
+   * @brief 设置本通道的中断回调函数，由DFRobot_WK2132::service()在处理完本通道的中断后调用
+   * @n 接收类中断(RFTRIG/RXOVT/FERR)发生时，数据已经批量读入主控端接收缓存，回调中直接read()即可
+   * @param cb 回调函数，原型见IIC_SERIAL_INT_CB，传NULL取消
+   */
+  void setInterruptCallback(IIC_SERIAL_INT_CB cb){_intCb = cb;}
+  /**
+   * @brief 使能一次发送FIFO空通知，发送FIFO中的数据全部发出后，回调函数收到IIC_SERIAL_INT_TFEMPTY
+   * @n 通知只触发一次，之后每次write()会自动重新使能，直到调用setTxEmptyNotify(false)
+   * @param enable true使能，false关闭
+   */
+  void setTxEmptyNotify(bool enable);
+
+  /**
+   * @brief 打开或关闭帧接收模式，用于Modbus RTU等以线路空闲间隔分帧的协议
+   * @n 帧模式下以芯片的接收FIFO超时中断(RXOVT)作为一帧的结束：中断处理时读一次状态快照、用一次连续读取取出FIFO中的数据，
+   * @n 并把帧长度和FSR中的接收错误标志记录下来。帧模式下只用readFrame()取数据，不要与read()混用。
+   * @n 用setFifoTriggerLevel()把接收触发点设得比最长的帧高时，每帧只需一次中断和一次批量读取
+   * @param enable true打开，false关闭，切换时丢弃主控端接收缓存中的数据
+   */
+  void setFrameMode(bool enable);
+  /**
+   * @brief 设置帧接收回调函数，由DFRobot_WK2132::service()在收到完整的帧后调用
+   * @param cb 回调函数，原型见IIC_SERIAL_FRAME_CB，传NULL取消
+   */
+  void setFrameCallback(IIC_SERIAL_FRAME_CB cb){_frameCb = cb;}
+  /**
+   * @brief 获取已收完、等待读取的帧个数
+   * @n 没有排队的帧且芯片没有接IRQ引脚时，先查询一次本通道的中断标志
+   * @return 返回帧个数
+   */
+  int frameAvailable(void);
+  /**
+   * @brief 取出最早收到的一帧，不等待
+   * @param pBuf 存放帧数据的缓存
+   * @param maxLen 缓存长度，帧比缓存长时多余的数据被丢弃，flags中置位IIC_SERIAL_FRAME_OVERRUN
+   * @param pFlags 帧的错误标志，IIC_SERIAL_FRAME_xxx按位或，不需要时传NULL
+   * @return 返回拷贝到pBuf中的字节数，没有完整的帧时返回0
+   */
+  uint16_t readFrame(uint8_t *pBuf, uint16_t maxLen, uint8_t *pFlags = NULL);
+
+  /**
+   * @brief 使用FCR寄存器中的预设值设置收发FIFO的中断触发点，同时将RFTL/TFTL清零使预设值生效
+   * @n 接收触发点越高，每次中断能批量读出的数据越多，中断次数越少；越低则响应越快，适合交互式的端口
+   * @n 接收超时中断(RXOVT)的超时时间由芯片固定，不可配置，数据量不足触发点时由它保证数据被及时读走
+   * @param rx 接收FIFO触发点，可填eFifoTrigger_t的所有枚举值
+   * @param tx 发送FIFO触发点，可填eFifoTrigger_t的所有枚举值
+   */
+  void setFifoTrigger(eFifoTrigger_t rx, eFifoTrigger_t tx);
+  /**
+   * @brief 通过第1页的RFTL/TFTL寄存器任意设置收发FIFO的中断触发点，非0值优先于FCR中的预设值
+   * @param rxLevel 接收FIFO触发点，1~255字节，0表示使用FCR中的预设值
+   * @param txLevel 发送FIFO触发点，1~255字节，0表示使用FCR中的预设值
+   */
+  void setFifoTriggerLevel(uint8_t rxLevel, uint8_t txLevel);
+
+  /**
+   * @brief 批量读取子串口接收FIFO中的数据，FIFO中数据不足时在Stream超时时间(setTimeout)内继续等待
+   * @param pBuf 数据的存放缓存
+   * @param size 要读取的字节数
+   * @return 返回实际读取的字节数
+   */
+  size_t readBytes(uint8_t *pBuf, size_t size);
+  size_t readBytes(char *pBuf, size_t size){return readBytes((uint8_t *)pBuf, size);}
+  /**
+   * @brief 读取子串口接收FIFO中当前已有的数据，不等待
+   * @n 只读一次RFCNT获取FIFO中的字节数，再通过FIFO地址按Wire缓存长度分包连续读出
+   * @param pBuf 数据的存放缓存
+   * @param size 缓存的长度
+   * @return 返回实际读取的字节数
+   */
+  size_t readAvailable(uint8_t *pBuf, size_t size);
+  /**
+   * @brief 设置接收数据接收函数，CRC计算、协议解析、转发等可以直接处理读出的数据，省去主控端接收缓存和用户缓存两次拷贝
+   * @n 设置后service()、available()等从接收FIFO读出的数据都交给接收函数，主控端接收缓存中已有的数据仍可用read()读取；
+   * @n 帧模式下不使用接收函数。只用接收函数时可把IIC_SERIAL_RX_BUFFER_SIZE定义得很小以节省RAM
+   * @param sink 接收函数，原型见IIC_SERIAL_RX_SINK，传NULL恢复为读入主控端接收缓存
+   */
+  void setRxSink(IIC_SERIAL_RX_SINK sink){_rxSink = sink;}
+  /**
+   * @brief 把接收FIFO中当前已有的数据读出交给接收函数，不等待，没有接IRQ引脚时在loop()中调用
+   * @return 返回读出的字节数，没有设置接收函数时返回0
+   */
+  size_t drain(void);
+
+  /**
+   * @brief 打开或关闭软件流控(XON/XOFF)
+   * @n 每次读取接收FIFO时，按主控端接收缓存中的字节数加FIFO中剩余的字节数计算水位，达到高水位时发送XOFF，降到低水位时发送XON；
+   * @n 收到对端的XOFF/XON时从数据中去掉并暂停/恢复发送：暂停期间write()的数据只放入主控端发送队列，队列满时按写入方式处理，
+   * @n 收到XON后写入发送FIFO；发送器始终使能，暂停期间本端的XOFF/XON照常发出，双方互相暂停时不会死锁，XOFF之前已在发送FIFO中的数据照常发出。
+   * @n 芯片没有优先发送通道，XOFF排在发送FIFO已有数据之后发出，高水位需留出对端在此期间继续发送的余量；数据中不能出现0x11/0x13
+   * @param enable true打开，false关闭，关闭时恢复本端发送，已发送XOFF的会补发XON
+   * @param highWater 高水位(字节)，默认192
+   * @param lowWater 低水位(字节)，默认64
+   */
+  void setFlowControl(bool enable, uint16_t highWater = 192, uint16_t lowWater = 64);
+  /**
+   * @brief 对端是否发送了XOFF，本端发送处于暂停状态
+   */
+  bool peerPaused(void){return _peerXoff;}
+
+  /**
+   * @brief 获取子串口实际的波特率，由当前的分频寄存器和芯片晶振频率算出
+   * @param pErrorPpm 实际波特率相对begin()中期望值的误差(ppm)，不需要时传NULL
+   * @return 返回实际波特率，未初始化时返回0
+   */
+  unsigned long getActualBaud(long *pErrorPpm = NULL);
+
+  /**
+   * @brief 获取本通道所属的芯片对象，begin()之前使用旧构造函数时返回NULL
+   */
+  DFRobot_WK2132 *getChip(void){return _pChip;}
+  /**
+   * @brief 获取本通道的子串口通道号
+   */
+  uint8_t getChannel(void){return _subSerialChannel;}
+
   //Interrupt handlers - Not intended to be called externally
   // inline void _rx_complete_irq(void);
   // void _tx_udr_empty_irq(void);
-  // uint8_t readFifoCache(void* pBuf, size_t size);
   // void witeByte(void *pBuf, size_t size);
-  // void writeFifo(void* pBuf, size_t size);
 
 protected:
   /**
@@ -312,40 +897,35 @@ protected:
   void subSerialConfig(uint8_t subUartChannel);
 
   /**
-   * @brief 子串口全局寄存器使能
+   * @brief 设置子串口波特率
    * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
-   * @type 全局寄存器类型，可填eGlobalRegType_t的所有枚举值
+   * @param baud 波特率
    */
-  void subSerialGlobalRegEnable(uint8_t subUartChannel, eGlobalRegType_t type);
-
+  void setSubSerialBaudRate(uint8_t subUartChannel, unsigned long baud);
   /**
-   * @brief 子串口全局寄存器禁止
-   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
-   * @param type 全局寄存器类型，可填eGlobalRegType_t的所有枚举值
+   * @brief 写入波特率分频寄存器，写入前关闭收发，写入后恢复
+   * @param baud 波特率，用于估算线路时间
+   * @param div 分频寄存器的值
    */
-  //void subSerialGlobalRegDisable(uint8_t subUartChannel, eGlobalRegType_t type);
-
+  void setSubSerialDivisor(unsigned long baud, sBaudDivisor_t div);
   /**
-   * @brief 子串口寄存器配置，如SIER、FCR、LCR寄存器的配置等等
-   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
-   * @param page 页序号，可填ePageNumber_t的所有枚举值
-   * @param reg 寄存器地址
-   * @param pValue 数据的存放缓存，1个字节
+   * @brief 查表或计算芯片晶振下的分频值，晶振为IIC_SERIAL_FOSC且为标准波特率时直接查编译期生成的表
    */
-  void subSerialRegConfig(uint8_t subUartChannel, ePageNumber_t page, uint8_t reg, void *pValue);
+  sBaudDivisor_t baudDivisor(unsigned long baud);
   /**
-   * @brief 获取全局寄存器地址
-   * @param type 全局寄存器类型，可填eGlobalRegType_t的所有枚举值
-   * @return 返回寄存器的地址
+   * @brief 初始化子串口，分频值由调用者给出，WK2132Channel在编译期算好分频值后调用
    */
-  uint8_t getGlobalRegType(eGlobalRegType_t type);
-  
+  int beginDivisor(unsigned long baud, const sBaudDivisor_t *pDiv, uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt);
   /**
-   * @brief 设置子串口波特率
-   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
-   * @param baud 波特率
+   * @brief 查找或创建芯片对象，绑定本通道并初始化芯片
+   * @return 返回ERR_OK表示芯片可用，否则为DFRobot_WK2132::begin()的错误码
    */
-  void setSubSerialBaudRate(uint8_t subUartChannel, unsigned long baud);
+  int attachChip(void);
+  /**
+   * @brief 配置波特率、数据格式并打开收发，各寄存器只写与缓存不同的值
+   * @return 返回ERR_OK表示成功，否则为配置过程中最近一次IIC访问的错误码
+   */
+  int configure(unsigned long baud, const sBaudDivisor_t *pDiv, uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt);
   /**
    * @brief 设置子串口配置寄存器
    * @param format 子串口数据格式，可填IIC_SERIAL_8N1、IIC_SERIAL_8N2、IIC_SERIAL_8Z1
@@ -356,22 +936,7 @@ protected:
    */
   void setSubSerialConfigReg(uint8_t format, eCommunicationMode_t mode, eLineBreakOutput_t opt);
 
-   /**
-   * @brief 子串口寄存器页切换
-   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
-   * @param page 页序号，可填ePageNumber_t的所有枚举值
-   * @param type 全局寄存器类型，可填eGlobalRegType_t的所有枚举值
-   */
-  void subSerialPageSwitch(uint8_t subUartChannel, ePageNumber_t page);
 
-  /**
-   * @brief 更新模块的I2C地址，每次进行IIC通信都需先更新IIC地址
-   * @param pre IIC地址的前5位，从DFRobot_WK2132构造函数中传入
-   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
-   * @param obj 要操作的对象，是寄存器还是FIFO，可填OBJECT_REGISTER或OBJECT_FIFO
-   * @return 返回值为8位IIC地址
-   */
-  uint8_t updateAddr(uint8_t pre, uint8_t subUartChannel, uint8_t obj);
   /**
    * @brief 读取FIFO状态寄存器
    * @return 返回值为sFsrReg_t结构体对象的值
@@ -379,35 +944,797 @@ protected:
   sFsrReg_t readFIFOStateReg();
 
   /**
-   * @brief 写寄存器函数
+   * @brief 写本通道的寄存器，由芯片对象完成寻址
    * @param reg  寄存器地址 8bits
    * @param pBuf 要写入数据的存放缓存
    * @param size 要写入数据的长度
+   * @return 返回ERR_OK表示成功，ERR_DATA_WRITE表示写入失败，ERR_BUS_OFF表示芯片处于退避期
    */
-  void writeReg(uint8_t reg, const void* pBuf, size_t size);
+  int writeReg(uint8_t reg, const void* pBuf, size_t size);
   /**
-   * @brief 读寄存器函数
+   * @brief 读本通道的寄存器，由芯片对象完成寻址
    * @param reg  寄存器地址 8bits
    * @param pBuf 要读取数据的存放缓存
    * @param size 要读取数据的长度
    * @return 返回实际读取的长度，返回0表示读取失败
    */
   uint8_t readReg(uint8_t reg, void* pBuf, size_t size);
+  /**
+   * @brief 通过FIFO地址(IIC地址第0位为1)连续读取接收FIFO，按IIC_SERIAL_WIRE_BUFFER_SIZE分包
+   * @param pBuf 数据的存放缓存
+   * @param size 要读取的字节数，调用者需保证不超过FIFO中已有的字节数
+   * @return 返回实际读取的字节数
+   */
+  size_t readFifoCache(void* pBuf, size_t size);
+  /**
+   * @brief 通过FIFO地址(IIC地址第0位为1)连续写入发送FIFO，按IIC_SERIAL_WIRE_BUFFER_SIZE分包
+   * @param pBuf 要写入数据的存放缓存
+   * @param size 要写入的字节数，调用者需保证不超过FIFO剩余空间
+   * @return 返回实际写入的字节数
+   */
+  size_t writeFifo(const void* pBuf, size_t size);
+  /**
+   * @brief 读取子串口接收FIFO中的字节数
+   * @return 返回接收FIFO中的字节数(0~256)，返回-1表示读取失败
+   */
+  int getRxFifoCount(void);
+  /**
+   * @brief 从子串口接收FIFO批量读取数据，填充主控端接收缓存
+   * @return 返回本次填充的字节数
+   */
+  uint16_t fillRxBuffer(int count = -1);
+  /**
+   * @brief 按Wire分包读取接收FIFO，每包交给接收函数
+   * @param count 要读取的字节数，小于0时先读取FIFO中的字节数
+   * @return 返回读出的字节数
+   */
+  uint16_t fillSink(int count);
+  /**
+   * @brief 接收数据中有错误时逐字节读取LSR和数据，统计错误并调用错误字节回调函数
+   * @param count 要读取的字节数
+   * @return 返回读出的字节数
+   */
+  uint16_t fillMarked(uint16_t count);
+  /**
+   * @brief 读取接收FIFO到主控端接收环形缓存
+   * @return 返回放入缓存的字节数(流控打开时不含XON/XOFF)
+   */
+  uint16_t fillRing(uint16_t count);
+  /**
+   * @brief 去掉数据中的XON/XOFF并更新对端的流控状态
+   * @param pBuf 数据
+   * @param size 数据长度
+   * @return 返回去掉流控字符后的长度
+   */
+  uint16_t filterFlow(uint8_t *pBuf, uint16_t size);
+  /**
+   * @brief 记录对端的流控状态，恢复时把暂停期间排队的数据写入发送FIFO
+   */
+  void setPeerPaused(bool paused);
+  /**
+   * @brief 按接收水位发送XOFF/XON，发送FIFO满时留到下次再发
+   * @param level 主控端接收缓存与接收FIFO中的字节数之和
+   */
+  void flowUpdate(uint16_t level);
+  void sendFlowChar(uint8_t c);
+  /**
+   * @brief 推进Break帧的发送，Break/MAB剩余时间短时在函数内等待，数据按发送FIFO剩余空间写入
+   * @return 返回ERR_OK，或IIC访问的错误码(此时放弃本帧)
+   */
+  int serviceBreakFrame(void);
+  /**
+   * @brief 记录读出的FSR：溢出标志读后清零，每次读到都计数；其余错误位留到读取接收FIFO时统计
+   */
+  void noteFsr(uint8_t fsr);
+  /**
+   * @brief 按FSR中记录的错误位统计一批读出的数据
+   */
+  void countRxErrors(void);
+  /**
+   * @brief 获取主控端异步发送队列中等待写入发送FIFO的字节数
+   */
+  uint16_t txBufferCount(void){return (uint16_t)(IIC_SERIAL_RING_LOAD(_txBufferHead) + _txBufferSize - IIC_SERIAL_RING_LOAD(_txBufferTail)) % _txBufferSize;}
+  /**
+   * @brief 把数据放入主控端发送队列，队列满时先poll()一次再继续放入
+   * @return 返回放入队列的字节数
+   */
+  size_t queueTx(const uint8_t *pBuf, size_t size);
+  /**
+   * @brief 把主控端发送队列中的数据全部写入发送FIFO，开启软件流控时同时读取接收FIFO以收到对端的XON/XOFF
+   * @return 队列已取空返回true，对端暂停或超过Stream超时时间没有进展返回false
+   */
+  bool drainTxBuffer(void);
+  /**
+   * @brief 获取发送FIFO的剩余空间(0~256)，返回-1表示读取失败
+   */
+  int getTxFifoSpace(void);
+  /**
+   * @brief 从主控端接收缓存取出数据，只修改尾指针
+   * @return 返回取出的字节数
+   */
+  size_t takeRxBuffer(uint8_t *pBuf, size_t size);
+#if IIC_SERIAL_ENABLE_RTOS
+  bool taskMode(void){return _taskMode;}
+#else
+  bool taskMode(void){return false;}
+#endif
+  /**
+   * @brief 等待数据时让出CPU，任务模式下休眠1ms让总线任务运行，否则同yield()
+   */
+  void waitBusTask(void){if(taskMode()) delay(1); else yield();}
+  uint16_t rxBufferCount(void){return (uint16_t)(IIC_SERIAL_RING_LOAD(_rxBufferHead) + _rxBufferSize - IIC_SERIAL_RING_LOAD(_rxBufferTail)) % _rxBufferSize;}
+  /**
+   * @brief 处理本通道的中断：读SIFR，批量读取接收FIFO，按需关闭发送FIFO空中断，并调用用户回调
+   * @return 返回本次处理的SIFR值
+   */
+  uint8_t serviceInterrupt(void);
+  /**
+   * @brief 帧模式下处理接收类中断：读状态快照记录错误标志，批量读取接收FIFO，接收超时时结束当前帧
+   */
+  void serviceFrame(uint8_t sifr);
+  /**
+   * @brief 结束当前帧，加入待读取的帧队列并调用帧接收回调函数
+   * @param flags 额外的帧标志
+   */
+  void closeFrame(uint8_t flags);
+  /**
+   * @brief 清空帧队列和当前未结束的帧
+   */
+  void resetFrames(void);
+  /**
+   * @brief 写子串口中断使能寄存器SIER，值缓存在芯片对象中
+   */
+  void writeSier(uint8_t sier);
+  /**
+   * @brief 获取芯片对象中缓存的SIER寄存器的值
+   */
+  uint8_t getSier(void);
+  /**
+   * @brief 获取当前生效的接收FIFO触发点(RFTL非0时为RFTL，否则为FCR中的预设值)
+   */
+  uint8_t getRxTriggerLevel(void);
+  /**
+   * @brief 根据计数寄存器和FSR计算FIFO中的字节数，计数为0时用FSR区分空和满(256字节)
+   */
+  void fixStatusCount(sStatus_t *pStatus);
   //void test();
   
 
 private:
+  friend class DFRobot_WK2132;
+  friend class DFRobot_WK2132_Scheduler;
+  friend class DFRobot_WK2132_Bridge;
+  DFRobot_WK2132 *_pChip;
   TwoWire *_pWire;
   uint8_t _addr;
-  uint8_t _cacheObject;
-  uint8_t _page;
   uint8_t _subSerialChannel;
-  uint8_t _rxBufferIndex;
-  //uint8_t _rxBufferTail;
-  uint8_t _txBufferIndex;
-  //uint8_t _txBufferTail;
+  eWritePolicy_t _writePolicy;
+  uint16_t _rxBufferHead;
+  uint16_t _rxBufferTail;
+  uint16_t _rxBufferSize;
+  uint16_t _txFree;
+  unsigned long _baud;
+#if IIC_SERIAL_ENABLE_STATS
+  sStats_t _stats;
+#endif
+  uint8_t *_pRxBuffer;
+  uint8_t *_pTxBuffer;
+  uint16_t _txBufferHead;
+  uint16_t _txBufferTail;
+  uint16_t _txBufferSize;
   unsigned char _rxBuffer[IIC_SERIAL_RX_BUFFER_SIZE];
   unsigned char _txBuffer[IIC_SERIAL_TX_BUFFER_SIZE];
+  IIC_SERIAL_INT_CB _intCb;
+  bool _txEmptyNotify;
+  bool _frameMode;
+  uint16_t _frameOpen;   //当前未结束的帧已读入主控端缓存的字节数
+  uint8_t _frameErr;     //当前未结束的帧累计的错误标志
+  uint8_t _frameHead;
+  uint8_t _frameCount;
+  uint16_t _frameLen[IIC_SERIAL_FRAME_NUM];
+  uint8_t _frameFlags[IIC_SERIAL_FRAME_NUM];
+  IIC_SERIAL_FRAME_CB _frameCb;
+  IIC_SERIAL_RX_SINK _rxSink;
+  IIC_SERIAL_ERR_CB _errCb;
+  sLineStats_t _lineStats;
+  uint8_t _rxErrFsr;      //最近读到的FSR中尚未统计的接收错误位
+  unsigned long _beginUs;
+  bool _flowCtrl;
+  bool _xoffSent;
+  bool _peerXoff;
+  uint8_t _flowPending;   //因发送FIFO满而未发出的XON/XOFF，0表示没有
+  uint16_t _flowHigh;
+  uint16_t _flowLow;
+  typedef enum{
+    eBfIdle = 0,
+    eBfDrain,      //等待发送FIFO和移位寄存器中已有的数据发完
+    eBfBreak,
+    eBfMab,
+    eBfData,
+  }eBreakFrameState_t;
+  uint8_t _bfState;
+  const uint8_t *_pBfData;
+  uint16_t _bfLen;
+  uint16_t _bfSent;
+  unsigned long _bfAt;
+  unsigned long _bfBreakUs;
+  unsigned long _bfMabUs;
+  uint8_t _linBuf[11];     //同步字节、受保护ID、最多8个数据和校验和
+#if IIC_SERIAL_ENABLE_RTOS
+  bool _taskMode;
+  sRingStats_t _ringStats;
+#endif
 };
 //extern DFRobot_IIC_Serial iicSerial;
-#endif
\ No newline at end of file
+
+/**
+ * @brief WK2132芯片对象，一个芯片(一个IIC地址)对应一个对象
+ * @n 芯片对象持有IIC总线、地址、全局寄存器的状态和每个子串口的页状态，两个子串口通道共用同一个芯片对象，
+ * @n 避免各自缓存的状态互相覆盖，也省去重复的全局寄存器读改写。
+ * @n 使用旧的DFRobot_IIC_Serial(wire, subUartChannel, addr)构造函数时，begin()会按总线和地址查找已有的芯片对象，找不到时自动创建。
+ */
+class DFRobot_WK2132{
+public:
+  /**
+   * @brief 芯片的健康状态
+   * @n eHealthOk：最近一次访问成功；eHealthDegraded：最近的访问在重试后仍失败；
+   * @n eHealthOffline：连续IIC_SERIAL_FAIL_LIMIT次访问失败，退避期内所有访问直接返回ERR_BUS_OFF，不占用总线
+   */
+  typedef enum{
+    eHealthOk = 0,
+    eHealthDegraded,
+    eHealthOffline,
+  }eHealth_t;
+
+  /**
+   * @brief 构造函数
+   * @param wire I2C总线对象，默认Wire
+   * @param addr 与DFRobot_IIC_Serial构造函数相同，取值(0x02/0x06/0x0A/0x0E)，默认0x0E
+   */
+  DFRobot_WK2132(TwoWire &wire = Wire, uint8_t addr = 0x0E);
+  ~DFRobot_WK2132();
+
+  /**
+   * @brief 初始化芯片，检查芯片是否在线，多次调用只检查一次
+   * @return 返回ERR_OK表示成功，ERR_DATA_READ表示IIC读取失败，ERR_DATA_BUS表示芯片应答异常
+   */
+  int begin(void);
+
+  /**
+   * @brief 获取已绑定到本芯片的子串口通道对象
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
+   * @return 返回通道对象指针，未绑定返回NULL
+   */
+  DFRobot_IIC_Serial *channel(uint8_t subUartChannel);
+
+  /**
+   * @brief 按总线和地址查找已创建的芯片对象
+   * @param wire I2C总线对象
+   * @param addr 取值(0x02/0x06/0x0A/0x0E)
+   * @return 返回芯片对象指针，不存在返回NULL
+   */
+  static DFRobot_WK2132 *find(TwoWire &wire, uint8_t addr);
+
+  TwoWire *getWire(void){return _pWire;}
+  uint8_t getAddr(void){return _addr >> 3;}
+
+  /**
+   * @brief 使用芯片的IRQ引脚工作在中断模式，IRQ引脚低电平有效
+   * @n 库会在该引脚的下降沿中断中置位标志，service()只在标志置位时才访问IIC总线，空闲时总线流量为0
+   * @param pin 与芯片IRQ引脚相连的主控引脚，需支持外部中断
+   * @return 返回ERR_OK；芯片对象超过IIC_SERIAL_CHIP_NUM个、没有可用的中断处理函数时返回ERR_ADDR，
+   * @n 此时需在自己的中断服务函数中调用handleInterrupt()
+   */
+  int attachInterruptPin(uint8_t pin);
+  /**
+   * @brief 通知芯片有中断待处理，用户自行编写中断服务函数时在其中调用
+   */
+  void IIC_SERIAL_ISR_ATTR handleInterrupt(void){_irqFlag = true;}
+  /**
+   * @brief 中断处理，在loop()中调用
+   * @n 读一次GIFR，只处理有中断标志的子串口：批量读取接收FIFO到主控端缓存，并调用各通道的中断回调函数
+   * @n 中断模式下没有待处理的中断时直接返回，不访问IIC总线；未接IRQ引脚时每次调用读一次GIFR
+   * @return 返回本次处理的子串口个数
+   */
+  int service(void);
+
+  /**
+   * @brief 写配置寄存器后是否回读校验，调试时使用，默认关闭
+   * @n 配置寄存器的值缓存在芯片对象中，关闭时写入后不再回读，值未改变的寄存器不访问总线
+   * @param enable true表示回读并通过DBG打印不一致的寄存器
+   */
+  void setVerify(bool enable){_verify = enable;}
+  /**
+   * @brief 设置芯片外部晶振频率，在子串口begin()之前调用，默认IIC_SERIAL_FOSC
+   * @param fosc 晶振频率(Hz)
+   */
+  void setFosc(unsigned long fosc){_fosc = fosc;}
+  unsigned long getFosc(void){return _fosc;}
+
+  /**
+   * @brief 设置IIC访问失败时的重试策略
+   * @n 寄存器读写失败时整次重试；FIFO读写和写FDAT寄存器只在地址无应答(未传输数据)时重试，避免重复或丢失数据
+   * @param retries 失败后最多重试的次数，默认IIC_SERIAL_RETRIES
+   * @param backoffUs 第1次重试前的等待时间(us)，之后每次加倍，默认IIC_SERIAL_BACKOFF_US
+   */
+  void setRetryPolicy(uint8_t retries, uint16_t backoffUs){_retries = retries; _backoffUs = backoffUs;}
+  /**
+   * @brief 设置总线恢复使用的SDA、SCL引脚，芯片进入退避时自动执行一次recoverBus()
+   * @param sda 与IIC总线SDA相连的引脚
+   * @param scl 与IIC总线SCL相连的引脚
+   */
+  void setRecoveryPins(uint8_t sda, uint8_t scl){_sdaPin = sda; _sclPin = scl;}
+  /**
+   * @brief 总线恢复：从机拉住SDA时，在SCL上输出最多9个时钟让其释放SDA，再发出STOP并重新初始化IIC
+   * @return 返回ERR_OK表示SDA已释放，ERR_PIN表示未设置引脚，ERR_DATA_BUS表示SDA仍被拉低
+   */
+  int recoverBus(void);
+  /**
+   * @brief 获取芯片的健康状态，退避期已过时返回eHealthDegraded，下一次访问即为探测
+   */
+  eHealth_t getHealth(void);
+  /**
+   * @brief 获取重试后仍失败的访问次数(累计)
+   */
+  uint32_t getErrorCount(void){return _errorCount;}
+  /**
+   * @brief 获取最近一次失败访问的错误码，ERR_OK表示还没有失败过
+   */
+  int getLastError(void){return _lastErr;}
+
+#if IIC_SERIAL_ENABLE_RTOS
+  /**
+   * @brief 总线锁的统计，同一条IIC总线上的芯片共用一份，需定义IIC_SERIAL_ENABLE_RTOS为1
+   */
+  typedef struct{
+      uint32_t locks;      /*!< 取得总线锁的次数，同一任务的嵌套加锁不计 */
+      uint32_t contended;  /*!< 总线被其他任务占用、需要等待的次数 */
+      uint32_t waitUs;     /*!< 等待总线锁的累计时间(us) */
+      uint32_t maxWaitUs;  /*!< 单次等待的最长时间(us) */
+  } sLockStats_t;
+  /**
+   * @brief 占用本芯片所在的IIC总线，同一任务可嵌套调用，需与unlock()成对调用
+   * @n 库内部的每次寄存器/FIFO访问、页切换到切回第0页的一组访问都已加锁；应用需要几次调用之间不被其他任务插入时自行加锁。
+   * @n IIC_SERIAL_ENABLE_RTOS为0时为空函数
+   */
+  void lock(void);
+  void unlock(void);
+  const sLockStats_t &lockStats(void);
+  void resetLockStats(void);
+#else
+  void lock(void){}
+  void unlock(void){}
+#endif
+
+#if IIC_SERIAL_ENABLE_TRACE
+  /**
+   * @brief 导出跟踪记录，需定义IIC_SERIAL_ENABLE_TRACE为1
+   * @n 格式：8字节文件头("WKTR"、版本、单条记录长度、记录条数)，之后为按时间顺序的记录，见sTraceRecord_t
+   * @param out 输出对象，如Serial或文件
+   * @param hex true输出十六进制文本(文件头和每条记录各一行)，false输出二进制
+   * @return 返回输出的字节数(十六进制时为转换前的字节数)
+   */
+  size_t dumpTrace(Print &out, bool hex = false);
+  void clearTrace(void){_traceHead = 0; _traceCount = 0;}
+  uint16_t traceCount(void){return _traceCount;}
+#endif
+
+protected:
+  friend class DFRobot_IIC_Serial;
+  friend class DFRobot_WK2132_Scheduler;
+  typedef DFRobot_IIC_Serial::ePageNumber_t ePageNumber_t;
+  typedef DFRobot_IIC_Serial::eGlobalRegType_t eGlobalRegType_t;
+  typedef DFRobot_IIC_Serial::sIICAddr_t sIICAddr_t;
+
+  /**
+   * @brief 绑定/解绑子串口通道对象
+   */
+  void attachChannel(DFRobot_IIC_Serial *pSerial);
+  void detachChannel(DFRobot_IIC_Serial *pSerial);
+
+  /**
+   * @brief 子串口全局寄存器使能，全局寄存器的值缓存在芯片对象中，只在首次访问时读取
+   * @n 对rst类型，复位子串口，复位后该子串口的寄存器缓存恢复为芯片默认值
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1、SUBUART_CHANNEL_2或SUBUART_CHANNEL_ALL
+   * @param type 全局寄存器类型，可填eGlobalRegType_t的所有枚举值
+   */
+  void subSerialGlobalRegEnable(uint8_t subUartChannel, eGlobalRegType_t type);
+  /**
+   * @brief 子串口全局寄存器禁止，清除子串口在GENA或GIER中对应的位
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1、SUBUART_CHANNEL_2或SUBUART_CHANNEL_ALL
+   * @param type 全局寄存器类型，可填clock或intrpt
+   */
+  void subSerialGlobalRegDisable(uint8_t subUartChannel, eGlobalRegType_t type);
+
+  /**
+   * @brief 子串口寄存器配置，如SIER、FCR、LCR寄存器的配置等等，整个寄存器写入pValue的值
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
+   * @param page 页序号，可填ePageNumber_t的所有枚举值
+   * @param reg 寄存器地址
+   * @param pValue 数据的存放缓存，1个字节
+   */
+  void subSerialRegConfig(uint8_t subUartChannel, ePageNumber_t page, uint8_t reg, void *pValue);
+  /**
+   * @brief 按位修改子串口配置寄存器，新值为(缓存值 & ~mask) | (value & mask)
+   * @n 寄存器的值缓存在芯片对象中，新值与缓存相同时不访问总线，需要写入时才切换到目标页
+   * @n FCR的复位位写1后由芯片自动清零，不计入缓存，写1时总会写入
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
+   * @param page 页序号，可填ePageNumber_t的所有枚举值
+   * @param reg 寄存器地址，第0页SCR~SIER，第1页BAUD1~TFTL
+   * @param mask 要修改的位
+   * @param value 要修改的位的新值
+   * @return 返回ERR_OK表示成功，ERR_DATA_READ表示读取或回读校验失败
+   */
+  int subSerialRegUpdate(uint8_t subUartChannel, ePageNumber_t page, uint8_t reg, uint8_t mask, uint8_t value);
+  /**
+   * @brief 获取子串口配置寄存器的缓存值，缓存无效时从芯片读取一次
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
+   * @param page 页序号，可填ePageNumber_t的所有枚举值
+   * @param reg 寄存器地址，第0页SCR~SIER，第1页BAUD1~TFTL
+   * @return 返回寄存器的值
+   */
+  uint8_t subSerialRegShadow(uint8_t subUartChannel, ePageNumber_t page, uint8_t reg);
+
+  /**
+   * @brief 检测芯片是否支持寄存器地址自动递增的连续读取，只检测一次
+   * @n 连续读取第0页SCR~SIER，与缓存的值比较，需在子串口配置完成后调用
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
+   */
+  void probeBurstRead(uint8_t subUartChannel);
+  /**
+   * @brief 从芯片读出子串口的配置寄存器(第0页SCR~SIER、第1页BAUD1~TFTL)填入缓存，热连接时使用
+   * @n 读到的4个第0页寄存器互不相同时即可确认支持连续读取，否则逐个读取
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
+   * @return 返回ERR_OK表示成功，ERR_DATA_READ表示读取失败
+   */
+  int loadShadows(uint8_t subUartChannel);
+
+  /**
+   * @brief 获取全局寄存器地址
+   * @param type 全局寄存器类型，可填eGlobalRegType_t的所有枚举值
+   * @return 返回寄存器的地址
+   */
+  uint8_t getGlobalRegType(eGlobalRegType_t type);
+
+  /**
+   * @brief 子串口寄存器页切换，每个子串口当前所在的页缓存在芯片对象中，已在目标页时不访问总线
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
+   * @param page 页序号，可填ePageNumber_t的所有枚举值
+   */
+  void subSerialPageSwitch(uint8_t subUartChannel, ePageNumber_t page);
+
+  /**
+   * @brief 计算子串口寄存器或FIFO对应的IIC地址，_addr中已存放移位后的地址前缀
+   * @param subUartChannel 子串口通道号，可填SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
+   * @param obj 要操作的对象，是寄存器还是FIFO，可填OBJECT_REGISTER或OBJECT_FIFO
+   * @return 返回值为IIC地址
+   */
+  uint8_t updateAddr(uint8_t subUartChannel, uint8_t obj){return _addr | (subUartChannel << 1) | obj;}
+
+  /**
+   * @brief 写寄存器函数
+   * @param subUartChannel 子串口通道号，全局寄存器可填任意通道
+   * @param reg  寄存器地址 8bits
+   * @param pBuf 要写入数据的存放缓存
+   * @param size 要写入数据的长度
+   * @return 返回ERR_OK表示成功，ERR_DATA_WRITE表示重试后仍失败，ERR_BUS_OFF表示芯片处于退避期
+   */
+  int writeReg(uint8_t subUartChannel, uint8_t reg, const void* pBuf, size_t size);
+  /**
+   * @brief 读寄存器函数
+   * @param subUartChannel 子串口通道号，全局寄存器可填任意通道
+   * @param reg  寄存器地址 8bits
+   * @param pBuf 要读取数据的存放缓存
+   * @param size 要读取数据的长度
+   * @return 返回实际读取的长度，返回0表示读取失败，失败时pBuf清零，不会留下旧数据
+   */
+  uint8_t readReg(uint8_t subUartChannel, uint8_t reg, void* pBuf, size_t size);
+  /**
+   * @brief 通过FIFO地址连续读取子串口接收FIFO，按IIC_SERIAL_WIRE_BUFFER_SIZE分包
+   * @return 返回实际读取的字节数
+   */
+  size_t readFifo(uint8_t subUartChannel, void* pBuf, size_t size);
+  /**
+   * @brief 通过FIFO地址连续写入子串口发送FIFO，按IIC_SERIAL_WIRE_BUFFER_SIZE分包
+   * @return 返回实际写入的字节数
+   */
+  size_t writeFifo(uint8_t subUartChannel, const void* pBuf, size_t size);
+
+private:
+  TwoWire *_pWire;
+  uint8_t _addr;
+  bool _ready;
+  bool _autoCreated;
+  uint8_t _page[2];
+  uint8_t _gena;
+  uint8_t _gier;
+  uint8_t _globalValid;
+  uint8_t _reg[2][IIC_SERIAL_SHADOW_NUM];
+  uint16_t _regValid[2];
+  bool _verify;
+  bool _burstRead;
+  bool _burstProbed;
+  DFRobot_IIC_Serial *_channel[2];
+  uint8_t _irqPin;
+  volatile bool _irqFlag;
+  unsigned long _fosc;
+  uint8_t _retries;
+  uint16_t _backoffUs;
+  uint8_t _sdaPin;
+  uint8_t _sclPin;
+  uint8_t _failCount;       //连续失败的访问次数
+  bool _offline;
+  unsigned long _offlineAt;
+  unsigned long _holdUs;    //本次退避的时长，每次再进入退避时加倍
+  uint32_t _errorCount;
+  int _lastErr;
+#if IIC_SERIAL_ENABLE_RTOS
+  typedef struct{
+      TwoWire *pWire;
+      SemaphoreHandle_t mutex;
+      uint8_t depth;        //持有锁的任务嵌套加锁的层数，只由持有者修改
+      sLockStats_t stats;
+  } sBus_t;
+  static sBus_t _busList[IIC_SERIAL_BUS_NUM];
+  sBus_t *_pBus;
+  /**
+   * @brief 查找总线对应的锁，第一次使用的总线创建互斥锁
+   * @n 在构造函数中调用，第一次用某个TwoWire构造芯片对象(包括旧构造函数在begin()中自动创建)需在多个任务使用该总线之前
+   * @return 返回总线记录，超过IIC_SERIAL_BUS_NUM或创建失败返回NULL(该总线不加锁)
+   */
+  static sBus_t *findBus(TwoWire *pWire);
+#endif
+#if IIC_SERIAL_ENABLE_TRACE
+  sTraceRecord_t _trace[IIC_SERIAL_TRACE_SIZE];
+  uint16_t _traceHead;
+  uint16_t _traceCount;
+  /**
+   * @brief 记录一次IIC事务，环形缓存满时覆盖最早的记录
+   */
+  void traceRecord(uint8_t addr, uint8_t reg, uint8_t flags, uint8_t len, uint8_t value, uint8_t result, unsigned long start);
+  size_t traceWrite(Print &out, const uint8_t *pBuf, size_t size, bool hex);
+#endif
+  static DFRobot_WK2132 *_chipList[IIC_SERIAL_CHIP_NUM];
+  /**
+   * @brief 配置寄存器在缓存中的序号，第0页SCR~SIER为0~3，第1页BAUD1~TFTL为4~8，不缓存的寄存器返回-1
+   */
+  int8_t shadowIndex(ePageNumber_t page, uint8_t reg);
+  /**
+   * @brief 按位修改GENA或GIER，新值与缓存相同时不访问总线
+   */
+  void globalRegUpdate(eGlobalRegType_t type, uint8_t mask, uint8_t value);
+  /**
+   * @brief 芯片处于退避期时返回false，调用者不访问总线，直接返回ERR_BUS_OFF
+   */
+  bool busAllowed(void);
+  /**
+   * @brief 记录一次访问(含重试)的结果，更新健康状态，连续失败达到上限时进入退避
+   * @param err ERR_OK表示成功，否则为错误码
+   */
+  void noteAccess(int err);
+  /**
+   * @brief 第attempt次重试前等待，attempt从0开始
+   */
+  void retryWait(uint8_t attempt){delayMicroseconds((unsigned long)_backoffUs << attempt);}
+#if IIC_SERIAL_ENABLE_STATS
+  /**
+   * @brief 把一次寄存器/FIFO访问计入通道的总线统计
+   * @param transactions 本次访问的IIC事务数
+   * @param nack 本次访问是否有事务失败
+   * @param start 访问开始时的micros()
+   */
+  void recordStats(uint8_t subUartChannel, uint8_t transactions, size_t bytesOut, size_t bytesIn, bool nack, unsigned long start);
+#endif
+  template<uint8_t index> static void IIC_SERIAL_ISR_ATTR irqHandler(void){
+    if(_chipList[index]) _chipList[index]->_irqFlag = true;
+  }
+  /**
+   * @brief 编译期展开的中断处理函数表，sIrqTable<IIC_SERIAL_CHIP_NUM>覆盖_chipList的每个位置
+   */
+  template<uint8_t count> struct sIrqTable{
+    static void (*handler(uint8_t index))(void){
+      return (index == count - 1) ? irqHandler<count - 1> : sIrqTable<count - 1>::handler(index);
+    }
+  };
+};
+
+template<> struct DFRobot_WK2132::sIrqTable<0>{
+  static void (*handler(uint8_t index))(void){return NULL;}
+};
+
+//调度器管理的芯片个数上限，一条IIC总线最多4个地址
+#ifndef IIC_SERIAL_SCHED_CHIP_NUM
+#define IIC_SERIAL_SCHED_CHIP_NUM  4
+#endif
+
+/**
+ * @brief 同一条IIC总线上多个WK2132芯片(最多4个地址×2个子串口=8个串口)的轮询调度器
+ * @n 每轮对每个芯片读一次GIFR(接了IRQ引脚且没有中断时不读)，只服务有中断标志的子串口，
+ * @n 有多个子串口待处理时，按接收FIFO估计的剩余时间(由触发点、等待时间和波特率估算)从短到长依次服务，
+ * @n 剩余时间相同的按轮转顺序，保证各端口公平；可设置每轮最多服务的端口数和端口的最大轮询间隔。
+ */
+class DFRobot_WK2132_Scheduler{
+public:
+  /**
+   * @brief 单个端口的调度统计
+   */
+  typedef struct{
+      uint32_t services;     /*!< 被服务的次数 */
+      uint32_t forced;       /*!< 没有中断标志、因超过最大轮询间隔而被服务的次数 */
+      uint32_t maxLatencyUs; /*!< 从发现中断标志到被服务的最长等待时间 */
+  } sPortStats_t;
+
+  /**
+   * @brief 构造函数
+   * @param wire 调度器管理的IIC总线
+   */
+  DFRobot_WK2132_Scheduler(TwoWire &wire = Wire);
+
+  /**
+   * @brief 加入一个芯片，芯片上已绑定的子串口都由调度器服务
+   * @param chip 芯片对象，需与调度器在同一条IIC总线上
+   * @return 返回ERR_OK表示成功，ERR_ADDR表示总线不同、已加入或超过IIC_SERIAL_SCHED_CHIP_NUM
+   */
+  int addChip(DFRobot_WK2132 &chip);
+  /**
+   * @brief 加入本总线上所有已创建的芯片对象，包括旧构造函数在begin()中自动创建的，需在各子串口begin()之后调用
+   * @return 返回加入的芯片个数
+   */
+  int begin(void);
+
+  /**
+   * @brief 设置端口的最大轮询间隔，超过该时间没有被服务的端口即使没有中断标志也会被服务一次
+   * @param us 最大轮询间隔(微秒)，0表示不限制(默认)，只依靠芯片的触发点和接收超时中断
+   */
+  void setMaxPollInterval(unsigned long us){_maxIntervalUs = us;}
+  /**
+   * @brief 设置每次run()最多服务的端口数，用于限制单次run()占用的时间，没有服务到的端口在下次run()中优先
+   * @param num 端口数，0表示不限制(默认)
+   */
+  void setMaxPerRun(uint8_t num){_maxPerRun = num;}
+
+  /**
+   * @brief 执行一轮调度，在loop()中调用
+   * @n 被服务的端口：读取SIFR、把接收FIFO批量读入主控端缓存、补充异步发送队列，并调用端口的中断回调函数
+   * @return 返回本轮服务的端口数
+   */
+  int run(void);
+
+  /**
+   * @brief 获取端口的调度统计
+   * @param serial 子串口对象
+   * @return 返回统计结构体，端口不在调度器中时各项为0
+   */
+  sPortStats_t getStats(DFRobot_IIC_Serial &serial);
+
+private:
+  /**
+   * @brief 估计端口接收FIFO溢出前还剩的时间(微秒)
+   */
+  unsigned long slackUs(uint8_t port, unsigned long now);
+  void servicePort(uint8_t port);
+
+  TwoWire *_pWire;
+  DFRobot_WK2132 *_chip[IIC_SERIAL_SCHED_CHIP_NUM];
+  uint8_t _chipNum;
+  unsigned long _maxIntervalUs;
+  uint8_t _maxPerRun;
+  uint8_t _rr;
+  uint8_t _pending[IIC_SERIAL_SCHED_CHIP_NUM * 2];   //0-无，1-有中断标志，2-超过最大轮询间隔
+  uint16_t _level[IIC_SERIAL_SCHED_CHIP_NUM * 2];
+  unsigned long _pendingUs[IIC_SERIAL_SCHED_CHIP_NUM * 2];
+  unsigned long _lastUs[IIC_SERIAL_SCHED_CHIP_NUM * 2];
+  sPortStats_t _stats[IIC_SERIAL_SCHED_CHIP_NUM * 2];
+};
+
+//转发桥每个方向在主控端暂存数据的缓存长度，目标发送FIFO满时数据暂存在这里，源接收FIFO继续被读空
+#ifndef IIC_SERIAL_BRIDGE_BUFFER_SIZE
+#define IIC_SERIAL_BRIDGE_BUFFER_SIZE  128
+#endif
+
+/**
+ * @brief 透明转发桥：在两个子串口之间(可以在不同芯片上)，或主控串口(Serial等Stream)与子串口之间双向转发数据
+ * @n 每次run()对每个方向：把源接收FIFO批量读入暂存缓存，再按目标发送FIFO的剩余空间批量写入，
+ * @n 目标FIFO满时数据留在暂存缓存中，下次run()优先写出，不丢数据；暂存缓存满时不再读源，数据留在源接收FIFO中。
+ * @n 按Wire缓存分包读写，每个字节平均约1/32次IIC事务，逐字节read()/write()约需4次。
+ * @n 桥接期间两个子串口由转发桥独占，不要再调用它们的读写函数；主控串口一侧按Stream::write()阻塞写入。
+ */
+class DFRobot_WK2132_Bridge{
+public:
+  /**
+   * @brief 单个方向的转发统计
+   */
+  typedef struct{
+      uint32_t forwarded;    /*!< 已写入目标的字节数 */
+      uint32_t held;         /*!< 读出后目标FIFO已满、暂存到下次run()再写出的字节数，即逐字节转发时会丢失的数据 */
+      uint16_t maxHeld;      /*!< 暂存缓存的最高占用 */
+  } sBridgeStats_t;
+
+  /**
+   * @brief 构造函数，在两个子串口之间转发
+   * @param a 子串口a，方向0为a->b
+   * @param b 子串口b，方向1为b->a
+   */
+  DFRobot_WK2132_Bridge(DFRobot_IIC_Serial &a, DFRobot_IIC_Serial &b);
+  /**
+   * @brief 构造函数，在主控串口和子串口之间转发
+   * @param host 主控串口，如Serial，方向0为host->b
+   * @param b 子串口，方向1为b->host
+   */
+  DFRobot_WK2132_Bridge(Stream &host, DFRobot_IIC_Serial &b);
+
+  /**
+   * @brief 执行一次双向转发，在loop()中调用，调用间隔需短于接收FIFO在线速下填满的时间(115200时约22ms)
+   * @return 返回本次写入目标的字节数(两个方向之和)
+   */
+  size_t run(void);
+
+  /**
+   * @brief 获取某个方向的转发统计
+   * @param dir 0表示a(或host)->b，1表示b->a(或host)
+   */
+  const sBridgeStats_t &stats(uint8_t dir){return _stats[dir & 0x01];}
+  void resetStats(void){memset(_stats, 0, sizeof(_stats));}
+
+private:
+  /**
+   * @brief 把一个方向暂存的数据写入目标，按目标发送FIFO的剩余空间写，写不下的部分保留
+   * @return 返回写入的字节数
+   */
+  size_t flushHeld(uint8_t dir);
+  /**
+   * @brief 从一侧读取数据，子串口一侧读主控端缓存和接收FIFO，主控串口一侧只读已收到的字节
+   */
+  size_t pull(uint8_t side, uint8_t *pBuf, size_t size);
+  /**
+   * @brief 向一侧写入数据，子串口一侧不超过发送FIFO的剩余空间
+   */
+  size_t push(uint8_t side, const uint8_t *pBuf, size_t size);
+
+  DFRobot_IIC_Serial *_pSerial[2];   //主控串口一侧为NULL
+  Stream *_pHost;
+  uint8_t _buf[2][IIC_SERIAL_BRIDGE_BUFFER_SIZE];
+  uint16_t _len[2];
+  sBridgeStats_t _stats[2];
+};
+
+/**
+ * @brief 通道号和波特率在编译期检查的子串口包装，适合Flash紧张的板子(如ATmega328)
+ * @n 非法的通道号和波特率在编译时报错；begin<BAUD>()的分频值在编译期算好，不链接运行时的32位除法
+ * @n 只做类型检查，IIC地址和收发路径与DFRobot_IIC_Serial相同，由芯片对象在运行时组合；与同一芯片上的另一个子串口共用芯片对象
+ * @param CHANNEL 子串口通道号，SUBUART_CHANNEL_1或SUBUART_CHANNEL_2
+ */
+template<uint8_t CHANNEL>
+class WK2132Channel : public DFRobot_IIC_Serial{
+  static_assert(CHANNEL == SUBUART_CHANNEL_1 || CHANNEL == SUBUART_CHANNEL_2, "WK2132 channel must be SUBUART_CHANNEL_1 or SUBUART_CHANNEL_2");
+public:
+  /**
+   * @brief 构造函数
+   * @param chip 芯片对象
+   */
+  WK2132Channel(DFRobot_WK2132 &chip)
+    :DFRobot_IIC_Serial(chip, CHANNEL){}
+
+  using DFRobot_IIC_Serial::begin;
+  /**
+   * @brief 初始化函数，波特率在编译期确定，超出晶振支持范围或误差超过2%时编译报错
+   * @n 模板参数BAUD为波特率，XTAL为晶振频率(默认IIC_SERIAL_FOSC，需与芯片对象的setFosc()一致)
+   * @param format 子串口数据格式，同DFRobot_IIC_Serial::begin()
+   * @param mode 子串口通信模式，可填eCommunicationMode_t的所有枚举值
+   * @param opt 子串口Line-Break输出控制位，可填eLineBreakOutput_t的所有枚举值
+   * @return 同DFRobot_IIC_Serial::begin()；芯片对象的晶振频率不是XTAL时返回ERR_FOSC，不访问总线
+   */
+  template<unsigned long BAUD, unsigned long XTAL = IIC_SERIAL_FOSC>
+  int begin(uint8_t format = IIC_SERIAL_8N1, eCommunicationMode_t mode = eNormalMode, eLineBreakOutput_t opt = eNormal){
+    static_assert(BAUD > 0 && BAUD * 16 <= XTAL, "baud rate out of range for the crystal");
+    static_assert(wk2132BaudErrorPpm(XTAL, BAUD) < 20000 && wk2132BaudErrorPpm(XTAL, BAUD) > -20000, "baud rate error over 2% for the crystal");
+    static constexpr sBaudDivisor_t div = wk2132BaudDivisor(XTAL, BAUD);
+    if(getChip()->getFosc() != XTAL){
+        DBG("crystal mismatch");
+        return ERR_FOSC;
+    }
+    return beginDivisor(BAUD, &div, format, mode, opt);
+  }
+};
+
+#endif
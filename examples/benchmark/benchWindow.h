@@ -0,0 +1,29 @@
+/*!
+ * @file benchWindow.h
+ * @brief 基准测试的时间窗口计算，全部按32位无符号数计算，与AVR、ESP32上的unsigned long一致
+ * @n 先求每字节的时间(0.1us为单位)再乘字节数，避免字节数×10^7在32位下溢出；主机端host_check用同样的函数检查
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#ifndef __BENCH_WINDOW_H
+#define __BENCH_WINDOW_H
+
+#include <stdint.h>
+
+/*一个字节(10位)在线路上的时间，单位0.1us；691200波特率时约145，9600波特率时约10417*/
+static inline uint32_t benchByteTenthUs(uint32_t baud){
+  return (uint32_t)100000000UL / baud;
+}
+
+/*发送阶段：2倍线速时间加100ms，bytes不超过baud/40时最大约2.6s*/
+static inline uint32_t benchSendUs(uint32_t bytes, uint32_t baud){
+  return bytes * benchByteTenthUs(baud) / 10 * 2 + (uint32_t)100000UL;
+}
+
+/*排空阶段：发送FIFO和接收FIFO中最多各有256字节在途，再加20ms*/
+static inline uint32_t benchDrainUs(uint32_t baud){
+  return (uint32_t)512 * benchByteTenthUs(baud) / 10 + (uint32_t)20000UL;
+}
+
+#endif
@@ -0,0 +1,227 @@
+/*!
+ * @file benchmark.ino
+ * @brief 驱动性能基准：回环吞吐量、往返延迟、每个有效字节的IIC事务数和最高可持续波特率
+ * @n 实验现象：将子串口1、子串口2各自的TX引脚和RX引脚相连，串口以115200打印结果，每项结果为一行JSON，
+ * @n 其他提示文字不以'{'开头。把串口输出保存为文件后，在主机上用test/host中的wk2132_bench与基线比较：
+ * @n   wk2132_bench baseline.jsonl result.txt
+ * @n 吞吐量：IIC时钟100k/400k/1M × 各标准波特率 × 子串口1、子串口2、两个同时，每轮发送约0.25秒线速的数据并逐字节校验
+ * @n 延迟：发送1个字节到从接收FIFO读回的时间
+ * @n 最高可持续波特率：两个子串口同时满速收发，从低到高找出不丢数据且达到95%线速的最高波特率
+ * @n 事务数需要以-DIIC_SERIAL_ENABLE_STATS=1编译库，否则输出null
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ * @get from https://www.dfrobot.com
+ * @url https://github.com/DFRobot/DFRobot_IIC_Serial
+ */
+#include <DFRobot_WK2132.h>
+#include "benchWindow.h"
+
+#define BENCH_VERSION      1
+#define LATENCY_ROUNDS     20
+#define PASS_PERCENT       95    /*达到线速的百分比，低于它认为驱动跟不上*/
+
+DFRobot_WK2132 board(Wire, /*addr = */0x0E);
+DFRobot_IIC_Serial iicSerial1(board, /*subUartChannel =*/SUBUART_CHANNEL_1);
+DFRobot_IIC_Serial iicSerial2(board, /*subUartChannel =*/SUBUART_CHANNEL_2);
+DFRobot_IIC_Serial *ports[2] = {&iicSerial1, &iicSerial2};
+
+const unsigned long i2cClocks[] = {100000, 400000, 1000000};
+const unsigned long bauds[] = {9600, 57600, 115200, 230400, 460800, 691200};
+const char *chName[] = {"", "1", "2", "both"};
+
+uint8_t buf[64];
+
+typedef struct{
+  unsigned long bytes;      /*每个子串口要发送的字节数*/
+  unsigned long sent;       /*所有子串口实际写入发送FIFO的字节数，总线跟不上时在超时前写不完*/
+  unsigned long received;   /*所有子串口收到的字节数，与sent之差为丢失的字节*/
+  unsigned long errors;     /*内容不符的字节数*/
+  unsigned long us;
+  unsigned long transactions;
+} sRun_t;
+
+/*测试数据：第i个字节为(i*7+通道号)，接收端据此校验*/
+uint8_t pattern(uint8_t ch, unsigned long i){
+  return (uint8_t)(i * 7 + ch);
+}
+
+void beginPorts(unsigned long baud, unsigned long clock){
+  for(uint8_t ch = 0; ch < 2; ch++){
+    ports[ch]->begin(baud);
+    ports[ch]->setWritePolicy(DFRobot_IIC_Serial::eWritePartial);
+#if IIC_SERIAL_ENABLE_STATS
+    ports[ch]->resetStats();
+#endif
+  }
+  Wire.setClock(clock);
+}
+
+/*mask的bit0为子串口1，bit1为子串口2，每个子串口发送bytes个字节并同时读回
+  超过2倍线速时间后不再写入，只把已发出的数据读完，吞吐量按收到的字节和总耗时计算*/
+sRun_t pump(uint8_t mask, unsigned long baud, unsigned long bytes){
+  sRun_t r = {bytes, 0, 0, 0, 0, 0};
+  unsigned long tx[2] = {0, 0}, rx[2] = {0, 0};
+  unsigned long sendUs = benchSendUs(bytes, baud);
+  unsigned long drainUs = benchDrainUs(baud);
+  unsigned long start = micros();
+  bool done = false;
+  while(!done && micros() - start < sendUs + drainUs){
+    bool sending = micros() - start < sendUs;
+    done = true;
+    for(uint8_t ch = 0; ch < 2; ch++){
+      if(!(mask & (1 << ch))){
+        continue;
+      }
+      if(sending && tx[ch] < bytes){
+        unsigned long n = bytes - tx[ch];
+        if(n > sizeof(buf)) n = sizeof(buf);
+        for(uint8_t i = 0; i < n; i++){
+          buf[i] = pattern(ch, tx[ch] + i);
+        }
+        tx[ch] += ports[ch]->write(buf, n);
+      }
+      size_t got = ports[ch]->readAvailable(buf, sizeof(buf));
+      for(size_t i = 0; i < got; i++){
+        if(buf[i] != pattern(ch, rx[ch] + i)){
+          r.errors++;
+        }
+      }
+      rx[ch] += got;
+      if(rx[ch] < (sending ? bytes : tx[ch])){
+        done = false;
+      }
+    }
+  }
+  r.us = micros() - start;
+  r.sent = tx[0] + tx[1];
+  r.received = rx[0] + rx[1];
+#if IIC_SERIAL_ENABLE_STATS
+  r.transactions = iicSerial1.stats().transactions + iicSerial2.stats().transactions;
+#endif
+  return r;
+}
+
+void printTxnPerByte(const sRun_t &r){
+  Serial.print(",\"txn_per_byte\":");
+#if IIC_SERIAL_ENABLE_STATS
+  Serial.print(r.received ? (double)r.transactions / r.received : 0.0, 3);
+#else
+  Serial.print("null");
+#endif
+}
+
+/*返回实际吞吐量占线速(10位/字节)的百分比*/
+unsigned long linePercent(const sRun_t &r, uint8_t mask, unsigned long baud){
+  unsigned long lanes = (mask == 3) ? 2 : 1;
+  double bps = r.us ? (double)r.received * 1000000.0 / r.us : 0;
+  return (unsigned long)(bps * 10 * 100 / ((double)baud * lanes) + 0.5);
+}
+
+void throughput(unsigned long clock, unsigned long baud, uint8_t mask){
+  beginPorts(baud, clock);
+  unsigned long bytes = baud / 40;
+  if(bytes < 256) bytes = 256;
+  sRun_t r = pump(mask, baud, bytes);
+  unsigned long lanes = (mask == 3) ? 2 : 1;
+  Serial.print("{\"test\":\"throughput\",\"i2c\":");
+  Serial.print(clock);
+  Serial.print(",\"baud\":");
+  Serial.print(baud);
+  Serial.print(",\"ch\":\"");
+  Serial.print(chName[mask]);
+  Serial.print("\",\"bytes\":");
+  Serial.print(bytes * lanes);
+  Serial.print(",\"sent\":");
+  Serial.print(r.sent);
+  Serial.print(",\"lost\":");
+  Serial.print(r.sent - r.received);
+  Serial.print(",\"errors\":");
+  Serial.print(r.errors);
+  Serial.print(",\"bytes_per_s\":");
+  Serial.print(r.us ? (unsigned long)((double)r.received * 1000000.0 / r.us) : 0UL);
+  Serial.print(",\"line_pct\":");
+  Serial.print(linePercent(r, mask, baud));
+  printTxnPerByte(r);
+  Serial.println("}");
+}
+
+void latency(unsigned long clock, unsigned long baud){
+  beginPorts(baud, clock);
+  unsigned long minUs = 0xffffffffUL, maxUs = 0, sum = 0;
+  uint8_t lost = 0;
+  for(uint8_t i = 0; i < LATENCY_ROUNDS; i++){
+    uint8_t c = pattern(0, i);
+    unsigned long start = micros();
+    iicSerial1.write(c);
+    size_t got = 0;
+    while(got == 0 && micros() - start < 100000UL){
+      got = iicSerial1.readAvailable(buf, 1);
+    }
+    unsigned long us = micros() - start;
+    if(got == 0 || buf[0] != c){
+      lost++;
+      continue;
+    }
+    sum += us;
+    if(us < minUs) minUs = us;
+    if(us > maxUs) maxUs = us;
+  }
+  uint8_t ok = LATENCY_ROUNDS - lost;
+  Serial.print("{\"test\":\"latency\",\"i2c\":");
+  Serial.print(clock);
+  Serial.print(",\"baud\":");
+  Serial.print(baud);
+  Serial.print(",\"ch\":\"1\",\"lost\":");
+  Serial.print(lost);
+  Serial.print(",\"min_us\":");
+  Serial.print(ok ? minUs : 0UL);
+  Serial.print(",\"avg_us\":");
+  Serial.print(ok ? sum / ok : 0UL);
+  Serial.print(",\"max_us\":");
+  Serial.print(maxUs);
+  Serial.println("}");
+}
+
+/*两个子串口同时满速收发，从低到高逐个尝试标准波特率，第一次跟不上时停止*/
+void maxBaud(unsigned long clock){
+  unsigned long best = 0;
+  for(uint8_t i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++){
+    beginPorts(bauds[i], clock);
+    unsigned long bytes = bauds[i] / 40;
+    if(bytes < 256) bytes = 256;
+    sRun_t r = pump(3, bauds[i], bytes);
+    if(r.received != bytes * 2 || r.errors || linePercent(r, 3, bauds[i]) < PASS_PERCENT){
+      break;
+    }
+    best = bauds[i];
+  }
+  Serial.print("{\"test\":\"max_baud\",\"i2c\":");
+  Serial.print(clock);
+  Serial.print(",\"ch\":\"both\",\"max_baud\":");
+  Serial.print(best);
+  Serial.println("}");
+}
+
+void setup() {
+  Serial.begin(115200);
+  Wire.begin();
+  Serial.print("{\"test\":\"info\",\"version\":");
+  Serial.print(BENCH_VERSION);
+  Serial.print(",\"fosc\":");
+  Serial.print(IIC_SERIAL_FOSC);
+  Serial.println("}");
+  for(uint8_t c = 0; c < sizeof(i2cClocks) / sizeof(i2cClocks[0]); c++){
+    for(uint8_t b = 0; b < sizeof(bauds) / sizeof(bauds[0]); b++){
+      for(uint8_t mask = 1; mask <= 3; mask++){
+        throughput(i2cClocks[c], bauds[b], mask);
+      }
+    }
+    latency(i2cClocks[c], 115200);
+    maxBaud(i2cClocks[c]);
+  }
+  Serial.println("done");
+}
+
+void loop() {
+}
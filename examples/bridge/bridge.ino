@@ -0,0 +1,45 @@
+/*!
+ * @file bridge.ino
+ * @brief 透明转发：子串口1与子串口2之间双向转发数据，每5秒通过串口打印两个方向的转发统计
+ * @n 实验现象：子串口1和子串口2分别接两台外部设备，两台设备之间可以直接通信；
+ * @n 数据由转发桥按IIC分包批量读写，115200波特率下可全双工线速转发，IIC时钟建议400kHz以上
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ * @author [Arya](xue.peng@dfrobot.com)
+ * @version  V1.0
+ * @date  2019-07-18
+ * @get from https://www.dfrobot.com
+ * @url https://github.com/DFRobot/DFRobot_IIC_Serial
+ */
+#include <DFRobot_WK2132.h>
+
+DFRobot_WK2132 board(Wire, /*addr = */0x0E);
+DFRobot_IIC_Serial iicSerial1(board, /*subUartChannel =*/SUBUART_CHANNEL_1);
+DFRobot_IIC_Serial iicSerial2(board, /*subUartChannel =*/SUBUART_CHANNEL_2);
+/*主控串口与子串口之间转发时写成 DFRobot_WK2132_Bridge bridge(Serial, iicSerial1);*/
+DFRobot_WK2132_Bridge bridge(iicSerial1, iicSerial2);
+
+unsigned long lastPrint = 0;
+void setup() {
+  Serial.begin(115200);
+  Wire.setClock(400000);
+  if(iicSerial1.begin(115200) != ERR_OK || iicSerial2.begin(115200) != ERR_OK){
+    Serial.println("WK2132 not found!");
+  }
+}
+
+void loop() {
+  bridge.run();
+  if(millis() - lastPrint > 5000){
+    lastPrint = millis();
+    Serial.print("1->2: ");
+    Serial.print(bridge.stats(0).forwarded);
+    Serial.print(" held ");
+    Serial.print(bridge.stats(0).held);
+    Serial.print(", 2->1: ");
+    Serial.print(bridge.stats(1).forwarded);
+    Serial.print(" held ");
+    Serial.println(bridge.stats(1).held);
+  }
+}
@@ -0,0 +1,61 @@
+/*!
+ * @file frameReceive.ino
+ * @brief 帧模式接收，适用于Modbus RTU等以线路空闲间隔分帧的协议
+ * @n 实验现象：将子串口1的TX引脚和RX引脚相连，芯片IRQ引脚接主控的2号引脚(外部中断0)，
+ * @n 子串口1每秒发送一帧数据，芯片接收超时后在帧回调中取出整帧，串口打印帧长度、错误标志和内容
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ * @author [Arya](xue.peng@dfrobot.com)
+ * @version  V1.0
+ * @date  2019-07-18
+ * @get from https://www.dfrobot.com
+ * @url https://github.com/DFRobot/DFRobot_IIC_Serial
+ */
+#include <DFRobot_WK2132.h>
+
+#define IRQ_PIN  2
+
+DFRobot_WK2132 board(Wire, /*addr = */0x0E);
+DFRobot_IIC_Serial iicSerial1(board, /*subUartChannel =*/SUBUART_CHANNEL_1);
+
+/*主控端接收缓存至少能放下一个最长的帧(Modbus RTU为256字节)*/
+uint8_t rxBuf[300];
+
+/*帧回调，在board.service()中调用，此时整帧数据已经批量读入主控端缓存*/
+void onFrame(DFRobot_IIC_Serial *pSerial, uint16_t length, uint8_t flags){
+  uint8_t frame[256];
+  uint16_t n = pSerial->readFrame(frame, sizeof(frame), &flags);
+  Serial.print("frame len=");
+  Serial.print(n);
+  Serial.print(" flags=0x");
+  Serial.print(flags, HEX);
+  Serial.print(": ");
+  for(uint16_t i = 0; i < n; i++){
+    Serial.print(frame[i], HEX);
+    Serial.print(" ");
+  }
+  Serial.println();
+}
+
+unsigned long lastSend = 0;
+void setup() {
+  Serial.begin(115200);
+  iicSerial1.setRxBuffer(rxBuf, sizeof(rxBuf));
+  iicSerial1.begin(9600);
+  /*接收触发点设为最大，短帧只在接收超时时产生一次中断*/
+  iicSerial1.setFifoTriggerLevel(255, 0);
+  iicSerial1.setFrameMode(true);
+  iicSerial1.setFrameCallback(onFrame);
+  board.attachInterruptPin(IRQ_PIN);
+}
+
+void loop() {
+  board.service();
+  if(millis() - lastSend > 1000){
+    lastSend = millis();
+    /*Modbus RTU读保持寄存器请求：地址1，功能码3，起始地址0，数量10，CRC*/
+    const uint8_t request[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD};
+    iicSerial1.write(request, sizeof(request));
+  }
+}
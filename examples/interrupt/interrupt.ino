@@ -0,0 +1,50 @@
+/*!
+ * @file interrupt.ino
+ * @brief 中断方式接收子串口数据
+ * @n 实验现象：将子串口1的TX引脚和RX引脚相连，芯片IRQ引脚接主控的2号引脚(外部中断0)，
+ * @n 子串口1每秒发送一次字符串，收到数据后在中断回调中读取并串口打印，没有数据时主循环不访问IIC总线
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ * @author [Arya](xue.peng@dfrobot.com)
+ * @version  V1.0
+ * @date  2019-07-18
+ * @get from https://www.dfrobot.com
+ * @url https://github.com/DFRobot/DFRobot_IIC_Serial
+ */
+#include <DFRobot_WK2132.h>
+
+#define IRQ_PIN  2
+
+/*DFRobot_WK2132构造函数
+ *参数&wire 可填TwoWire对象Wire
+ *参数addr  I2C地址可用0x0E/0x0A/0x06/0x02，与拨码开关A1、A0对应(默认0x0E)
+ */
+DFRobot_WK2132 board(Wire, /*addr = */0x0E);
+DFRobot_IIC_Serial iicSerial1(board, /*subUartChannel =*/SUBUART_CHANNEL_1);//从芯片对象上取子串口1
+
+/*中断回调，在board.service()中调用，此时接收到的数据已经批量读入主控端缓存*/
+void onSerial1(DFRobot_IIC_Serial *pSerial, uint8_t sifr){
+  if(sifr & (IIC_SERIAL_INT_RFTRIG | IIC_SERIAL_INT_RXOVT)){
+    Serial.print("subSerial1: ");
+    while(pSerial->available()){
+      Serial.print((char)pSerial->read());
+    }
+  }
+}
+
+unsigned long lastSend = 0;
+void setup() {
+  Serial.begin(115200);
+  iicSerial1.begin(115200);/*子串口1初始化*/
+  iicSerial1.setInterruptCallback(onSerial1);
+  board.attachInterruptPin(IRQ_PIN);/*IRQ引脚低电平有效，库内部使用下降沿中断*/
+}
+
+void loop() {
+  board.service();/*没有中断时直接返回，不访问IIC总线*/
+  if(millis() - lastSend > 1000){
+    lastSend = millis();
+    iicSerial1.println("hello, interrupt!");
+  }
+}
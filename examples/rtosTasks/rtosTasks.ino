@@ -0,0 +1,93 @@
+/*!
+ * @file rtosTasks.ino
+ * @brief RTOS任务模式：ESP32上由一个总线任务循环调用poll()收发，两个应用任务分别处理子串口1和子串口2，
+ * @n 应用任务的read()/write()只访问主控端收发缓存，不访问IIC总线；每5秒打印缓存和总线锁的统计
+ * @n 实验现象：子串口1、子串口2各自的TX引脚和RX引脚相连，每个应用任务发出的数据从自己的子串口读回并校验
+ * @n 需要把IIC_SERIAL_ENABLE_RTOS定义为1编译库和工程，如在platformio.ini中加入 build_flags = -DIIC_SERIAL_ENABLE_RTOS=1
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ * @get from https://www.dfrobot.com
+ * @url https://github.com/DFRobot/DFRobot_IIC_Serial
+ */
+#include <DFRobot_WK2132.h>
+
+#if !IIC_SERIAL_ENABLE_RTOS
+#error "rtosTasks needs -DIIC_SERIAL_ENABLE_RTOS=1"
+#endif
+
+DFRobot_WK2132 board(Wire, /*addr = */0x0E);
+DFRobot_IIC_Serial iicSerial1(board, /*subUartChannel =*/SUBUART_CHANNEL_1);
+DFRobot_IIC_Serial iicSerial2(board, /*subUartChannel =*/SUBUART_CHANNEL_2);
+DFRobot_IIC_Serial *ports[2] = {&iicSerial1, &iicSerial2};
+volatile uint32_t received[2], errors[2];
+
+/*总线任务：唯一访问IIC总线的任务，接收FIFO读入接收缓存，发送队列写入发送FIFO*/
+void busTask(void *arg){
+  while(true){
+    iicSerial1.poll();
+    iicSerial2.poll();
+    vTaskDelay(1);
+  }
+}
+
+/*应用任务：发送递增的数据并校验读回的数据，只访问本子串口的收发缓存*/
+void appTask(void *arg){
+  uint8_t ch = (uint8_t)(uintptr_t)arg;
+  DFRobot_IIC_Serial *port = ports[ch];
+  uint8_t next = 0, expect = 0;
+  while(true){
+    while(port->availableForWrite() > 0 && (uint8_t)(next - expect) < 200){
+      port->write(next++);
+    }
+    while(port->available()){
+      if(port->read() != expect){
+        errors[ch]++;
+      }
+      expect++;
+      received[ch]++;
+    }
+    vTaskDelay(2);
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  Wire.setClock(400000);
+  if(iicSerial1.begin(115200) != ERR_OK || iicSerial2.begin(115200) != ERR_OK){
+    Serial.println("WK2132 not found!");
+  }
+  /*应用任务不等待，发送队列满时write()立即返回0*/
+  iicSerial1.setWritePolicy(DFRobot_IIC_Serial::eWritePartial);
+  iicSerial2.setWritePolicy(DFRobot_IIC_Serial::eWritePartial);
+  iicSerial1.setTaskMode(true);
+  iicSerial2.setTaskMode(true);
+  xTaskCreatePinnedToCore(busTask, "wk2132", 4096, NULL, 3, NULL, 1);
+  xTaskCreatePinnedToCore(appTask, "port1", 4096, (void *)0, 2, NULL, 1);
+  xTaskCreatePinnedToCore(appTask, "port2", 4096, (void *)1, 2, NULL, 0);
+}
+
+void loop() {
+  delay(5000);
+  for(uint8_t ch = 0; ch < 2; ch++){
+    const DFRobot_IIC_Serial::sRingStats_t &rs = ports[ch]->ringStats();
+    Serial.print("port");
+    Serial.print(ch + 1);
+    Serial.print(": received ");
+    Serial.print(received[ch]);
+    Serial.print(" errors ");
+    Serial.print(errors[ch]);
+    Serial.print(" rxFull ");
+    Serial.print(rs.rxFull);
+    Serial.print(" rxHighWater ");
+    Serial.println(rs.rxHighWater);
+  }
+  /*同一IIC总线上其他任务(如其他驱动)访问总线时，总线任务等待的次数和时间*/
+  const DFRobot_WK2132::sLockStats_t &ls = board.lockStats();
+  Serial.print("bus locks ");
+  Serial.print(ls.locks);
+  Serial.print(" contended ");
+  Serial.print(ls.contended);
+  Serial.print(" maxWaitUs ");
+  Serial.println(ls.maxWaitUs);
+}
@@ -0,0 +1,88 @@
+/*!
+ * @file triggerBenchmark.ino
+ * @brief 比较不同接收FIFO触发点下的中断次数和每次中断批量读出的字节数
+ * @n 实验现象：将子串口1的TX引脚和RX引脚相连，芯片IRQ引脚接主控的2号引脚(外部中断0)，
+ * @n 依次使用各个触发点发送同样长度的数据，串口打印每个触发点下的中断次数、平均每次读出的字节数和耗时
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ * @author [Arya](xue.peng@dfrobot.com)
+ * @version  V1.0
+ * @date  2019-07-18
+ * @get from https://www.dfrobot.com
+ * @url https://github.com/DFRobot/DFRobot_IIC_Serial
+ */
+#include <DFRobot_WK2132.h>
+
+#define IRQ_PIN     2
+#define TEST_BYTES  200   /*每轮发送的字节数，不超过发送FIFO的256字节，一次写入即可*/
+#define TEST_BAUD   9600  /*波特率较低时数据在FIFO中逐渐累积，更能体现触发点的差别*/
+
+DFRobot_WK2132 board(Wire, /*addr = */0x0E);
+DFRobot_IIC_Serial iicSerial1(board, /*subUartChannel =*/SUBUART_CHANNEL_1);
+
+/*主控端接收缓存设为256字节，一次中断可以把接收FIFO中的数据全部读走*/
+uint8_t rxBuf[256];
+uint8_t txBuf[TEST_BYTES];
+
+unsigned int irqCount = 0;
+unsigned int rxCount = 0;
+
+void onSerial1(DFRobot_IIC_Serial *pSerial, uint8_t sifr){
+  if(sifr & (IIC_SERIAL_INT_RFTRIG | IIC_SERIAL_INT_RXOVT)){
+    irqCount++;
+    /*只读走本次中断已读入缓存的数据，不在回调里继续轮询FIFO*/
+    int n = pSerial->available();
+    rxCount += n;
+    while(n--){
+      pSerial->read();
+    }
+  }
+}
+
+/*rxLevel为0时使用FCR中的预设触发点preset，否则使用RFTL中的任意触发点*/
+void runOnce(const char *name, DFRobot_IIC_Serial::eFifoTrigger_t preset, uint8_t rxLevel){
+  iicSerial1.setFifoTrigger(preset, DFRobot_IIC_Serial::eTriggerLevel8);
+  if(rxLevel)
+    iicSerial1.setFifoTriggerLevel(rxLevel, 0);
+  irqCount = 0;
+  rxCount = 0;
+  unsigned long t = millis();
+  iicSerial1.write(txBuf, TEST_BYTES);
+  while(rxCount < TEST_BYTES && millis() - t < 2000){
+    board.service();
+  }
+  t = millis() - t;
+  Serial.print(name);
+  Serial.print(": irq=");
+  Serial.print(irqCount);
+  Serial.print(" bytes/irq=");
+  Serial.print(irqCount ? rxCount / irqCount : 0);
+  Serial.print(" rx=");
+  Serial.print(rxCount);
+  Serial.print(" time=");
+  Serial.print(t);
+  Serial.println("ms");
+}
+
+void setup() {
+  Serial.begin(115200);
+  for(int i = 0; i < TEST_BYTES; i++)
+    txBuf[i] = i;
+  iicSerial1.setRxBuffer(rxBuf, sizeof(rxBuf));
+  iicSerial1.begin(TEST_BAUD);
+  iicSerial1.setInterruptCallback(onSerial1);
+  board.attachInterruptPin(IRQ_PIN);
+
+  runOnce("FCR 8",   DFRobot_IIC_Serial::eTriggerLevel8, 0);
+  runOnce("FCR 16",  DFRobot_IIC_Serial::eTriggerLevel16, 0);
+  runOnce("FCR 24",  DFRobot_IIC_Serial::eTriggerLevel24, 0);
+  runOnce("FCR 28",  DFRobot_IIC_Serial::eTriggerLevelMax, 0);
+  runOnce("RFTL 64", DFRobot_IIC_Serial::eTriggerLevel8, 64);
+  runOnce("RFTL 128",DFRobot_IIC_Serial::eTriggerLevel8, 128);
+  runOnce("RFTL 192",DFRobot_IIC_Serial::eTriggerLevel8, 192);
+  iicSerial1.setFifoTrigger(DFRobot_IIC_Serial::eTriggerLevel8, DFRobot_IIC_Serial::eTriggerLevel8);
+}
+
+void loop() {
+}
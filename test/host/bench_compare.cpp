@@ -0,0 +1,203 @@
+/*!
+ * @file bench_compare.cpp
+ * @brief 比较examples/benchmark的输出与保存的基线，发现性能回退
+ * @n 用法：wk2132_bench [--tolerance 百分比] [--update] 基线文件 结果文件
+ * @n 结果文件为示例的串口输出，"-"表示从标准输入读取，只处理以'{'开头的行，每行一个JSON对象
+ * @n test、i2c、baud、ch、version、fosc字段组成一条结果的键，其余数值字段为指标：
+ * @n bytes_per_s、line_pct、max_baud越大越好，lost、errors、txn_per_byte和以_us结尾的越小越好，bytes、sent只作记录
+ * @n 指标比基线差超过容差(默认5%)，或基线中的结果在本次输出中不存在时计为回退
+ * @n --update把本次结果写为新的基线
+ * @n 返回值：0没有回退，1有回退，2参数或文件错误
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef struct{
+  std::string key;
+  std::string line;
+  std::map<std::string, double> metrics;
+} sResult_t;
+
+static bool isKeyField(const std::string &name){
+  return name == "test" || name == "i2c" || name == "baud" || name == "ch" || name == "version" || name == "fosc";
+}
+
+/*1表示越大越好，-1表示越小越好，0表示不比较*/
+static int direction(const std::string &name){
+  if(name == "bytes" || name == "sent"){
+    return 0;
+  }
+  if(name == "lost" || name == "errors" || name == "txn_per_byte" ||
+     (name.size() > 3 && name.compare(name.size() - 3, 3, "_us") == 0)){
+    return -1;
+  }
+  return 1;
+}
+
+/*解析基准输出的一行：只有一层的对象，值为字符串、数字或null*/
+static bool parseLine(const std::string &line, sResult_t &r){
+  size_t i = 0, n = line.size();
+  while(i < n && line[i] == ' ') i++;
+  if(i >= n || line[i] != '{'){
+    return false;
+  }
+  i++;
+  r.line = line;
+  r.key.clear();
+  r.metrics.clear();
+  while(i < n){
+    while(i < n && (line[i] == ' ' || line[i] == ',')) i++;
+    if(i >= n || line[i] == '}'){
+      break;
+    }
+    if(line[i] != '"'){
+      return false;
+    }
+    size_t end = line.find('"', i + 1);
+    if(end == std::string::npos){
+      return false;
+    }
+    std::string name = line.substr(i + 1, end - i - 1);
+    i = line.find(':', end);
+    if(i == std::string::npos){
+      return false;
+    }
+    i++;
+    std::string value;
+    bool isString = false;
+    if(i < n && line[i] == '"'){
+      end = line.find('"', i + 1);
+      if(end == std::string::npos){
+        return false;
+      }
+      value = line.substr(i + 1, end - i - 1);
+      isString = true;
+      i = end + 1;
+    }else{
+      end = line.find_first_of(",}", i);
+      if(end == std::string::npos){
+        return false;
+      }
+      value = line.substr(i, end - i);
+      i = end;
+    }
+    if(isKeyField(name)){
+      r.key += (r.key.empty() ? "" : " ") + name + "=" + value;
+    }else if(!isString && value != "null"){
+      r.metrics[name] = strtod(value.c_str(), NULL);
+    }
+  }
+  return !r.key.empty();
+}
+
+static bool loadResults(const char *path, std::vector<sResult_t> &results){
+  FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  if(fp == NULL){
+    return false;
+  }
+  char buf[1024];
+  while(fgets(buf, sizeof(buf), fp)){
+    std::string line(buf);
+    while(!line.empty() && (line[line.size() - 1] == '\n' || line[line.size() - 1] == '\r')){
+      line.erase(line.size() - 1);
+    }
+    sResult_t r;
+    if(parseLine(line, r)){
+      results.push_back(r);
+    }
+  }
+  if(fp != stdin){
+    fclose(fp);
+  }
+  return true;
+}
+
+int main(int argc, char **argv){
+  double tolerance = 5.0;
+  bool update = false;
+  const char *paths[2] = {NULL, NULL};
+  int pathNum = 0;
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc){
+      tolerance = strtod(argv[++i], NULL);
+    }else if(strcmp(argv[i], "--update") == 0){
+      update = true;
+    }else if(pathNum < 2){
+      paths[pathNum++] = argv[i];
+    }
+  }
+  if(pathNum != 2){
+    fprintf(stderr, "usage: %s [--tolerance percent] [--update] baseline result|-\n", argv[0]);
+    return 2;
+  }
+  std::vector<sResult_t> baseline, current;
+  if(!loadResults(paths[1], current) || current.empty()){
+    fprintf(stderr, "%s: no benchmark results\n", paths[1]);
+    return 2;
+  }
+  if(update){
+    FILE *fp = fopen(paths[0], "w");
+    if(fp == NULL){
+      fprintf(stderr, "%s: cannot write\n", paths[0]);
+      return 2;
+    }
+    for(size_t i = 0; i < current.size(); i++){
+      fprintf(fp, "%s\n", current[i].line.c_str());
+    }
+    fclose(fp);
+    printf("baseline %s updated: %u results\n", paths[0], (unsigned)current.size());
+    return 0;
+  }
+  if(!loadResults(paths[0], baseline) || baseline.empty()){
+    fprintf(stderr, "%s: no baseline results\n", paths[0]);
+    return 2;
+  }
+
+  std::map<std::string, const sResult_t *> byKey;
+  for(size_t i = 0; i < current.size(); i++){
+    byKey[current[i].key] = &current[i];
+  }
+  unsigned regressions = 0, improvements = 0, compared = 0;
+  for(size_t i = 0; i < baseline.size(); i++){
+    const sResult_t &b = baseline[i];
+    std::map<std::string, const sResult_t *>::iterator it = byKey.find(b.key);
+    if(it == byKey.end()){
+      printf("MISSING  %s\n", b.key.c_str());
+      regressions++;
+      continue;
+    }
+    for(std::map<std::string, double>::const_iterator m = b.metrics.begin(); m != b.metrics.end(); ++m){
+      int dir = direction(m->first);
+      std::map<std::string, double>::const_iterator c = it->second->metrics.find(m->first);
+      if(dir == 0 || c == it->second->metrics.end()){
+        continue;
+      }
+      compared++;
+      double base = m->second, cur = c->second;
+      //基线为0时(如丢失字节数)任何变差都算回退
+      double change = base != 0 ? (cur - base) * 100.0 / (base < 0 ? -base : base) : (cur - base) * 100.0;
+      double worse = -change * dir;
+      const char *tag = NULL;
+      if(worse > tolerance){
+        tag = "WORSE";
+        regressions++;
+      }else if(worse < -tolerance){
+        tag = "better";
+        improvements++;
+      }
+      if(tag){
+        printf("%-8s %s %s: %g -> %g (%+.1f%%)\n", tag, b.key.c_str(), m->first.c_str(), base, cur, change);
+      }
+    }
+  }
+  printf("%u results, %u metrics compared, %u regressions, %u improvements (tolerance %.1f%%)\n",
+         (unsigned)baseline.size(), compared, regressions, improvements, tolerance);
+  return regressions ? 1 : 0;
+}
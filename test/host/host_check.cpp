@@ -0,0 +1,1454 @@
+/*!
+ * @file host_check.cpp
+ * @brief 在主机上用WK2132仿真模型运行库的回归检查与吞吐量测试
+ * @n 每个用例打印一行指标(I2C事务数、每事务字节数、吞吐量等)，数据错误或超出事务预算时计为失败，
+ * @n 返回值为失败的检查项个数，可直接作为ctest用例
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#include <stdio.h>
+#include <ctype.h>
+#include <DFRobot_WK2132.h>
+#include "WK2132Model.h"
+#include "../../examples/benchmark/benchWindow.h"
+#if IIC_SERIAL_ENABLE_RTOS
+#include <thread>
+#include <atomic>
+#include <chrono>
+#endif
+
+//事务预算：驱动改动使总线事务超过以下数值时检查失败
+#define BUDGET_BRINGUP_TRANSACTIONS   30    //两个子串口begin()的事务总数
+#define BUDGET_IDLE_TRANSACTIONS      2     //中断模式下1000次空闲service()的事务数
+#define BUDGET_POLL_TRANSACTIONS      2     //接收FIFO为空时一次available()的事务数
+#define MIN_RX_BYTES_PER_TRANSACTION  5     //每2ms轮询接收一次时平均每个事务读到的字节数
+
+static int failures = 0;
+
+#define CHECK(cond) do{ \
+  if(!(cond)){ \
+    printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+}while(0)
+
+static uint32_t transactions(void){
+  return Wire.stats().writes + Wire.stats().reads;
+}
+
+static void simReset(void){
+  sim::reset();
+  Wire.detachAllDevices();
+  Wire.setClock(100000);
+}
+
+static void fillPattern(uint8_t *pBuf, size_t size, uint8_t seed){
+  for(size_t i = 0; i < size; i++){
+    pBuf[i] = (uint8_t)(i * 7 + seed);
+  }
+}
+
+/*两个子串口初始化的事务数与寄存器状态*/
+static void checkBringup(void){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  DFRobot_IIC_Serial s1(Wire, SUBUART_CHANNEL_1, 0x0E);
+  DFRobot_IIC_Serial s2(Wire, SUBUART_CHANNEL_2, 0x0E);
+  uint64_t t = sim::now();
+  s1.begin(115200);
+  s2.begin(9600, IIC_SERIAL_8E1);
+  t = sim::now() - t;
+  printf("bringup: transactions=%u bytes=%u time=%lluus\n", transactions(),
+         Wire.stats().bytesOut + Wire.stats().bytesIn, (unsigned long long)t);
+  CHECK(transactions() <= BUDGET_BRINGUP_TRANSACTIONS);
+  CHECK((chip.globalReg(REG_WK2132_GENA) & 0x03) == 0x03);
+  CHECK(chip.reg(0, 0, REG_WK2132_SCR) == 0x03);
+  CHECK(chip.reg(1, 0, REG_WK2132_LCR) == IIC_SERIAL_8E1);
+  CHECK(fabs(chip.actualBaud(0) - 115200) / 115200 < 0.025);
+  CHECK(fabs(chip.actualBaud(1) - 9600) / 9600 < 0.025);
+}
+
+/*批量写到线路上的吞吐量和数据正确性*/
+static void checkTxThroughput(uint32_t clock){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  SimUartPort port(115200);
+  chip.connect(0, &port);
+  DFRobot_IIC_Serial s1(Wire, SUBUART_CHANNEL_1, 0x0E);
+  s1.begin(115200);
+  Wire.setClock(clock);
+  static uint8_t data[2000];
+  fillPattern(data, sizeof(data), 1);
+  Wire.resetStats();
+  uint64_t t = sim::now();
+  size_t n = s1.write(data, sizeof(data));
+  while(port.received.size() < sizeof(data) && sim::now() - t < 1000000){
+    delay(1);
+  }
+  t = sim::now() - t;
+  printf("tx %lukHz: bytes=%u transactions=%u bytes/transaction=%.1f throughput=%.0fB/s (line %.0fB/s)\n",
+         (unsigned long)(clock / 1000), (unsigned)n, transactions(), (double)n / transactions(),
+         n * 1e6 / t, 115200 / 10.0);
+  CHECK(n == sizeof(data));
+  CHECK(port.received.size() == sizeof(data));
+  CHECK(port.received.size() == sizeof(data) && memcmp(&port.received[0], data, sizeof(data)) == 0);
+}
+
+/*轮询方式接收外部设备连续发来的数据，100kHz时读1个字节约90us，波特率需低于约100000才能跟上线速*/
+static void checkRxPolling(uint32_t clock, unsigned long baud){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  SimUartPort port(baud);
+  port.connect(chip.rxPort(0));
+  DFRobot_IIC_Serial s1(Wire, SUBUART_CHANNEL_1, 0x0E);
+  s1.begin(baud);
+  Wire.setClock(clock);
+  static uint8_t data[2000], got[2000];
+  fillPattern(data, sizeof(data), 3);
+
+  Wire.resetStats();
+  s1.available();
+  uint32_t poll = transactions();
+
+  port.send(data, sizeof(data));
+  Wire.resetStats();
+  size_t n = 0;
+  uint64_t t = sim::now();
+  while(n < sizeof(data) && sim::now() - t < 1000000){
+    n += s1.readAvailable(got + n, sizeof(got) - n);
+    delayMicroseconds(2000);
+  }
+  t = sim::now() - t;
+  printf("rx %lukHz %lubps: bytes=%u transactions=%u bytes/transaction=%.1f throughput=%.0fB/s dropped=%u maxFill=%u pollEmpty=%u\n",
+         (unsigned long)(clock / 1000), baud, (unsigned)n, transactions(), (double)n / transactions(),
+         n * 1e6 / t, chip.stats(0).rxDropped, chip.stats(0).rxMaxFill, poll);
+  CHECK(poll <= BUDGET_POLL_TRANSACTIONS);
+  CHECK(n == sizeof(data));
+  CHECK(memcmp(got, data, sizeof(data)) == 0);
+  CHECK(chip.stats(0).rxDropped == 0);
+  CHECK((double)n / transactions() >= MIN_RX_BYTES_PER_TRANSACTION);
+}
+
+/*Stream接口：read/peek/find/parseInt/readBytes*/
+static void checkStream(void){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  SimUartPort port(115200);
+  port.connect(chip.rxPort(0));
+  DFRobot_IIC_Serial s1(Wire, SUBUART_CHANNEL_1, 0x0E);
+  s1.begin(115200);
+  const char *msg = "temp=1234;hum=56\n";
+  port.send((const uint8_t *)msg, strlen(msg));
+  delay(5);
+  Wire.resetStats();
+  bool found = s1.find("temp=");
+  long temp = s1.parseInt();
+  int sep = s1.read();
+  s1.find("hum=");
+  long hum = s1.parseInt();
+  printf("stream: transactions=%u\n", transactions());
+  CHECK(found);
+  CHECK(temp == 1234);
+  CHECK(sep == ';');
+  CHECK(hum == 56);
+  CHECK(s1.read() == '\n');
+  CHECK(s1.read() == -1);
+}
+
+/*编译期确定波特率的子串口与运行时版本的寄存器配置一致*/
+static void checkTemplateChannel(void){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  chip.loopback(1);
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  WK2132Channel<SUBUART_CHANNEL_2> s2(board);
+  s1.begin(57600);
+  Wire.resetStats();
+  s2.begin<57600>();
+  uint32_t n = transactions();
+  s2.write((const uint8_t *)"ping", 4);
+  delay(5);
+  uint8_t buf[4] = {0};
+  size_t len = s2.readAvailable(buf, sizeof(buf));
+  printf("template channel: begin transactions=%u baud=%.0f\n", n, chip.actualBaud(1));
+  for(uint8_t reg = 0x04; reg <= 0x06; reg++){
+      CHECK(chip.reg(0, 1, reg) == chip.reg(1, 1, reg));
+  }
+  CHECK(len == 4 && memcmp(buf, "ping", 4) == 0);
+  //晶振与芯片对象不一致时begin失败且不访问总线
+  Wire.resetStats();
+  CHECK((s2.begin<57600, 14745600UL>() == ERR_FOSC));
+  CHECK(transactions() == 0);
+  board.setFosc(14745600UL);
+  CHECK(s2.begin<57600>() == ERR_FOSC);
+  CHECK((s2.begin<57600, 14745600UL>() == ERR_OK));
+}
+
+/*分频值：标准波特率下实际波特率与仿真芯片一致，误差在2%以内，460800/921600(14.7456MHz晶振)无误差*/
+static void checkBaudRates(void){
+  static const unsigned long rates[] = {1200, 9600, 57600, 115200, 230400, 460800, 250000, 31250};
+  static_assert(wk2132BaudErrorPpm(11059200UL, 460800) == 0, "460800 exact with 11.0592MHz");
+  static_assert(wk2132BaudErrorPpm(14745600UL, 921600) == 0, "921600 exact with 14.7456MHz");
+  for(int xtal = 0; xtal < 2; xtal++){
+      unsigned long fosc = xtal ? 14745600UL : IIC_SERIAL_FOSC;
+      simReset();
+      WK2132Model chip(0x0E, 255, fosc);
+      chip.attach(Wire);
+      DFRobot_WK2132 board(Wire, 0x0E);
+      board.setFosc(fosc);
+      DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+      long worst = 0;
+      for(size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++){
+          s1.begin(rates[i]);
+          long ppm = 0;
+          unsigned long actual = s1.getActualBaud(&ppm);
+          double simBaud = chip.actualBaud(0);
+          CHECK(actual > simBaud - 1 && actual < simBaud + 1);
+          CHECK(ppm == wk2132BaudErrorPpm(fosc, rates[i]));
+          CHECK(ppm < 20000 && ppm > -20000);
+          if(ppm > worst || -ppm > worst){
+              worst = ppm < 0 ? -ppm : ppm;
+          }
+      }
+      s1.begin(xtal ? 921600 : 460800);
+      long ppm = 1;
+      unsigned long actual = s1.getActualBaud(&ppm);
+      Wire.resetStats();
+      s1.begin(xtal ? 921600 : 460800);
+      uint32_t rebegin = transactions();
+      printf("baud fosc=%lu: worst=%ldppm top=%lu(%ldppm) rebegin transactions=%u\n", fosc, worst, actual, ppm, rebegin);
+      CHECK(ppm == 0);
+  }
+}
+
+static uint8_t errBytes[8];
+static uint8_t errFlags[8];
+static int errCount;
+
+static void onRxError(DFRobot_IIC_Serial *pSerial, uint8_t data, uint8_t lsr){
+  if(errCount < 8){
+      errBytes[errCount] = data;
+      errFlags[errCount] = lsr;
+  }
+  errCount++;
+}
+
+/*接收错误统计：无错误时不增加事务，有错误时逐字节定位，溢出和FIFO最高水位*/
+static void checkLineErrors(void){
+  simReset();
+  Wire.setClock(400000);
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  SimUartPort port(115200);
+  port.connect(chip.rxPort(0));
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  static uint8_t rxBuf[512];
+  s1.setRxBuffer(rxBuf, sizeof(rxBuf));
+  s1.begin(115200);
+  uint8_t data[300], got[300];
+  fillPattern(data, sizeof(data), 51);
+  //无错误：一次available()为一个状态快照加分包的FIFO读，与不统计错误时相同
+  port.send(data, 100);
+  delay(10);
+  Wire.resetStats();
+  int n = s1.available();
+  uint32_t clean = transactions();
+  s1.readBytes(got, n);
+  DFRobot_IIC_Serial::sLineStats_t st = s1.lineStats();
+  CHECK(n == 100 && memcmp(got, data, 100) == 0);
+  CHECK(st.parity == 0 && st.framing == 0 && st.breaks == 0 && st.overruns == 0);
+  //第3、50、99个字节停止位错误，逐字节标记
+  s1.setErrorCallback(onRxError);
+  errCount = 0;
+  for(int i = 0; i < 100; i++){
+      if(i == 3 || i == 50 || i == 99){
+          port.injectError(SIM_LSR_FE);
+      }
+      port.send(data + i, 1);
+  }
+  delay(10);
+  n = s1.readBytes(got, 100);
+  st = s1.lineStats();
+  CHECK(n == 100 && memcmp(got, data, 100) == 0);
+  CHECK(st.framing == 3 && st.parity == 0);
+  CHECK(errCount == 3 && errBytes[0] == data[3] && errBytes[1] == data[50] && errBytes[2] == data[99]);
+  CHECK(errFlags[0] == IIC_SERIAL_LSR_FE);
+  uint16_t framing = st.framing;
+  //溢出：300字节不读取
+  s1.setErrorCallback(NULL);
+  s1.resetLineStats();
+  port.send(data, sizeof(data));
+  delay(40);
+  n = s1.readBytes(got, sizeof(got));
+  st = s1.lineStats();
+  printf("line errors: clean transactions=%u framing=%u overruns=%u highWater=%u dropped=%u\n", clean, framing, st.overruns,
+         st.rxHighWater, chip.stats(0).rxDropped);
+  CHECK(clean <= 2 + (100 + IIC_SERIAL_WIRE_BUFFER_SIZE - 1) / IIC_SERIAL_WIRE_BUFFER_SIZE);
+  CHECK(n == 256);
+  CHECK(st.overruns == 1);
+  CHECK(st.rxHighWater == 256);
+}
+
+/*热连接：主控复位后重新接管子串口，只写不同的寄存器，FIFO中已收到的数据不丢失*/
+static void checkWarmAttach(void){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  SimUartPort port(115200);
+  port.connect(chip.rxPort(0));
+  uint8_t data[100], got[100];
+  fillPattern(data, sizeof(data), 61);
+  unsigned long coldUs = 0;
+  {
+      DFRobot_WK2132 board(Wire, 0x0E);
+      DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+      s1.begin(115200, IIC_SERIAL_8E1);
+      coldUs = s1.getBeginTime();
+      port.send(data, 60);
+      delay(10);
+  }
+  //主控复位：芯片对象和子串口对象重新创建，复位期间继续收到数据
+  port.send(data + 60, 40);
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  Wire.resetStats();
+  uint32_t pageWrites = chip.stats(0).pageWrites;
+  bool warm = s1.beginWarm(115200, IIC_SERIAL_8E1);
+  uint32_t warmTransactions = transactions();
+  unsigned long warmUs = s1.getBeginTime();
+  delay(10);
+  size_t n = s1.readBytes(got, sizeof(got));
+  //波特率不同时只改分频寄存器
+  Wire.resetStats();
+  bool warm2 = s1.beginWarm(57600, IIC_SERIAL_8E1);
+  uint32_t changeTransactions = transactions();
+  printf("warm attach: cold=%luus warm=%luus transactions=%u pages=%u read=%u rebaud transactions=%u baud=%.0f\n", coldUs, warmUs,
+         warmTransactions, (unsigned)(chip.stats(0).pageWrites - pageWrites), (unsigned)n, changeTransactions, chip.actualBaud(0));
+  CHECK(warm && warm2);
+  CHECK(n == sizeof(data) && memcmp(got, data, sizeof(data)) == 0);
+  CHECK(warmUs < coldUs);
+  CHECK(chip.actualBaud(0) > 57000 && chip.actualBaud(0) < 58200);
+  CHECK(chip.reg(0, 0, 0x05) == IIC_SERIAL_8E1);
+  //热连接的最后一次访问重试后仍失败：不报告热连接成功，退回完整初始化
+  Wire.resetStats();
+  bool warm3 = s1.beginWarm(57600, IIC_SERIAL_8E1);
+  uint32_t lastTxn = transactions() - 1;
+  Wire.injectNack(lastTxn, IIC_SERIAL_RETRIES + 1);
+  bool nacked = s1.beginWarm(57600, IIC_SERIAL_8E1);
+  printf("warm attach nack: warm=%d transactions=%u nacked=%d err=%d\n", warm3, lastTxn + 1, nacked, board.getLastError());
+  CHECK(warm3);
+  CHECK(!nacked);
+  CHECK(board.getLastError() == ERR_OK);
+  CHECK(chip.reg(0, 0, 0x05) == IIC_SERIAL_8E1 && chip.actualBaud(0) > 57000 && chip.actualBaud(0) < 58200);
+  //芯片断电后热连接退回完整初始化
+  chip.powerCycle();
+  DFRobot_WK2132 board2(Wire, 0x0E);
+  DFRobot_IIC_Serial s2(board2, SUBUART_CHANNEL_1);
+  CHECK(!s2.beginWarm(115200));
+  CHECK(chip.reg(0, 0, 0x04) == 0x03);
+}
+
+/*接收FIFO满256字节时的计数和读取*/
+static void checkFullFifo(bool burst){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  chip.setBurstSupported(burst);
+  DFRobot_IIC_Serial s1(Wire, SUBUART_CHANNEL_1, 0x0E);
+  s1.begin(115200);
+  uint8_t data[256], got[300];
+  fillPattern(data, sizeof(data), 5);
+  chip.injectRx(0, data, sizeof(data));
+  DFRobot_IIC_Serial::sStatus_t st;
+  CHECK(s1.status(&st) == ERR_OK);
+  size_t n = s1.readAvailable(got, sizeof(got));
+  printf("full fifo burst=%d: rxCount=%u read=%u\n", burst, st.rxCount, (unsigned)n);
+  CHECK(st.rxCount == 256);
+  CHECK(n == 256);
+  CHECK(memcmp(got, data, sizeof(data)) == 0);
+  CHECK(s1.available() == 0);
+}
+
+static DFRobot_IIC_Serial *pIrqSerial;
+static size_t irqBytes;
+static int irqEvents;
+static uint8_t irqBuf[400];
+static void onIrq(DFRobot_IIC_Serial *pSerial, uint8_t sifr){
+  if(pSerial == pIrqSerial && (sifr & (IIC_SERIAL_INT_RFTRIG | IIC_SERIAL_INT_RXOVT))){
+      irqEvents++;
+      irqBytes += pSerial->readAvailable(irqBuf + irqBytes, sizeof(irqBuf) - irqBytes);
+  }
+}
+
+/*中断模式：空闲时不访问总线，收到的数据完整*/
+static void checkInterrupt(void){
+  simReset();
+  WK2132Model chip(0x0E, 2);
+  chip.attach(Wire);
+  SimUartPort port(115200);
+  port.connect(chip.rxPort(0));
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  s1.begin(115200);
+  s1.setInterruptCallback(onIrq);
+  board.attachInterruptPin(2);
+  pIrqSerial = &s1;
+  irqBytes = 0;
+  irqEvents = 0;
+  Wire.resetStats();
+  for(int i = 0; i < 1000; i++){
+      board.service();
+      delayMicroseconds(100);
+  }
+  uint32_t idle = transactions();
+  uint8_t data[400];
+  fillPattern(data, sizeof(data), 9);
+  port.send(data, sizeof(data));
+  Wire.resetStats();
+  for(int i = 0; i < 1000 && irqBytes < sizeof(data); i++){
+      board.service();
+      delayMicroseconds(100);
+  }
+  printf("interrupt: idle=%u events=%d bytes=%u transactions=%u\n", idle, irqEvents, (unsigned)irqBytes, transactions());
+  CHECK(idle <= BUDGET_IDLE_TRANSACTIONS);
+  CHECK(irqBytes == sizeof(data));
+  CHECK(memcmp(irqBuf, data, sizeof(data)) == 0);
+  CHECK(!chip.irqAsserted());
+}
+
+/*中断处理函数表按IIC_SERIAL_CHIP_NUM展开，最后一个芯片对象位置的中断可用，超出的芯片对象返回ERR_ADDR*/
+static void checkIrqHandlers(void){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  DFRobot_WK2132 *boards[IIC_SERIAL_CHIP_NUM + 1];
+  int last = -1;
+  bool rejected = true;
+  for(int i = 0; i <= IIC_SERIAL_CHIP_NUM; i++){
+      boards[i] = new DFRobot_WK2132(Wire, 0x0E);
+      int ret = boards[i]->attachInterruptPin(10 + i);
+      if(ret == ERR_OK){
+          last = i;
+      }else if(ret != ERR_ADDR){
+          rejected = false;
+      }
+  }
+  CHECK(rejected);
+  CHECK(last >= 0 && last < IIC_SERIAL_CHIP_NUM);
+  CHECK(boards[IIC_SERIAL_CHIP_NUM]->attachInterruptPin(10 + IIC_SERIAL_CHIP_NUM) == ERR_ADDR);
+  if(last >= 0){
+      uint8_t pin = 10 + last;
+      boards[last]->service();
+      Wire.resetStats();
+      boards[last]->service();
+      uint32_t idle = transactions();
+      sim::setPinLevel(pin, LOW);
+      delayMicroseconds(10);
+      boards[last]->service();
+      uint32_t woken = transactions();
+      sim::setPinLevel(pin, HIGH);
+      printf("irq handlers: chips=%d last=%d idle=%u woken=%u\n", IIC_SERIAL_CHIP_NUM, last, idle, woken);
+      CHECK(idle == 0);
+      CHECK(woken > 0);
+  }
+  for(int i = 0; i <= IIC_SERIAL_CHIP_NUM; i++){
+      delete boards[i];
+  }
+}
+
+/*异步写：9600波特率下写入1000字节不等待线路，由poll()或中断补充发送FIFO，flush()等到全部发出*/
+static void checkAsyncTx(bool useIrq){
+  simReset();
+  WK2132Model chip(0x0E, 2);
+  chip.attach(Wire);
+  SimUartPort port(9600);
+  chip.connect(0, &port);
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  s1.begin(9600);
+  if(useIrq){
+      board.attachInterruptPin(2);
+  }
+  static uint8_t queue[1024];
+  s1.setTxBuffer(queue, sizeof(queue));
+  s1.setWritePolicy(DFRobot_IIC_Serial::eWriteAsync);
+  uint8_t data[1000];
+  fillPattern(data, sizeof(data), 13);
+  Wire.resetStats();
+  uint64_t t = sim::now();
+  size_t n = s1.write(data, sizeof(data));
+  uint64_t writeUs = sim::now() - t;
+  int space = s1.availableForWrite();
+  uint64_t maxLoopUs = 0;
+  while(port.received.size() < 900 && sim::now() - t < 2000000){
+      uint64_t start = sim::now();
+      if(useIrq){
+          board.service();
+      }else{
+          s1.poll();
+      }
+      if(sim::now() - start > maxLoopUs){
+          maxLoopUs = sim::now() - start;
+      }
+      delay(1);
+  }
+  s1.flush();
+  uint64_t total = sim::now() - t;
+  printf("async tx irq=%d: write=%uB in %lluus space=%d maxLoop=%lluus flushAt=%llums received=%u transactions=%u\n", useIrq,
+         (unsigned)n, (unsigned long long)writeUs, space, (unsigned long long)maxLoopUs, (unsigned long long)(total / 1000),
+         (unsigned)port.received.size(), transactions());
+  CHECK(n == sizeof(data));
+  CHECK(writeUs < 50000);
+  CHECK(space >= (int)(sizeof(queue) - 1 - (sizeof(data) - 256)));
+  CHECK(maxLoopUs < 50000);
+  CHECK(port.received.size() == sizeof(data));
+  CHECK(port.received.size() == sizeof(data) && memcmp(&port.received[0], data, sizeof(data)) == 0);
+  CHECK(!chip.irqAsserted());
+}
+
+static DFRobot_IIC_Serial *schedSerials[8];
+static uint8_t schedGot[8][400];
+static size_t schedGotLen[8];
+
+/*只取走调度器本次服务已读入缓存的数据，不额外访问总线*/
+static void onSchedIrq(DFRobot_IIC_Serial *pSerial, uint8_t sifr){
+  for(int i = 0; i < 8; i++){
+      if(schedSerials[i] != pSerial || !(sifr & (IIC_SERIAL_INT_RFTRIG | IIC_SERIAL_INT_RXOVT))){
+          continue;
+      }
+      int n = pSerial->available();
+      while(n-- && schedGotLen[i] < sizeof(schedGot[i])){
+          schedGot[i][schedGotLen[i]++] = pSerial->read();
+      }
+  }
+}
+
+/*调度器：一条总线上4个芯片共8个子串口，1个115200和7个9600端口同时接收，只服务有中断的端口且不丢数据*/
+static void checkScheduler(void){
+  simReset();
+  Wire.setClock(400000);
+  static const uint8_t addrs[4] = {0x02, 0x06, 0x0A, 0x0E};
+  WK2132Model *chips[4];
+  DFRobot_WK2132 *boards[4];
+  DFRobot_IIC_Serial **serials = schedSerials;
+  SimUartPort *ports[8];
+  static uint8_t rxBufs[8][512];
+  memset(schedGotLen, 0, sizeof(schedGotLen));
+  DFRobot_WK2132_Scheduler sched(Wire);
+  for(int c = 0; c < 4; c++){
+      chips[c] = new WK2132Model(addrs[c], 2 + c);
+      chips[c]->attach(Wire);
+      boards[c] = new DFRobot_WK2132(Wire, addrs[c]);
+      for(int ch = 0; ch < 2; ch++){
+          int i = c * 2 + ch;
+          unsigned long baud = (i == 0) ? 115200 : 9600;
+          ports[i] = new SimUartPort(baud);
+          ports[i]->connect(chips[c]->rxPort(ch));
+          serials[i] = new DFRobot_IIC_Serial(*boards[c], ch ? SUBUART_CHANNEL_2 : SUBUART_CHANNEL_1);
+          serials[i]->setRxBuffer(rxBufs[i], sizeof(rxBufs[i]));
+          serials[i]->begin(baud);
+          serials[i]->setInterruptCallback(onSchedIrq);
+      }
+      boards[c]->attachInterruptPin(2 + c);
+  }
+  int added = sched.begin();
+  Wire.resetStats();
+  for(int i = 0; i < 1000; i++){
+      sched.run();
+      delayMicroseconds(100);
+  }
+  uint32_t idle = transactions();
+  uint8_t data[8][400];
+  for(int i = 0; i < 8; i++){
+      fillPattern(data[i], sizeof(data[i]), 20 + i);
+      ports[i]->send(data[i], (i == 0) ? sizeof(data[i]) : 100);
+  }
+  Wire.resetStats();
+  uint64_t t = sim::now();
+  bool done = false;
+  while(!done && sim::now() - t < 1000000){
+      sched.run();
+      done = true;
+      for(int i = 0; i < 8; i++){
+          if(schedGotLen[i] < ((i == 0) ? sizeof(data[i]) : 100)){
+              done = false;
+          }
+      }
+      delayMicroseconds(200);
+  }
+  uint32_t busy = transactions();
+  uint32_t dropped = 0;
+  for(int c = 0; c < 4; c++){
+      dropped += chips[c]->stats(0).rxDropped + chips[c]->stats(1).rxDropped;
+  }
+  DFRobot_WK2132_Scheduler::sPortStats_t fast = sched.getStats(*serials[0]);
+  DFRobot_WK2132_Scheduler::sPortStats_t slow = sched.getStats(*serials[7]);
+  //最大轮询间隔：没有中断的端口也定期服务
+  sched.setMaxPollInterval(10000);
+  for(int i = 0; i < 1000; i++){
+      sched.run();
+      delayMicroseconds(100);
+  }
+  uint32_t forced = sched.getStats(*serials[5]).forced;
+  printf("scheduler: chips=%d idle=%u transactions=%u fast services=%u maxLatency=%uus slow services=%u dropped=%u forced=%u\n",
+         added, idle, busy, fast.services, fast.maxLatencyUs, slow.services, dropped, forced);
+  CHECK(added == 4);
+  CHECK(idle <= BUDGET_IDLE_TRANSACTIONS * 4);
+  CHECK(done);
+  CHECK(dropped == 0);
+  for(int i = 0; i < 8; i++){
+      CHECK(memcmp(schedGot[i], data[i], (i == 0) ? sizeof(data[i]) : 100) == 0);
+  }
+  CHECK(fast.services > slow.services);
+  CHECK(forced >= 5);
+  for(int i = 0; i < 8; i++){
+      delete serials[i];
+      delete ports[i];
+  }
+  for(int c = 0; c < 4; c++){
+      CHECK(!chips[c]->irqAsserted());
+      delete boards[c];
+      delete chips[c];
+  }
+}
+
+static int frameCount;
+static uint16_t frameLen[4];
+static uint8_t frameFlags[4];
+static uint8_t frameBuf[4][64];
+static uint64_t frameAt[4];
+
+static void onFrame(DFRobot_IIC_Serial *pSerial, uint16_t length, uint8_t flags){
+  if(frameCount < 4){
+      frameAt[frameCount] = sim::now();
+      frameLen[frameCount] = pSerial->readFrame(frameBuf[frameCount], sizeof(frameBuf[frameCount]), &frameFlags[frameCount]);
+      frameCount++;
+  }
+}
+
+/*帧模式：9600波特率下以接收超时分帧，第2帧带停止位错误，每帧一次中断加一次批量读取*/
+static void checkFrames(void){
+  simReset();
+  WK2132Model chip(0x0E, 2);
+  chip.attach(Wire);
+  SimUartPort port(9600);
+  port.connect(chip.rxPort(0));
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  static uint8_t rxBuf[256];
+  s1.setRxBuffer(rxBuf, sizeof(rxBuf));
+  s1.begin(9600);
+  s1.setFifoTriggerLevel(128, 0);
+  s1.setFrameMode(true);
+  s1.setFrameCallback(onFrame);
+  board.attachInterruptPin(2);
+  board.service();
+  frameCount = 0;
+  uint8_t f1[8], f2[40];
+  fillPattern(f1, sizeof(f1), 31);
+  fillPattern(f2, sizeof(f2), 32);
+  Wire.resetStats();
+  uint64_t t = sim::now();
+  port.send(f1, sizeof(f1));
+  uint64_t f1End = t + sizeof(f1) * 1000000ULL * 10 / 9600;
+  while(frameCount < 1 && sim::now() - t < 100000){
+      board.service();
+      delayMicroseconds(100);
+  }
+  uint32_t f1Transactions = transactions();
+  port.injectError(SIM_LSR_FE);
+  port.send(f2, sizeof(f2));
+  t = sim::now();
+  while(frameCount < 2 && sim::now() - t < 100000){
+      board.service();
+      delayMicroseconds(100);
+  }
+  uint8_t buf[8];
+  uint8_t flags = 0xff;
+  uint16_t n = s1.readFrame(buf, sizeof(buf), &flags);
+  printf("frames: count=%d len=%u,%u flags=0x%02x,0x%02x latency=%lluus transactions=%u idleRead=%u\n", frameCount,
+         frameLen[0], frameLen[1], frameFlags[0], frameFlags[1], (unsigned long long)(frameAt[0] - f1End), f1Transactions, n);
+  CHECK(frameCount == 2);
+  CHECK(frameLen[0] == sizeof(f1) && memcmp(frameBuf[0], f1, sizeof(f1)) == 0);
+  CHECK(frameLen[1] == sizeof(f2) && memcmp(frameBuf[1], f2, sizeof(f2)) == 0);
+  CHECK(frameFlags[0] == 0);
+  CHECK(frameFlags[1] == IIC_SERIAL_FRAME_FE);
+  //GIFR、SIFR、状态快照各一次寄存器读，加一次FIFO读
+  CHECK(f1Transactions <= 7);
+  //接收超时(4个字符时间)之后2.5ms内交给回调
+  CHECK(frameAt[0] - f1End < 4 * 1042 + 2500);
+  CHECK(n == 0 && flags == 0xff);
+}
+
+static uint8_t sinkBuf[1000];
+static size_t sinkLen;
+static size_t sinkMaxChunk;
+
+static void onSink(DFRobot_IIC_Serial *pSerial, const uint8_t *pData, size_t size){
+  if(size > sinkMaxChunk){
+      sinkMaxChunk = size;
+  }
+  if(sinkLen + size <= sizeof(sinkBuf)){
+      memcpy(sinkBuf + sinkLen, pData, size);
+  }
+  sinkLen += size;
+}
+
+/*接收函数：中断读出的数据按Wire分包直接交给接收函数，不经过主控端接收缓存*/
+static void checkRxSink(void){
+  simReset();
+  Wire.setClock(400000);
+  WK2132Model chip(0x0E, 2);
+  chip.attach(Wire);
+  SimUartPort port(115200);
+  port.connect(chip.rxPort(0));
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  s1.begin(115200);
+  s1.setFifoTriggerLevel(64, 0);
+  s1.setRxSink(onSink);
+  board.attachInterruptPin(2);
+  sinkLen = 0;
+  sinkMaxChunk = 0;
+  uint8_t data[1000];
+  fillPattern(data, sizeof(data), 41);
+  port.send(data, sizeof(data));
+  Wire.resetStats();
+  uint64_t t = sim::now();
+  while(sinkLen < sizeof(data) && sim::now() - t < 200000){
+      board.service();
+      delayMicroseconds(100);
+  }
+  uint32_t n = transactions();
+  printf("rx sink: bytes=%u maxChunk=%u transactions=%u dropped=%u\n", (unsigned)sinkLen, (unsigned)sinkMaxChunk, n,
+         chip.stats(0).rxDropped);
+  CHECK(sinkLen == sizeof(data));
+  CHECK(memcmp(sinkBuf, data, sizeof(data)) == 0);
+  CHECK(sinkMaxChunk <= IIC_SERIAL_WIRE_BUFFER_SIZE);
+  CHECK(chip.stats(0).rxDropped == 0);
+  CHECK(s1.drain() == 0);
+  CHECK(s1.available() == 0);
+}
+
+/*软件流控：接收水位达到高水位时发XOFF，取空后发XON；对端XOFF暂停本端发送，XON恢复，流控字符不进入数据*/
+static void checkFlowControl(void){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  SimUartPort port(115200);
+  chip.connect(0, &port);
+  port.connect(chip.rxPort(0));
+  DFRobot_IIC_Serial s1(Wire, SUBUART_CHANNEL_1, 0x0E);
+  s1.begin(115200);
+  s1.setFlowControl(true, 192, 64);
+  uint8_t data[220];
+  for(size_t i = 0; i < sizeof(data); i++){
+      data[i] = 'A' + i % 26;
+  }
+  port.send(data, sizeof(data));
+  delay(25);
+  //读取较慢的一方：只查询不取走，FIFO加缓存超过高水位
+  s1.available();
+  delay(1);
+  bool xoff = port.received.size() == 1 && port.received[0] == IIC_SERIAL_XOFF;
+  uint8_t got[sizeof(data)];
+  size_t n = 0;
+  uint64_t t = sim::now();
+  while(n < sizeof(data) && sim::now() - t < 100000){
+      n += s1.readAvailable(got + n, sizeof(got) - n);
+  }
+  s1.available();
+  delay(1);
+  bool xon = port.received.size() == 2 && port.received[1] == IIC_SERIAL_XON;
+
+  //对端XOFF后写入的数据留在主控端发送队列中，XON后发出；夹在数据中的流控字符被去掉
+  port.received.clear();
+  const uint8_t ctrl[] = {'x', IIC_SERIAL_XOFF, 'y'};
+  port.send(ctrl, sizeof(ctrl));
+  delay(1);
+  s1.available();
+  bool paused = s1.peerPaused();
+  size_t queued = s1.write(data, 30);
+  delay(10);
+  size_t whilePaused = port.received.size();
+  const uint8_t resume[] = {IIC_SERIAL_XON, 'z'};
+  port.send(resume, sizeof(resume));
+  delay(1);
+  uint8_t tail[4];
+  size_t m = s1.readAvailable(tail, sizeof(tail));
+  t = sim::now();
+  while(port.received.size() < 30 && sim::now() - t < 100000){
+      delay(1);
+  }
+  printf("flow control: xoff=%d xon=%d rx=%u dropped=%u paused=%d sentWhilePaused=%u resumed=%u\n", xoff, xon,
+         (unsigned)n, chip.stats(0).rxDropped, paused, (unsigned)whilePaused, (unsigned)port.received.size());
+  CHECK(xoff);
+  CHECK(xon);
+  CHECK(n == sizeof(data) && memcmp(got, data, sizeof(data)) == 0);
+  CHECK(chip.stats(0).rxDropped == 0);
+  CHECK(paused);
+  CHECK(queued == 30);
+  CHECK(whilePaused == 0);
+  CHECK(!s1.peerPaused());
+  CHECK(m == 3 && memcmp(tail, "xyz", 3) == 0);
+  CHECK(port.received.size() == 30 && memcmp(&port.received[0], data, 30) == 0);
+}
+
+/*双方互相发送XOFF：暂停期间本端的XON仍能发出，取走数据后两端都恢复，暂停期间排队的数据随后发出*/
+static void checkFlowMutualPause(void){
+  simReset();
+  Wire.setClock(400000);
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  chip.crossConnect(0, chip, 1);
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  DFRobot_IIC_Serial s2(board, SUBUART_CHANNEL_2);
+  DFRobot_IIC_Serial *ports[2] = {&s1, &s2};
+  static uint8_t data[2][220], got[2][220];
+  size_t n[2] = {0, 0}, queued[2] = {0, 0};
+  for(uint8_t i = 0; i < 2; i++){
+      ports[i]->begin(115200);
+      ports[i]->setFlowControl(true, 64, 16);
+      ports[i]->setWritePolicy(DFRobot_IIC_Serial::eWritePartial);
+      //数据中不能出现XON/XOFF
+      for(size_t k = 0; k < sizeof(data[i]); k++){
+        data[i][k] = (i ? 'a' : 'A') + k % 26;
+      }
+  }
+  for(uint8_t i = 0; i < 2; i++){
+      ports[i]->write(data[i], 200);
+  }
+  //双方都超过高水位，各自发出的XOFF排在200字节数据之后
+  delay(25);
+  s1.available();
+  s2.available();
+  //s1先取完数据，读到s2的XOFF后暂停；此时s1的水位已降到低水位以下，暂停中照常发出XON
+  uint64_t t = sim::now();
+  while(n[0] < 200 && sim::now() - t < 100000){
+      n[0] += s1.readAvailable(got[0] + n[0], 200 - n[0]);
+      delay(1);
+  }
+  s1.available();
+  bool paused = s1.peerPaused();
+  queued[0] = s1.write(data[0] + 200, 20);
+  delay(5);
+  //s2取完数据后读到s1的XOFF和XON，随后发出自己的XON，s1恢复并发出排队的数据
+  t = sim::now();
+  while((n[0] < sizeof(got[0]) || n[1] < sizeof(got[1])) && sim::now() - t < 200000){
+      n[1] += s2.readAvailable(got[1] + n[1], sizeof(got[1]) - n[1]);
+      if(n[1] >= 200 && queued[1] == 0){
+        queued[1] = s2.write(data[1] + 200, 20);
+      }
+      n[0] += s1.readAvailable(got[0] + n[0], sizeof(got[0]) - n[0]);
+      delay(1);
+  }
+  printf("flow mutual pause: paused=%d queued=%u/%u got=%u/%u resumed=%d/%d\n", paused, (unsigned)queued[0],
+         (unsigned)queued[1], (unsigned)n[0], (unsigned)n[1], !s1.peerPaused(), !s2.peerPaused());
+  CHECK(paused);
+  CHECK(queued[0] == 20 && queued[1] == 20);
+  //s1收到s2发出的数据，s2收到s1发出的数据
+  CHECK(n[0] == sizeof(got[0]) && memcmp(got[0], data[1], sizeof(got[0])) == 0);
+  CHECK(n[1] == sizeof(got[1]) && memcmp(got[1], data[0], sizeof(got[1])) == 0);
+  CHECK(!s1.peerPaused() && !s2.peerPaused());
+}
+
+/*单字节写FDAT时数据NACK(芯片已收下数据)不重试，字节只发出一次；地址NACK照常重试*/
+static void checkFdatRetry(void){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  SimUartPort port(115200);
+  chip.connect(0, &port);
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  s1.begin(115200);
+  s1.availableForWrite();
+  Wire.injectDataNack(1);
+  size_t nacked = s1.write('Q');
+  Wire.injectNack(1);
+  size_t retried = s1.write('R');
+  delay(2);
+  printf("fdat retry: nacked=%u retried=%u received=%u\n", (unsigned)nacked, (unsigned)retried, (unsigned)port.received.size());
+  CHECK(nacked == 0 && retried == 1);
+  CHECK(port.received.size() == 2 && port.received[0] == 'Q' && port.received[1] == 'R');
+}
+
+/*对端暂停期间flush()继续读取接收FIFO，收到XON后发完队列返回；一直暂停时按超时返回。恢复后新写入的数据排在队列之后*/
+static void checkFlowResumeOrder(void){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  SimUartPort port(9600);
+  chip.connect(0, &port);
+  port.connect(chip.rxPort(0));
+  DFRobot_IIC_Serial s1(Wire, SUBUART_CHANNEL_1, 0x0E);
+  static uint8_t txBuf[512];
+  s1.begin(9600);
+  s1.setTxBuffer(txBuf, sizeof(txBuf));
+  s1.setFlowControl(true);
+  s1.setTimeout(200);
+  static uint8_t data[410];
+  for(size_t i = 0; i < sizeof(data); i++){
+      data[i] = 'A' + i % 26;
+  }
+  const uint8_t xoff = IIC_SERIAL_XOFF, xon = IIC_SERIAL_XON;
+  //XOFF -> 排队 -> flush()，XON在flush()开始后20ms到达
+  port.send(&xoff, 1);
+  delay(2);
+  s1.available();
+  bool paused = s1.peerPaused();
+  size_t queued = s1.write(data, 30);
+  port.send(&xon, 1, 20000);
+  uint64_t t = sim::now();
+  s1.flush();
+  uint32_t flushUs = (uint32_t)(sim::now() - t);
+  bool flushed = port.received.size() == 30 && memcmp(&port.received[0], data, 30) == 0;
+  //一直暂停：flush()在超时后返回，数据留在队列中
+  port.received.clear();
+  port.send(&xoff, 1);
+  delay(2);
+  s1.available();
+  s1.write(data, 10);
+  t = sim::now();
+  s1.flush();
+  uint32_t timeoutUs = (uint32_t)(sim::now() - t);
+  int left = (int)sizeof(txBuf) - 1 - s1.availableForWrite();
+  s1.setTimeout(1000);
+  port.send(&xon, 1);
+  s1.flush();
+  bool released = port.received.size() == 10;
+  //XOFF期间排队400字节，XON后setPeerPaused()只poll()一次，随后的单字节写和阻塞写排在队列之后
+  port.received.clear();
+  port.send(&xoff, 1);
+  delay(2);
+  s1.available();
+  size_t queued2 = s1.write(data, 400);
+  port.send(&xon, 1);
+  delay(2);
+  s1.available();
+  size_t one = s1.write('#');
+  size_t tail = s1.write(data + 400, 10);
+  s1.flush();
+  printf("flow resume order: paused=%d queued=%u flushUs=%u timeoutUs=%u left=%u queued2=%u tail=%u received=%u\n", paused,
+         (unsigned)queued, flushUs, timeoutUs, (unsigned)left, (unsigned)queued2, (unsigned)tail, (unsigned)port.received.size());
+  CHECK(paused && queued == 30);
+  CHECK(flushed);
+  CHECK(timeoutUs >= 190000 && timeoutUs < 300000);
+  CHECK(left == 10);
+  CHECK(released);
+  CHECK(queued2 == 400 && one == 1 && tail == 10);
+  CHECK(port.received.size() == 411 && memcmp(&port.received[0], data, 400) == 0 && port.received[400] == '#' &&
+        memcmp(&port.received[401], data + 400, 10) == 0);
+}
+
+/*总线出错：偶发NACK由重试消化；无应答的芯片连续出错后退避，不再占用总线，同一总线上其他芯片的接收不受影响*/
+static void checkBusErrors(void){
+  simReset();
+  Wire.setClock(400000);
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  SimUartPort port(115200);
+  port.connect(chip.rxPort(0));
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  int ok = s1.begin(115200);
+  Wire.injectNack(1);
+  int n0 = s1.available();
+  bool retried = (n0 == 0 && board.getErrorCount() == 0 && board.getHealth() == DFRobot_WK2132::eHealthOk);
+
+  //0x06上没有芯片，如同掉线的板子
+  DFRobot_WK2132 dead(Wire, 0x06);
+  DFRobot_IIC_Serial d1(dead, SUBUART_CHANNEL_1);
+  int err = d1.begin(115200);
+  int val = d1.read();
+  int recover = dead.recoverBus();
+
+  uint8_t data[300];
+  fillPattern(data, sizeof(data), 57);
+  port.send(data, sizeof(data));
+  uint8_t got[sizeof(data)];
+  size_t n = 0;
+  uint32_t deadTransactions = 0;
+  uint64_t t = sim::now();
+  while(n < sizeof(data) && sim::now() - t < 200000){
+      uint32_t before = transactions();
+      d1.available();
+      deadTransactions += transactions() - before;
+      n += s1.readAvailable(got + n, sizeof(got) - n);
+      delayMicroseconds(200);
+  }
+  printf("bus errors: begin=%d dead=%d health=%d errors=%u deadTransactions=%u rx=%u dropped=%u\n", ok, err,
+         dead.getHealth(), dead.getErrorCount(), deadTransactions, (unsigned)n, chip.stats(0).rxDropped);
+  CHECK(ok == ERR_OK);
+  CHECK(retried);
+  CHECK(err == ERR_DATA_READ);
+  CHECK(val == -1);
+  CHECK(recover == ERR_PIN);
+  CHECK(dead.getHealth() == DFRobot_WK2132::eHealthOffline);
+  CHECK(d1.available() == 0);
+  CHECK(dead.getLastError() == ERR_BUS_OFF);
+  //退避从2ms开始加倍，约30ms内只有几次探测
+  CHECK(deadTransactions <= 6 * (IIC_SERIAL_RETRIES + 1));
+  CHECK(n == sizeof(data) && memcmp(got, data, sizeof(data)) == 0);
+  CHECK(chip.stats(0).rxDropped == 0);
+  CHECK(board.getHealth() == DFRobot_WK2132::eHealthOk);
+
+  //错误码互不相同：无应答的芯片为ERR_DATA_READ，未设置引脚为ERR_PIN，SDA一直被拉低为ERR_DATA_BUS
+  dead.setRecoveryPins(20, 21);
+  sim::setPinLevel(20, LOW);
+  int stuck = dead.recoverBus();
+  sim::setPinLevel(20, HIGH);
+  int released = dead.recoverBus();
+  CHECK(ERR_PIN != ERR_DATA_BUS && ERR_DATA_READ != ERR_DATA_BUS);
+  CHECK(stuck == ERR_DATA_BUS);
+  CHECK(released == ERR_OK);
+}
+
+/*主机串口桩：输入数据预先放好，写出的数据记录下来*/
+class MemStream : public Stream{
+public:
+  MemStream(): pos(0){}
+  virtual int available(void){ return (int)(in.size() - pos); }
+  virtual int peek(void){ return (pos < in.size()) ? in[pos] : -1; }
+  virtual int read(void){ return (pos < in.size()) ? in[pos++] : -1; }
+  virtual size_t write(uint8_t c){ out.push_back(c); return 1; }
+  using Print::write;
+  std::vector<uint8_t> in;
+  std::vector<uint8_t> out;
+  size_t pos;
+};
+
+/*基准示例的时间窗口按32位计算，与64位的精确值相差不超过1%，在AVR、ESP32上不会溢出*/
+static void checkBenchWindows(void){
+  static const uint32_t bauds[] = {300, 9600, 57600, 115200, 230400, 460800, 691200, 1000000};
+  int bad = 0;
+  for(uint8_t i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++){
+    uint32_t bytes = bauds[i] / 40 < 256 ? 256 : bauds[i] / 40;
+    uint64_t sendRef = (uint64_t)bytes * 10000000ULL / bauds[i] * 2 + 100000;
+    uint64_t drainRef = 512ULL * 10000000ULL / bauds[i] + 20000;
+    uint32_t sendUs = benchSendUs(bytes, bauds[i]), drainUs = benchDrainUs(bauds[i]);
+    if(sendUs > sendRef * 1.01 || sendUs < sendRef * 0.99 || drainUs > drainRef * 1.01 || drainUs < drainRef * 0.99){
+      printf("  bench window baud=%u send=%u/%llu drain=%u/%llu\n", bauds[i], sendUs, (unsigned long long)sendRef,
+             drainUs, (unsigned long long)drainRef);
+      bad++;
+    }
+  }
+  CHECK(bad == 0);
+}
+
+/*转发桥：两个子串口全双工线速互转，主机串口与子串口互转，数据完整且不丢失*/
+static void checkBridge(void){
+  simReset();
+  Wire.setClock(1000000);
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  SimUartPort portA(115200), portB(115200);
+  portA.connect(chip.rxPort(0));
+  chip.connect(0, &portA);
+  portB.connect(chip.rxPort(1));
+  chip.connect(1, &portB);
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  DFRobot_IIC_Serial s2(board, SUBUART_CHANNEL_2);
+  s1.begin(115200);
+  s2.begin(115200);
+  DFRobot_WK2132_Bridge bridge(s1, s2);
+  static uint8_t a[2000], b[2000];
+  fillPattern(a, sizeof(a), 61);
+  fillPattern(b, sizeof(b), 67);
+  Wire.resetStats();
+  uint64_t t = sim::now();
+  portA.send(a, sizeof(a));
+  portB.send(b, sizeof(b));
+  while((portA.received.size() < sizeof(b) || portB.received.size() < sizeof(a)) && sim::now() - t < 1000000){
+      bridge.run();
+      delayMicroseconds(500);
+  }
+  t = sim::now() - t;
+  uint32_t n = transactions();
+  double lineUs = sizeof(a) * 10 * 1e6 / 115200;
+  printf("bridge: a->b=%u b->a=%u time=%.0fms (line %.0fms) transactions/byte=%.3f held=%u/%u dropped=%u/%u\n",
+         bridge.stats(0).forwarded, bridge.stats(1).forwarded, t / 1000.0, lineUs / 1000, (double)n / (2 * sizeof(a)),
+         bridge.stats(0).held, bridge.stats(1).held, chip.stats(0).rxDropped, chip.stats(1).rxDropped);
+  CHECK(portB.received.size() == sizeof(a) && memcmp(&portB.received[0], a, sizeof(a)) == 0);
+  CHECK(portA.received.size() == sizeof(b) && memcmp(&portA.received[0], b, sizeof(b)) == 0);
+  CHECK(chip.stats(0).rxDropped == 0 && chip.stats(1).rxDropped == 0);
+  //接收和发送各经过一次FIFO，总时间只比线路时间多出约两个FIFO批次
+  CHECK(t < lineUs * 1.1 + 10000);
+  //每0.5ms轮询一次，每批约6个字节；逐字节转发约4次事务/字节
+  CHECK((double)n / (2 * sizeof(a)) < 0.5);
+
+  //主机串口一侧
+  MemStream host;
+  host.in.assign(a, a + 600);
+  DFRobot_WK2132_Bridge hostBridge(host, s2);
+  portA.received.clear();
+  portB.received.clear();
+  portB.send(b, 300);
+  t = sim::now();
+  while((portB.received.size() < 600 || host.out.size() < 300) && sim::now() - t < 500000){
+      hostBridge.run();
+      delayMicroseconds(500);
+  }
+  printf("bridge host: host->b=%u b->host=%u held=%u maxHeld=%u\n", hostBridge.stats(0).forwarded,
+         hostBridge.stats(1).forwarded, hostBridge.stats(0).held, hostBridge.stats(0).maxHeld);
+  CHECK(portB.received.size() == 600 && memcmp(&portB.received[0], a, 600) == 0);
+  CHECK(host.out.size() == 300 && memcmp(&host.out[0], b, 300) == 0);
+  //主机一侧一次给出600字节，超出发送FIFO的部分暂存在转发桥中
+  CHECK(hostBridge.stats(0).held > 0);
+}
+
+/*Break帧：两个子串口同时以40Hz发送DMX512整帧，Break、MAB和数据完整；LIN帧头和校验和*/
+static void checkBreakFrames(void){
+  simReset();
+  Wire.setClock(1000000);
+  WK2132Model chip(0x0E, 2);
+  chip.attach(Wire);
+  SimUartPort portA(250000, IIC_SERIAL_8N2), portB(250000, IIC_SERIAL_8N2);
+  chip.connect(0, &portA);
+  chip.connect(1, &portB);
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  DFRobot_IIC_Serial s2(board, SUBUART_CHANNEL_2);
+  s1.begin(250000, IIC_SERIAL_8N2);
+  s2.begin(250000, IIC_SERIAL_8N2);
+  board.attachInterruptPin(2);
+  static uint8_t u1[513], u2[513];
+  fillPattern(u1, sizeof(u1), 71);
+  fillPattern(u2, sizeof(u2), 73);
+  u1[0] = 0;
+  u2[0] = 0;
+  const int FRAMES = 6;
+  const uint64_t PERIOD = 25000;
+  int busy = 0;
+  uint64_t t = sim::now();
+  for(int f = 0; f < FRAMES; f++){
+      while(sim::now() - t < f * PERIOD){
+          board.service();
+          delayMicroseconds(100);
+      }
+      busy += (s1.sendDmx(u1) != ERR_OK) + (s2.sendDmx(u2) != ERR_OK);
+  }
+  while((s1.breakFrameBusy() || s2.breakFrameBusy() || portB.received.size() < FRAMES * 514u) && sim::now() - t < FRAMES * PERIOD + 50000){
+      board.service();
+      delayMicroseconds(100);
+  }
+  SimUartPort *ports[2] = {&portA, &portB};
+  const uint8_t *u[2] = {u1, u2};
+  bool framesOk = true;
+  uint64_t minMab = (uint64_t)-1, maxJitter = 0;
+  for(int p = 0; p < 2; p++){
+      SimUartPort &port = *ports[p];
+      framesOk = framesOk && port.received.size() == FRAMES * 514u;
+      for(int f = 0; framesOk && f < FRAMES; f++){
+          size_t i = f * 514;
+          framesOk = (port.receivedFlags[i] & SIM_LSR_BI) && memcmp(&port.received[i + 1], u[p], 513) == 0;
+          //第一个数据字节收到时减去一个字符时间即为MAB结束
+          uint64_t mab = port.receivedAt[i + 1] - port.receivedAt[i] - 44;
+          if(mab < minMab) minMab = mab;
+          if(f){
+              uint64_t period = port.receivedAt[i] - port.receivedAt[i - 514];
+              uint64_t jitter = (period > PERIOD) ? period - PERIOD : PERIOD - period;
+              if(jitter > maxJitter) maxJitter = jitter;
+          }
+      }
+  }
+  printf("dmx: frames=%d busy=%d breaks=%u/%u minMab=%uus maxJitter=%uus\n", FRAMES, busy, chip.stats(0).breaks,
+         chip.stats(1).breaks, (unsigned)minMab, (unsigned)maxJitter);
+  CHECK(busy == 0);
+  CHECK(framesOk);
+  CHECK(chip.stats(0).breaks == FRAMES && chip.stats(1).breaks == FRAMES);
+  CHECK(minMab >= IIC_SERIAL_DMX_MAB_US);
+  CHECK(maxJitter < 1000);
+
+  //LIN：ID 0x10的受保护ID为0x50，增强型校验和包含受保护ID
+  s2.begin(19200);
+  portB.setBaud(19200);
+  portB.received.clear();
+  portB.receivedFlags.clear();
+  const uint8_t data[4] = {0x01, 0x80, 0xff, 0x7e};
+  int ret = s2.sendLinFrame(0x10, data, sizeof(data));
+  t = sim::now();
+  while(portB.received.size() < 8 && sim::now() - t < 20000){
+      s2.poll();
+      delay(1);
+  }
+  uint16_t sum = 0x50;
+  for(uint8_t i = 0; i < sizeof(data); i++){
+      sum += data[i];
+      if(sum > 0xff) sum -= 0xff;
+  }
+  printf("lin: ret=%d bytes=%u pid=0x%02X checksum=0x%02X\n", ret, (unsigned)portB.received.size(),
+         portB.received.size() > 2 ? portB.received[2] : 0, portB.received.size() > 7 ? portB.received[7] : 0);
+  CHECK(ret == ERR_OK);
+  CHECK(portB.received.size() == 8);
+  CHECK(portB.received.size() == 8 && (portB.receivedFlags[0] & SIM_LSR_BI) && portB.received[1] == 0x55 &&
+        portB.received[2] == 0x50 && memcmp(&portB.received[3], data, 4) == 0 && portB.received[7] == (uint8_t)~sum);
+}
+
+#if IIC_SERIAL_ENABLE_TRACE
+/*事务跟踪：记录与总线上实际发生的事务一一对应，导出的二进制/十六进制格式一致，写出文件供wk2132_trace回放*/
+static void checkTrace(void){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  chip.loopback(0);
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  s1.begin(115200);
+  board.clearTrace();
+  Wire.resetStats();
+  const uint8_t msg[] = "trace";
+  s1.write(msg, sizeof(msg));
+  delay(2);
+  uint8_t buf[16];
+  size_t n = s1.readAvailable(buf, sizeof(buf));
+  s1.setFifoTriggerLevel(32, 0);
+  uint32_t writes = Wire.stats().writes;
+  uint32_t reads = Wire.stats().reads;
+  uint16_t count = board.traceCount();
+  MemStream bin, hex;
+  board.dumpTrace(bin);
+  board.dumpTrace(hex, true);
+  //十六进制文本转回二进制应与二进制输出相同
+  std::vector<uint8_t> decoded;
+  int hi = -1;
+  for(size_t i = 0; i < hex.out.size(); i++){
+    char c = hex.out[i];
+    if(!isxdigit(c)) continue;
+    int v = isdigit(c) ? c - '0' : c - 'A' + 10;
+    if(hi < 0){
+      hi = v;
+    }else{
+      decoded.push_back((hi << 4) | v);
+      hi = -1;
+    }
+  }
+  FILE *fp = fopen("wk2132_trace.bin", "wb");
+  if(fp){
+    fwrite(&bin.out[0], 1, bin.out.size(), fp);
+    fclose(fp);
+  }
+  //寄存器读为一次写(寄存器地址)加一次读，记为一条，所以记录数在写事务数和总事务数之间
+  printf("trace: records=%u wireWrites=%u bytes=%u rx=%u\n", count, writes, (unsigned)bin.out.size(), (unsigned)n);
+  CHECK(n == sizeof(msg));
+  CHECK(count > 0 && count <= writes + reads && count >= writes);
+  CHECK(bin.out.size() == 8 + count * sizeof(sTraceRecord_t));
+  CHECK(memcmp(&bin.out[0], "WKTR", 4) == 0 && bin.out[4] == IIC_SERIAL_TRACE_VERSION && (bin.out[6] | (bin.out[7] << 8)) == count);
+  CHECK(decoded == bin.out);
+  //最后两条为写RFTL(第1页0x07)和切回第0页
+  const uint8_t *rftl = &bin.out[bin.out.size() - 2 * sizeof(sTraceRecord_t)];
+  const uint8_t *last = rftl + sizeof(sTraceRecord_t);
+  CHECK(rftl[4] == ((0x0E << 3) | 0) && rftl[5] == REG_WK2132_RFTL && rftl[6] == 0 && rftl[8] == 32 && rftl[9] == 0);
+  CHECK(last[5] == REG_WK2132_SPAGE && last[6] == 0 && last[8] == 0);
+  CHECK(fp != NULL);
+}
+#endif
+
+#if IIC_SERIAL_ENABLE_STATS
+/*通道统计与总线上实际发生的事务一致*/
+static void checkStats(void){
+  simReset();
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  DFRobot_IIC_Serial s1(Wire, SUBUART_CHANNEL_1, 0x0E);
+  s1.begin(9600);
+  s1.resetStats();
+  Wire.resetStats();
+  s1.setFifoTriggerLevel(64, 0);
+  CHECK(s1.read() == -1);
+  uint8_t data[600];
+  fillPattern(data, sizeof(data), 11);
+  s1.setWritePolicy(DFRobot_IIC_Serial::eWritePartial);
+  size_t n = s1.write(data, sizeof(data));
+  Wire.injectNack(1);
+  s1.available();
+  const DFRobot_IIC_Serial::sStats_t &st = s1.stats();
+  uint32_t calls = 0;
+  for(uint8_t i = 0; i < IIC_SERIAL_STATS_BUCKETS; i++){
+      calls += st.latency[i];
+  }
+  printf("stats: transactions=%u out=%u in=%u pages=%u full=%u empty=%u nacks=%u calls=%u\n", st.transactions,
+         st.bytesOut, st.bytesIn, st.pageSwitches, st.fifoFull, st.fifoEmpty, st.nacks, calls);
+  CHECK(n >= 256 && n < sizeof(data));
+  CHECK(st.transactions == transactions());
+  CHECK(st.bytesIn == Wire.stats().bytesIn);
+  CHECK(st.pageSwitches == 2);
+  CHECK(st.fifoEmpty == 1);
+  CHECK(st.fifoFull == 1);
+  CHECK(st.nacks == 1);
+  CHECK(calls > 0 && calls <= st.transactions);
+}
+#endif
+
+#if IIC_SERIAL_ENABLE_RTOS
+/*一个线程反复收发并改写第1页的触发点，返回内容不符或没收到的字节数*/
+static uint32_t rtosChannelTask(DFRobot_IIC_Serial *pSerial, uint8_t seed, uint8_t *pLevel){
+  uint8_t data[100], buf[100];
+  uint32_t bad = 0;
+  for(uint8_t round = 0; round < 20; round++){
+    *pLevel = (uint8_t)(seed + round);
+    pSerial->setFifoTriggerLevel(*pLevel, 0);
+    fillPattern(data, sizeof(data), (uint8_t)(seed + round));
+    pSerial->write(data, sizeof(data));
+    //另一个线程也在推进仿真时间，超时按实际时间计算
+    size_t got = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while(got < sizeof(buf) && std::chrono::steady_clock::now() - start < std::chrono::seconds(5)){
+      got += pSerial->readAvailable(buf + got, sizeof(buf) - got);
+    }
+    for(size_t i = 0; i < sizeof(data); i++){
+      if(i >= got || buf[i] != data[i]){
+        bad++;
+      }
+    }
+  }
+  return bad;
+}
+
+/*RTOS模式：两个线程各用同一芯片的一个子串口直接访问总线；任务模式下由总线线程poll()，应用线程只读写主控端缓存*/
+static void checkRtos(void){
+  simReset();
+  Wire.setClock(400000);
+  WK2132Model chip(0x0E);
+  chip.attach(Wire);
+  chip.loopback(0);
+  chip.loopback(1);
+  DFRobot_WK2132 board(Wire, 0x0E);
+  DFRobot_IIC_Serial s1(board, SUBUART_CHANNEL_1);
+  DFRobot_IIC_Serial s2(board, SUBUART_CHANNEL_2);
+  s1.begin(115200);
+  s2.begin(115200);
+  board.resetLockStats();
+  uint32_t bad1 = 0, bad2 = 0;
+  uint8_t level1 = 0, level2 = 0;
+  std::thread t1([&]{bad1 = rtosChannelTask(&s1, 10, &level1);});
+  std::thread t2([&]{bad2 = rtosChannelTask(&s2, 40, &level2);});
+  t1.join();
+  t2.join();
+  DFRobot_WK2132::sLockStats_t ls = board.lockStats();
+  printf("rtos: bad=%u/%u locks=%u contended=%u wait=%uus maxWait=%uus baud=%.0f/%.0f\n", bad1, bad2, ls.locks,
+         ls.contended, ls.waitUs, ls.maxWaitUs, chip.actualBaud(0), chip.actualBaud(1));
+  CHECK(bad1 == 0 && bad2 == 0);
+  CHECK(ls.locks > 0);
+  //第1页的访问没有被另一个通道插入：触发点为各自最后写入的值，波特率、页都没有被改写
+  CHECK(chip.reg(0, 1, 0x07) == level1 && chip.reg(1, 1, 0x07) == level2);
+  CHECK(chip.actualBaud(0) > 115200 * 0.98 && chip.actualBaud(0) < 115200 * 1.02);
+  CHECK(chip.actualBaud(1) > 115200 * 0.98 && chip.actualBaud(1) < 115200 * 1.02);
+  CHECK((chip.globalReg(0x03) & 0x01) == 0);
+
+  //应用占用总线时另一线程的访问等待，等待次数和时间计入锁统计
+  board.resetLockStats();
+  board.lock();
+  std::thread waiter([&]{s2.available();});
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  delayMicroseconds(300);
+  board.unlock();
+  waiter.join();
+  ls = board.lockStats();
+  printf("rtos contention: locks=%u contended=%u wait=%uus\n", ls.locks, ls.contended, ls.waitUs);
+  CHECK(ls.contended == 1 && ls.waitUs >= 300 && ls.maxWaitUs == ls.waitUs);
+
+  //任务模式
+  //仿真时间只由总线线程推进，应用线程不等待，只写发送队列能容纳的部分
+  s1.setTaskMode(true);
+  s2.setTaskMode(true);
+  s1.setWritePolicy(DFRobot_IIC_Serial::eWritePartial);
+  s2.setWritePolicy(DFRobot_IIC_Serial::eWritePartial);
+  s1.resetRingStats();
+  s2.resetRingStats();
+  std::atomic<bool> stop(false);
+  std::thread bus([&]{
+      while(!stop.load()){
+        s1.poll();
+        s2.poll();
+        delayMicroseconds(500);
+        std::this_thread::yield();
+      }
+  });
+  static uint8_t a[3000], b[3000], ra[3000], rb[3000];
+  fillPattern(a, sizeof(a), 71);
+  fillPattern(b, sizeof(b), 73);
+  size_t gotA = 0, gotB = 0, sentA = 0, sentB = 0;
+  uint32_t busBefore = transactions();
+  std::thread app([&]{
+      //应用线程不调用推进仿真时间的函数，超时按实际时间；在途数据不超过接收FIFO，数据不会因应用线程调度慢而溢出
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      while((gotA < sizeof(a) || gotB < sizeof(b)) && std::chrono::steady_clock::now() - start < std::chrono::seconds(20)){
+        if(sentA < sizeof(a) && sentA - gotA < 200){
+          sentA += s1.write(a + sentA, (sizeof(a) - sentA) > 64 ? 64 : sizeof(a) - sentA);
+        }
+        if(sentB < sizeof(b) && sentB - gotB < 200){
+          sentB += s2.write(b + sentB, (sizeof(b) - sentB) > 64 ? 64 : sizeof(b) - sentB);
+        }
+        gotA += s1.readAvailable(ra + gotA, sizeof(ra) - gotA);
+        gotB += s2.readAvailable(rb + gotB, sizeof(rb) - gotB);
+        std::this_thread::yield();
+      }
+  });
+  app.join();
+  stop = true;
+  bus.join();
+  s1.setTaskMode(false);
+  s2.setTaskMode(false);
+  const DFRobot_IIC_Serial::sRingStats_t &r1 = s1.ringStats();
+  const DFRobot_IIC_Serial::sRingStats_t &r2 = s2.ringStats();
+  printf("rtos task: sent=%u/%u got=%u/%u rxHigh=%u/%u txHigh=%u/%u rxFull=%u/%u txFull=%u/%u transactions=%u\n",
+         (unsigned)sentA, (unsigned)sentB, (unsigned)gotA, (unsigned)gotB, r1.rxHighWater, r2.rxHighWater, r1.txHighWater, r2.txHighWater, r1.rxFull,
+         r2.rxFull, r1.txFull, r2.txFull, transactions() - busBefore);
+  CHECK(gotA == sizeof(a) && memcmp(ra, a, sizeof(a)) == 0);
+  CHECK(gotB == sizeof(b) && memcmp(rb, b, sizeof(b)) == 0);
+  CHECK(r1.rxHighWater > 0 && r1.txHighWater > 0);
+  CHECK(chip.stats(0).rxDropped == 0 && chip.stats(1).rxDropped == 0);
+}
+#endif
+
+int main(void){
+  checkBringup();
+  checkTxThroughput(100000);
+  checkTxThroughput(400000);
+  checkRxPolling(100000, 57600);
+  checkRxPolling(400000, 115200);
+  checkStream();
+  checkTemplateChannel();
+  checkBaudRates();
+  checkLineErrors();
+  checkWarmAttach();
+  checkFullFifo(true);
+  checkFullFifo(false);
+  checkInterrupt();
+  checkIrqHandlers();
+  checkAsyncTx(false);
+  checkAsyncTx(true);
+  checkScheduler();
+  checkFrames();
+  checkRxSink();
+  checkFlowControl();
+  checkFlowMutualPause();
+  checkFlowResumeOrder();
+  checkBusErrors();
+  checkFdatRetry();
+  checkBridge();
+  checkBreakFrames();
+  checkBenchWindows();
+#if IIC_SERIAL_ENABLE_TRACE
+  checkTrace();
+#endif
+#if IIC_SERIAL_ENABLE_STATS
+  checkStats();
+#endif
+#if IIC_SERIAL_ENABLE_RTOS
+  checkRtos();
+#endif
+  printf("%s: %d failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+  return failures;
+}
@@ -0,0 +1,62 @@
+/*!
+ * @file SimClock.h
+ * @brief 主机端仿真时钟：所有仿真模型共享一个微秒级时间轴
+ * @n micros()/millis()/delay()以及I2C事务都会推进该时间轴，推进时按固定步长驱动已注册的模型，
+ * @n 并在模型改变中断引脚电平时调用attachInterrupt()注册的中断服务函数
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#ifndef __SIM_CLOCK_H
+#define __SIM_CLOCK_H
+
+#include <stdint.h>
+
+namespace sim{
+
+/**
+ * @brief 需要随时间推进的仿真模型
+ */
+class Ticker{
+public:
+  virtual ~Ticker(){}
+  /**
+   * @brief 将模型状态推进到nowUs时刻
+   */
+  virtual void tick(uint64_t nowUs) = 0;
+};
+
+/**
+ * @brief 当前仿真时间，单位微秒
+ */
+uint64_t now(void);
+
+/**
+ * @brief 推进仿真时间
+ * @param us 推进的微秒数
+ */
+void advance(uint64_t us);
+
+/**
+ * @brief 注册仿真模型
+ */
+void addTicker(Ticker *t);
+
+/**
+ * @brief 模型驱动的引脚电平，下降沿/上升沿会触发attachInterrupt()注册的函数
+ */
+void setPinLevel(uint8_t pin, uint8_t level);
+
+/**
+ * @brief 设置每次调用micros()/millis()消耗的仿真CPU时间(纳秒)，用于避免忙等循环卡死
+ */
+void setCallCost(uint32_t ns);
+
+/**
+ * @brief 清空模型、中断与时间，便于在同一进程中执行多组用例
+ */
+void reset(void);
+
+}
+
+#endif
@@ -0,0 +1,441 @@
+/*!
+ * @file WK2132Model.cpp
+ * @brief WK2132仿真模型的实现
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#include <math.h>
+#include "WK2132Model.h"
+
+/*寄存器地址与库中的定义保持一致*/
+#define M_GENA   0x00
+#define M_GRST   0x01
+#define M_SPAGE  0x03
+#define M_GIER   0x10
+#define M_GIFR   0x11
+#define M_SCR    0x04
+#define M_LCR    0x05
+#define M_FCR    0x06
+#define M_SIER   0x07
+#define M_SIFR   0x08
+#define M_TFCNT  0x09
+#define M_RFCNT  0x0A
+#define M_FSR    0x0B
+#define M_LSR    0x0C
+#define M_FDAT   0x0D
+#define M_BAUD1  0x04
+#define M_BAUD0  0x05
+#define M_PRES   0x06
+#define M_RFTL   0x07
+#define M_TFTL   0x08
+
+static double formatBits(uint8_t format){
+  //起始位 + 8位数据 + 校验位 + 停止位
+  return 1 + 8 + ((format & 0x08) ? 1 : 0) + ((format & 0x01) ? 2 : 1);
+}
+
+/* SimUartPort */
+SimUartPort::SimUartPort(double baud, uint8_t format)
+  :_peer(NULL), _baud(baud), _format(format), _errInject(0), _busyUntil(0){
+  sim::addTicker(this);
+}
+
+void SimUartPort::send(const uint8_t *pBuf, size_t size, uint32_t gapUs){
+  for(size_t i = 0; i < size; i++){
+    sPending_t p = {pBuf[i], _errInject, gapUs};
+    _errInject = 0;
+    _pending.push_back(p);
+  }
+}
+
+void SimUartPort::uartReceive(uint8_t data, uint8_t flags, double, uint8_t){
+  received.push_back(data);
+  receivedAt.push_back(sim::now());
+  receivedFlags.push_back(flags);
+}
+
+void SimUartPort::tick(uint64_t nowUs){
+  uint64_t charUs = (uint64_t)ceil(formatBits(_format) * 1000000.0 / _baud);
+  while(!_pending.empty()){
+    if(_busyUntil == 0){
+      _busyUntil = nowUs + charUs + _pending.front().gapUs;
+    }
+    if(nowUs < _busyUntil) return;
+    sPending_t p = _pending.front();
+    _pending.pop_front();
+    if(_peer) _peer->uartReceive(p.data, p.flags, _baud, _format);
+    _busyUntil = _pending.empty() ? 0 : (_busyUntil + charUs + _pending.front().gapUs);
+  }
+}
+
+/* WK2132Model::Channel */
+WK2132Model::Channel::Channel(): owner(NULL), index(0), peer(NULL){
+  reset();
+  memset(&stats, 0, sizeof(stats));
+}
+
+void WK2132Model::Channel::reset(void){
+  spage = 0;
+  scr = lcr = fcr = sier = 0;
+  baud1 = baud0 = pres = rftl = tftl = 0;
+  tx.clear();
+  rx.clear();
+  overflow = false;
+  rxTimeout = false;
+  lastRxUs = 0;
+  shifting = false;
+  shiftData = 0;
+  shiftDoneUs = 0;
+  breakOn = false;
+  breakStartUs = 0;
+}
+
+void WK2132Model::Channel::uartReceive(uint8_t data, uint8_t flags, double baud, uint8_t format){
+  if(!(owner->_gena & (1 << index)) || !(scr & 0x01)){
+    return;
+  }
+  double own = owner->actualBaud(index);
+  if(fabs(baud - own) / own > 0.025){
+    flags |= SIM_LSR_FE;
+  }
+  if(((format ^ lcr) & 0x08) || ((lcr & 0x08) && ((format ^ lcr) & 0x06))){
+    flags |= SIM_LSR_PE;
+  }
+  if(rx.size() >= SIM_FIFO_SIZE){
+    overflow = true;
+    stats.rxDropped++;
+    return;
+  }
+  rx.push_back((uint16_t)data | ((uint16_t)flags << 8));
+  stats.rxBytes++;
+  if(flags) stats.rxErrors++;
+  if(rx.size() > stats.rxMaxFill) stats.rxMaxFill = rx.size();
+  lastRxUs = sim::now();
+  rxTimeout = false;
+}
+
+/* WK2132Model */
+WK2132Model::WK2132Model(uint8_t addr, uint8_t irqPin, uint32_t fosc)
+  :_pre(addr << 3), _irqPin(irqPin), _fosc(fosc), _burst(true), _rxTimeoutChars(4), _irqLevel(false){
+  for(uint8_t i = 0; i < 2; i++){
+    _ch[i].owner = this;
+    _ch[i].index = i;
+  }
+  powerCycle();
+}
+
+void WK2132Model::attach(TwoWire &wire){
+  wire.attachDevice(this);
+  sim::addTicker(this);
+  updateIrq();
+}
+
+void WK2132Model::crossConnect(uint8_t channel1, WK2132Model &other, uint8_t channel2){
+  connect(channel1, other.rxPort(channel2));
+  other.connect(channel2, rxPort(channel1));
+}
+
+void WK2132Model::powerCycle(void){
+  _gena = 0;
+  _gier = 0;
+  _regPtr[0] = _regPtr[1] = 0;
+  _ch[0].reset();
+  _ch[1].reset();
+}
+
+void WK2132Model::resetStats(void){
+  memset(&_ch[0].stats, 0, sizeof(sChannelStats_t));
+  memset(&_ch[1].stats, 0, sizeof(sChannelStats_t));
+}
+
+void WK2132Model::injectRx(uint8_t channel, const uint8_t *pBuf, size_t size, uint8_t flags){
+  for(size_t i = 0; i < size; i++){
+    Channel &c = _ch[channel];
+    if(c.rx.size() >= SIM_FIFO_SIZE){
+      c.overflow = true;
+      c.stats.rxDropped++;
+      continue;
+    }
+    c.rx.push_back((uint16_t)pBuf[i] | ((uint16_t)flags << 8));
+    c.lastRxUs = sim::now();
+    c.rxTimeout = false;
+  }
+  updateIrq();
+}
+
+double WK2132Model::actualBaud(uint8_t channel){
+  Channel &c = _ch[channel];
+  double div = ((c.baud1 << 8) | c.baud0) + 1 + (c.pres & 0x0F) / 10.0;
+  return _fosc / (16.0 * div);
+}
+
+double WK2132Model::charTimeUs(uint8_t channel){
+  return formatBits(_ch[channel].lcr) * 1000000.0 / actualBaud(channel);
+}
+
+uint8_t WK2132Model::rxTrigger(uint8_t channel){
+  static const uint8_t table[4] = {8, 16, 24, 28};
+  Channel &c = _ch[channel];
+  return c.rftl ? c.rftl : table[(c.fcr >> 4) & 0x03];
+}
+
+uint8_t WK2132Model::txTrigger(uint8_t channel){
+  static const uint8_t table[4] = {8, 16, 24, 30};
+  Channel &c = _ch[channel];
+  return c.tftl ? c.tftl : table[(c.fcr >> 6) & 0x03];
+}
+
+uint8_t WK2132Model::sifr(uint8_t channel){
+  Channel &c = _ch[channel];
+  uint8_t val = 0;
+  if(c.rx.size() && c.rx.size() >= rxTrigger(channel)) val |= 0x01;
+  if(c.rxTimeout) val |= 0x02;
+  if(c.tx.size() <= txTrigger(channel)) val |= 0x04;
+  if(c.tx.empty()) val |= 0x08;
+  for(size_t i = 0; i < c.rx.size(); i++){
+    if(c.rx[i] >> 8){ val |= 0x80; break; }
+  }
+  return val & c.sier;
+}
+
+uint8_t WK2132Model::gifr(void){
+  uint8_t val = 0;
+  for(uint8_t i = 0; i < 2; i++){
+    if(sifr(i)) val |= (1 << i);
+  }
+  return val;
+}
+
+bool WK2132Model::irqAsserted(void){
+  return (gifr() & _gier) != 0;
+}
+
+void WK2132Model::updateIrq(void){
+  bool level = irqAsserted();
+  if(level != _irqLevel){
+    _irqLevel = level;
+    if(_irqPin != 255){
+      //IRQ低电平有效
+      sim::setPinLevel(_irqPin, level ? 0 : 1);
+    }
+  }
+}
+
+uint8_t WK2132Model::fsr(uint8_t channel){
+  Channel &c = _ch[channel];
+  uint8_t val = 0;
+  if(c.shifting || !c.tx.empty()) val |= 0x01;
+  if(c.tx.size() >= SIM_FIFO_SIZE) val |= 0x02;
+  if(!c.tx.empty()) val |= 0x04;
+  if(!c.rx.empty()) val |= 0x08;
+  for(size_t i = 0; i < c.rx.size(); i++){
+    uint8_t f = c.rx[i] >> 8;
+    if(f & SIM_LSR_PE) val |= 0x10;
+    if(f & SIM_LSR_FE) val |= 0x20;
+    if(f & SIM_LSR_BI) val |= 0x40;
+  }
+  if(c.overflow) val |= 0x80;
+  return val;
+}
+
+void WK2132Model::popRx(uint8_t channel, uint8_t *pData){
+  Channel &c = _ch[channel];
+  if(c.rx.empty()){
+    *pData = 0;
+    return;
+  }
+  *pData = (uint8_t)(c.rx.front() & 0xFF);
+  c.rx.pop_front();
+  c.rxTimeout = false;
+}
+
+uint8_t WK2132Model::globalReg(uint8_t reg){
+  return readRegister(0, reg);
+}
+
+uint8_t WK2132Model::reg(uint8_t channel, uint8_t page, uint8_t reg){
+  uint8_t old = _ch[channel].spage;
+  _ch[channel].spage = page;
+  uint8_t val = (reg == M_FDAT || reg == M_FSR) ? 0 : readRegister(channel, reg);
+  _ch[channel].spage = old;
+  return val;
+}
+
+uint8_t WK2132Model::readRegister(uint8_t channel, uint8_t reg){
+  Channel &c = _ch[channel];
+  switch(reg){
+    case M_GENA: return 0x80 | _gena;
+    case M_GRST: return 0x00;
+    case M_GIER: return _gier;
+    case M_GIFR: return gifr();
+    case M_SPAGE: return c.spage;
+    default: break;
+  }
+  if(c.spage & 0x01){
+    switch(reg){
+      case M_BAUD1: return c.baud1;
+      case M_BAUD0: return c.baud0;
+      case M_PRES:  return c.pres;
+      case M_RFTL:  return c.rftl;
+      case M_TFTL:  return c.tftl;
+      default: return 0;
+    }
+  }
+  switch(reg){
+    case M_SCR:  return c.scr;
+    case M_LCR:  return c.lcr;
+    case M_FCR:  return c.fcr;
+    case M_SIER: return c.sier;
+    case M_SIFR: return sifr(channel);
+    case M_TFCNT: return (uint8_t)c.tx.size();
+    case M_RFCNT: return (uint8_t)c.rx.size();
+    case M_FSR:{
+      uint8_t val = fsr(channel);
+      c.overflow = false;
+      return val;
+    }
+    case M_LSR:{
+      uint8_t val = c.rx.empty() ? 0 : (uint8_t)(c.rx.front() >> 8);
+      if(c.overflow) val |= SIM_LSR_OE;
+      return val;
+    }
+    case M_FDAT:{
+      uint8_t val;
+      popRx(channel, &val);
+      c.stats.fifoReads++;
+      return val;
+    }
+    default: return 0;
+  }
+}
+
+void WK2132Model::writeRegister(uint8_t channel, uint8_t reg, uint8_t val){
+  Channel &c = _ch[channel];
+  switch(reg){
+    case M_GENA: _gena = val & 0x03; return;
+    case M_GRST:
+      for(uint8_t i = 0; i < 2; i++){
+        if(val & (1 << i)) _ch[i].reset();
+      }
+      return;
+    case M_GIER: _gier = val & 0x03; return;
+    case M_GIFR: return;
+    case M_SPAGE:
+      c.spage = val & 0x01;
+      c.stats.pageWrites++;
+      return;
+    default: break;
+  }
+  if(c.spage & 0x01){
+    switch(reg){
+      case M_BAUD1: c.baud1 = val; break;
+      case M_BAUD0: c.baud0 = val; break;
+      case M_PRES:  c.pres = val & 0x0F; break;
+      case M_RFTL:  c.rftl = val; break;
+      case M_TFTL:  c.tftl = val; break;
+      default: break;
+    }
+    return;
+  }
+  switch(reg){
+    case M_SCR: c.scr = val & 0x07; break;
+    case M_LCR:{
+      bool breakOn = (val & 0x20) != 0;
+      if(breakOn && !c.breakOn){
+        c.breakOn = true;
+        c.breakStartUs = sim::now();
+      }else if(!breakOn && c.breakOn){
+        c.breakOn = false;
+        if(c.peer && (sim::now() - c.breakStartUs) >= charTimeUs(channel)){
+          c.peer->uartReceive(0x00, SIM_LSR_BI | SIM_LSR_FE, actualBaud(channel), c.lcr);
+          c.stats.breaks++;
+        }
+      }
+      c.lcr = val & 0x3F;
+      break;
+    }
+    case M_FCR:
+      if(val & 0x01){ c.rx.clear(); c.overflow = false; c.rxTimeout = false; }
+      if(val & 0x02){ c.tx.clear(); }
+      c.fcr = val & 0xFC;
+      break;
+    case M_SIER: c.sier = val & 0x8F; break;
+    case M_FDAT:
+      if(c.tx.size() < SIM_FIFO_SIZE) c.tx.push_back(val);
+      c.stats.fifoWrites++;
+      break;
+    default: break;
+  }
+}
+
+bool WK2132Model::i2cMatch(uint8_t addr){
+  return ((addr & 0xF8) == _pre) && (((addr >> 1) & 0x03) < 2);
+}
+
+uint8_t WK2132Model::i2cWrite(uint8_t addr, const uint8_t *pBuf, size_t size){
+  uint8_t channel = (addr >> 1) & 0x03;
+  Channel &c = _ch[channel];
+  if(addr & 0x01){
+    for(size_t i = 0; i < size; i++){
+      if(c.tx.size() < SIM_FIFO_SIZE) c.tx.push_back(pBuf[i]);
+      c.stats.fifoWrites++;
+    }
+    updateIrq();
+    return 0;
+  }
+  if(size == 0) return 0;
+  uint8_t reg = pBuf[0];
+  _regPtr[channel] = reg;
+  for(size_t i = 1; i < size; i++){
+    writeRegister(channel, reg, pBuf[i]);
+    c.stats.regWrites++;
+    if(_burst && reg != M_FDAT) reg++;
+  }
+  updateIrq();
+  return 0;
+}
+
+size_t WK2132Model::i2cRead(uint8_t addr, uint8_t *pBuf, size_t size){
+  uint8_t channel = (addr >> 1) & 0x03;
+  Channel &c = _ch[channel];
+  if(addr & 0x01){
+    for(size_t i = 0; i < size; i++){
+      popRx(channel, &pBuf[i]);
+      c.stats.fifoReads++;
+    }
+    updateIrq();
+    return size;
+  }
+  uint8_t reg = _regPtr[channel];
+  for(size_t i = 0; i < size; i++){
+    pBuf[i] = readRegister(channel, reg);
+    c.stats.regReads++;
+    if(_burst && reg != M_FDAT) reg++;
+  }
+  updateIrq();
+  return size;
+}
+
+void WK2132Model::tick(uint64_t nowUs){
+  for(uint8_t i = 0; i < 2; i++){
+    Channel &c = _ch[i];
+    if(!(_gena & (1 << i))) continue;
+    double charUs = charTimeUs(i);
+    if(c.shifting && nowUs >= c.shiftDoneUs){
+      c.shifting = false;
+      c.stats.txBytes++;
+      if(c.peer) c.peer->uartReceive(c.shiftData, 0, actualBaud(i), c.lcr);
+    }
+    if(!c.shifting && !c.breakOn && (c.scr & 0x02) && !c.tx.empty()){
+      c.shiftData = c.tx.front();
+      c.tx.pop_front();
+      c.shifting = true;
+      c.shiftDoneUs = nowUs + (uint64_t)ceil(charUs);
+    }
+    if(!c.rx.empty() && !c.rxTimeout && (nowUs - c.lastRxUs) >= (uint64_t)(charUs * _rxTimeoutChars)){
+      c.rxTimeout = true;
+    }
+  }
+  updateIrq();
+}
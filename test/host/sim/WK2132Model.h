@@ -0,0 +1,205 @@
+/*!
+ * @file WK2132Model.h
+ * @brief WK2132 I2C转双串口芯片的主机端寄存器级仿真模型
+ * @n 模型包含：全局寄存器(GENA/GRST/GIER/GIFR)、每通道的两页寄存器、256字节收发FIFO、
+ * @n FSR/LSR/SIFR标志、接收超时、Line-Break、按波特率推进的收发时序以及IRQ引脚输出
+ * @n 子串口的TX可以接到任意SimUartPeer上：自身RX(回环)、另一个通道或主机端SimUartPort
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#ifndef __WK2132_MODEL_H
+#define __WK2132_MODEL_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <Wire.h>
+#include "SimClock.h"
+
+#define SIM_FOSC              11059200UL
+#define SIM_FIFO_SIZE         256
+#define SIM_LSR_PE            0x01
+#define SIM_LSR_FE            0x02
+#define SIM_LSR_BI            0x04
+#define SIM_LSR_OE            0x08
+
+/**
+ * @brief 串口线路的接收端
+ */
+class SimUartPeer{
+public:
+  virtual ~SimUartPeer(){}
+  /**
+   * @brief 收到一个字符
+   * @param data 数据
+   * @param flags 线路上产生的错误(SIM_LSR_PE/SIM_LSR_FE/SIM_LSR_BI)
+   * @param baud 发送端的实际波特率
+   * @param format 发送端LCR中的数据格式(PAEN/PAM/STPL)
+   */
+  virtual void uartReceive(uint8_t data, uint8_t flags, double baud, uint8_t format) = 0;
+};
+
+/**
+ * @brief 主机端的串口设备，可按设定波特率向子串口发送数据，并记录子串口发来的数据
+ */
+class SimUartPort : public SimUartPeer, public sim::Ticker{
+public:
+  SimUartPort(double baud = 115200, uint8_t format = 0);
+  void connect(SimUartPeer *peer){ _peer = peer; }
+  void setBaud(double baud){ _baud = baud; }
+  /**
+   * @brief 以线速发送数据，gapUs为字符之间额外的空闲时间
+   */
+  void send(const uint8_t *pBuf, size_t size, uint32_t gapUs = 0);
+  /**
+   * @brief 下一个发出的字符带上指定的错误标志
+   */
+  void injectError(uint8_t flags){ _errInject = flags; }
+  /**
+   * @brief 立即丢弃尚未发出的数据
+   */
+  void clearPending(void){ _pending.clear(); }
+  size_t pending(void){ return _pending.size(); }
+  virtual void uartReceive(uint8_t data, uint8_t flags, double baud, uint8_t format);
+  virtual void tick(uint64_t nowUs);
+
+  std::vector<uint8_t> received;
+  std::vector<uint64_t> receivedAt;
+  std::vector<uint8_t> receivedFlags;
+
+private:
+  typedef struct{
+    uint8_t data;
+    uint8_t flags;
+    uint32_t gapUs;
+  } sPending_t;
+  SimUartPeer *_peer;
+  double _baud;
+  uint8_t _format;
+  uint8_t _errInject;
+  uint64_t _busyUntil;
+  std::deque<sPending_t> _pending;
+};
+
+class WK2132Model : public SimI2CDevice, public sim::Ticker{
+public:
+  /**
+   * @brief 单个子串口的仿真统计
+   */
+  typedef struct{
+    uint32_t txBytes;       /*!< 线路上发出的字节 */
+    uint32_t rxBytes;       /*!< 线路上收到并进入FIFO的字节 */
+    uint32_t rxDropped;     /*!< 因FIFO满丢弃的字节 */
+    uint32_t rxErrors;      /*!< 带错误标志的字节 */
+    uint16_t rxMaxFill;     /*!< 接收FIFO的最高水位 */
+    uint32_t pageWrites;    /*!< SPAGE寄存器的写次数 */
+    uint32_t regReads;      /*!< 寄存器读访问次数(按字节) */
+    uint32_t regWrites;     /*!< 寄存器写访问次数(按字节) */
+    uint32_t fifoReads;     /*!< 通过FIFO地址读出的字节 */
+    uint32_t fifoWrites;    /*!< 通过FIFO地址写入的字节 */
+    uint32_t breaks;        /*!< 发出的Line-Break次数 */
+  } sChannelStats_t;
+
+  /**
+   * @brief 构造函数
+   * @param addr 与DFRobot_IIC_Serial构造函数相同的地址(0x02/0x06/0x0A/0x0E)
+   * @param irqPin IRQ输出所接的主机引脚，255表示不接
+   */
+  WK2132Model(uint8_t addr = 0x0E, uint8_t irqPin = 255, uint32_t fosc = SIM_FOSC);
+
+  /**
+   * @brief 挂到总线并注册到仿真时钟
+   */
+  void attach(TwoWire &wire);
+  /**
+   * @brief 将通道的TX接到指定接收端，peer为NULL表示悬空
+   */
+  void connect(uint8_t channel, SimUartPeer *peer){ _ch[channel].peer = peer; }
+  /**
+   * @brief 通道自身TX接RX
+   */
+  void loopback(uint8_t channel){ connect(channel, &_ch[channel]); }
+  /**
+   * @brief 两个通道互连(channel1 TX->channel2 RX，channel2 TX->channel1 RX)
+   */
+  void crossConnect(uint8_t channel1, WK2132Model &other, uint8_t channel2);
+  SimUartPeer *rxPort(uint8_t channel){ return &_ch[channel]; }
+  /**
+   * @brief 是否支持寄存器地址自动递增的连续读写
+   */
+  void setBurstSupported(bool en){ _burst = en; }
+  /**
+   * @brief 设置接收超时对应的字符时间个数
+   */
+  void setRxTimeoutChars(uint8_t chars){ _rxTimeoutChars = chars; }
+  /**
+   * @brief 给通道接收FIFO直接灌入数据(不占线路时间)
+   */
+  void injectRx(uint8_t channel, const uint8_t *pBuf, size_t size, uint8_t flags = 0);
+  /**
+   * @brief 模拟芯片断电/复位，所有寄存器恢复默认值
+   */
+  void powerCycle(void);
+
+  bool irqAsserted(void);
+  uint8_t reg(uint8_t channel, uint8_t page, uint8_t reg);
+  uint8_t globalReg(uint8_t reg);
+  double actualBaud(uint8_t channel);
+  size_t rxCount(uint8_t channel){ return _ch[channel].rx.size(); }
+  size_t txCount(uint8_t channel){ return _ch[channel].tx.size(); }
+  sChannelStats_t &stats(uint8_t channel){ return _ch[channel].stats; }
+  void resetStats(void);
+
+  virtual bool i2cMatch(uint8_t addr);
+  virtual uint8_t i2cWrite(uint8_t addr, const uint8_t *pBuf, size_t size);
+  virtual size_t i2cRead(uint8_t addr, uint8_t *pBuf, size_t size);
+  virtual void tick(uint64_t nowUs);
+
+private:
+  class Channel : public SimUartPeer{
+  public:
+    Channel();
+    virtual void uartReceive(uint8_t data, uint8_t flags, double baud, uint8_t format);
+    void reset(void);
+    WK2132Model *owner;
+    uint8_t index;
+    uint8_t spage;
+    uint8_t scr, lcr, fcr, sier;
+    uint8_t baud1, baud0, pres, rftl, tftl;
+    std::deque<uint8_t> tx;
+    std::deque<uint16_t> rx;   /*!< 低8位为数据，高8位为LSR错误标志 */
+    bool overflow;
+    bool rxTimeout;
+    uint64_t lastRxUs;
+    bool shifting;
+    uint8_t shiftData;
+    uint64_t shiftDoneUs;
+    bool breakOn;
+    uint64_t breakStartUs;
+    SimUartPeer *peer;
+    sChannelStats_t stats;
+  };
+  uint8_t readRegister(uint8_t channel, uint8_t reg);
+  void writeRegister(uint8_t channel, uint8_t reg, uint8_t val);
+  uint8_t sifr(uint8_t channel);
+  uint8_t gifr(void);
+  uint8_t rxTrigger(uint8_t channel);
+  uint8_t txTrigger(uint8_t channel);
+  double charTimeUs(uint8_t channel);
+  uint8_t fsr(uint8_t channel);
+  void popRx(uint8_t channel, uint8_t *pData);
+  void updateIrq(void);
+
+  Channel _ch[2];
+  uint8_t _pre;
+  uint8_t _irqPin;
+  uint32_t _fosc;
+  uint8_t _gena, _gier;
+  uint8_t _regPtr[2];
+  bool _burst;
+  uint8_t _rxTimeoutChars;
+  bool _irqLevel;
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*!
+ * @file sketch_runner.cpp
+ * @brief 在主机上运行examples中的示例：两个子串口各自TX接RX回环，芯片IRQ接2号引脚
+ * @n 示例文件由编译选项SKETCH指定，运行时间由第一个命令行参数指定(仿真毫秒，默认3000)
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#include <Arduino.h>
+#include <stdio.h>
+#include "WK2132Model.h"
+
+static WK2132Model chip(0x0E, 2);
+
+#include SKETCH
+
+int main(int argc, char **argv){
+  sim::reset();
+  chip.attach(Wire);
+  chip.loopback(0);
+  chip.loopback(1);
+  unsigned long runMs = (argc > 1) ? strtoul(argv[1], NULL, 0) : 3000;
+  setup();
+  unsigned long start = millis();
+  while(millis() - start < runMs){
+    loop();
+  }
+  fflush(stdout);
+  return 0;
+}
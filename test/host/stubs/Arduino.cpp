@@ -0,0 +1,368 @@
+/*!
+ * @file Arduino.cpp
+ * @brief 主机端仿真用Arduino核心桩的实现：时间、GPIO中断、Print/Stream、TwoWire
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#include <stdio.h>
+#include <mutex>
+#include "Arduino.h"
+#include "Wire.h"
+#include "../sim/SimClock.h"
+
+#define SIM_STEP_US      5
+#define SIM_MAX_TICKERS  16
+#define SIM_MAX_PINS     64
+
+static uint64_t _nowUs = 0;
+static uint64_t _nowNs = 0;
+static uint32_t _callCostNs = 200;
+static sim::Ticker *_tickers[SIM_MAX_TICKERS];
+static uint8_t _tickerNum = 0;
+static uint8_t _pinLevel[SIM_MAX_PINS];
+static void (*_isr[SIM_MAX_PINS])(void);
+static int _isrMode[SIM_MAX_PINS];
+static bool _irqEnabled = true;
+static uint8_t _irqPending[SIM_MAX_PINS];
+static bool _inAdvance = false;
+//RTOS模式的测试在多个线程中调用库函数，仿真时间和模型状态的修改用一把递归锁串行化
+static std::recursive_mutex _simLock;
+
+namespace sim{
+
+uint64_t now(void){
+  return _nowUs;
+}
+
+static void dispatchIrq(void){
+  if(!_irqEnabled) return;
+  for(uint8_t pin = 0; pin < SIM_MAX_PINS; pin++){
+    if(_irqPending[pin] && _isr[pin]){
+      _irqPending[pin] = 0;
+      _isr[pin]();
+    }
+  }
+}
+
+void advance(uint64_t us){
+  std::lock_guard<std::recursive_mutex> guard(_simLock);
+  if(_inAdvance){
+    _nowUs += us;
+    return;
+  }
+  _inAdvance = true;
+  uint64_t target = _nowUs + us;
+  while(_nowUs < target){
+    uint64_t step = target - _nowUs;
+    if(step > SIM_STEP_US) step = SIM_STEP_US;
+    _nowUs += step;
+    for(uint8_t i = 0; i < _tickerNum; i++){
+      _tickers[i]->tick(_nowUs);
+    }
+  }
+  _nowNs = _nowUs * 1000;
+  _inAdvance = false;
+  dispatchIrq();
+}
+
+void addTicker(Ticker *t){
+  if(_tickerNum < SIM_MAX_TICKERS) _tickers[_tickerNum++] = t;
+}
+
+void setPinLevel(uint8_t pin, uint8_t level){
+  if(pin >= SIM_MAX_PINS) return;
+  uint8_t old = _pinLevel[pin];
+  _pinLevel[pin] = level ? 1 : 0;
+  if(old == _pinLevel[pin]) return;
+  int mode = _isrMode[pin];
+  if((mode == CHANGE) || (mode == FALLING && old && !level) || (mode == RISING && !old && level)){
+    _irqPending[pin] = 1;
+  }
+}
+
+void setCallCost(uint32_t ns){
+  _callCostNs = ns;
+}
+
+void reset(void){
+  _nowUs = 0;
+  _nowNs = 0;
+  _tickerNum = 0;
+  memset(_isr, 0, sizeof(_isr));
+  memset(_irqPending, 0, sizeof(_irqPending));
+  memset(_pinLevel, 1, sizeof(_pinLevel));
+}
+
+}
+
+static void spendCpu(void){
+  _nowNs += _callCostNs;
+  if(_nowNs >= (_nowUs + 1) * 1000){
+    sim::advance(_nowNs / 1000 - _nowUs);
+  }
+}
+
+unsigned long micros(void){
+  std::lock_guard<std::recursive_mutex> guard(_simLock);
+  spendCpu();
+  return (unsigned long)_nowUs;
+}
+
+unsigned long millis(void){
+  std::lock_guard<std::recursive_mutex> guard(_simLock);
+  spendCpu();
+  return (unsigned long)(_nowUs / 1000);
+}
+
+void delay(unsigned long ms){
+  sim::advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us){
+  sim::advance(us);
+}
+
+void yield(void){
+  sim::advance(1);
+}
+
+void pinMode(uint8_t, uint8_t){}
+void digitalWrite(uint8_t, uint8_t){}
+int digitalRead(uint8_t pin){
+  return (pin < SIM_MAX_PINS) ? _pinLevel[pin] : LOW;
+}
+int digitalPinToInterrupt(int pin){
+  return pin;
+}
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode){
+  if(interruptNum >= SIM_MAX_PINS) return;
+  _isr[interruptNum] = userFunc;
+  _isrMode[interruptNum] = mode;
+  _irqPending[interruptNum] = 0;
+}
+void detachInterrupt(uint8_t interruptNum){
+  if(interruptNum < SIM_MAX_PINS) _isr[interruptNum] = NULL;
+}
+void noInterrupts(void){
+  _irqEnabled = false;
+}
+void interrupts(void){
+  _irqEnabled = true;
+  sim::dispatchIrq();
+}
+
+/* Print */
+size_t Print::printNumber(unsigned long n, uint8_t base){
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if(base < 2) base = 10;
+  do{
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  }while(n);
+  return write(str);
+}
+
+size_t Print::print(double n, int digits){
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return write(buf);
+}
+
+/* Stream */
+int Stream::timedRead(){
+  int c;
+  _startMillis = millis();
+  do{
+    c = read();
+    if(c >= 0) return c;
+  }while(millis() - _startMillis < _timeout);
+  return -1;
+}
+
+int Stream::timedPeek(){
+  int c;
+  _startMillis = millis();
+  do{
+    c = peek();
+    if(c >= 0) return c;
+  }while(millis() - _startMillis < _timeout);
+  return -1;
+}
+
+int Stream::peekNextDigit(){
+  int c;
+  while(1){
+    c = timedPeek();
+    if(c < 0 || c == '-' || (c >= '0' && c <= '9')) return c;
+    read();
+  }
+}
+
+bool Stream::find(const char *target){
+  return find(target, strlen(target));
+}
+
+bool Stream::find(const char *target, size_t length){
+  size_t index = 0;
+  int c;
+  if(length == 0) return true;
+  while((c = timedRead()) > 0){
+    if(c == target[index]){
+      if(++index >= length) return true;
+    }else{
+      index = (c == target[0]) ? 1 : 0;
+    }
+  }
+  return false;
+}
+
+long Stream::parseInt(){
+  bool isNegative = false;
+  long value = 0;
+  int c = peekNextDigit();
+  if(c < 0) return 0;
+  do{
+    if(c == '-') isNegative = true;
+    else if(c >= '0' && c <= '9') value = value * 10 + c - '0';
+    read();
+    c = timedPeek();
+  }while((c >= '0' && c <= '9'));
+  return isNegative ? -value : value;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length){
+  size_t count = 0;
+  while(count < length){
+    int c = timedRead();
+    if(c < 0) break;
+    *buffer++ = (char)c;
+    count++;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length){
+  size_t index = 0;
+  while(index < length){
+    int c = timedRead();
+    if(c < 0 || c == terminator) break;
+    *buffer++ = (char)c;
+    index++;
+  }
+  return index;
+}
+
+/* Serial */
+size_t HardwareSerial::write(uint8_t c){
+  fputc(c, stdout);
+  return 1;
+}
+HardwareSerial Serial;
+
+/* TwoWire */
+TwoWire::TwoWire(): _devNum(0), _clock(100000), _txAddr(0), _txLen(0), _rxLen(0), _rxIndex(0), _nackSkip(0), _nackInject(0), _dataNackInject(0){
+  memset(_dev, 0, sizeof(_dev));
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void TwoWire::attachDevice(SimI2CDevice *dev){
+  if(_devNum < WIRE_SIM_MAX_DEVICES) _dev[_devNum++] = dev;
+}
+
+SimI2CDevice *TwoWire::findDevice(uint8_t addr){
+  for(uint8_t i = 0; i < _devNum; i++){
+    if(_dev[i]->i2cMatch(addr)) return _dev[i];
+  }
+  return NULL;
+}
+
+void TwoWire::consume(size_t bytes){
+  //START + 地址字节 + 数据字节(每字节9个时钟) + STOP
+  uint64_t bits = 9 * (bytes + 1) + 2;
+  uint64_t us = (bits * 1000000ULL + _clock - 1) / _clock;
+  _stats.busMicros += us;
+  sim::advance(us);
+}
+
+void TwoWire::beginTransmission(uint8_t addr){
+  _txAddr = addr;
+  _txLen = 0;
+}
+
+size_t TwoWire::write(uint8_t data){
+  if(_txLen >= BUFFER_LENGTH){
+    setWriteError();
+    return 0;
+  }
+  _txBuf[_txLen++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity){
+  for(size_t i = 0; i < quantity; i++){
+    if(!write(data[i])) return i;
+  }
+  return quantity;
+}
+
+bool TwoWire::nackNow(void){
+  if(_nackSkip){
+    _nackSkip--;
+    return false;
+  }
+  if(_nackInject){
+    _nackInject--;
+    return true;
+  }
+  return false;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t){
+  std::lock_guard<std::recursive_mutex> guard(_simLock);
+  _stats.writes++;
+  SimI2CDevice *dev = findDevice(_txAddr);
+  uint8_t ret = 2;
+  if(nackNow()){
+    consume(0);
+  }else if(dev){
+    consume(_txLen);
+    ret = dev->i2cWrite(_txAddr, _txBuf, _txLen);
+    if(ret == 0 && _dataNackInject){
+      _dataNackInject--;
+      ret = 3;
+    }
+  }else{
+    consume(0);
+  }
+  if(ret == 0){
+    _stats.bytesOut += _txLen;
+  }else{
+    _stats.nacks++;
+  }
+  _txLen = 0;
+  return ret;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t quantity, uint8_t){
+  std::lock_guard<std::recursive_mutex> guard(_simLock);
+  _stats.reads++;
+  if(quantity > BUFFER_LENGTH) quantity = BUFFER_LENGTH;
+  _rxIndex = 0;
+  _rxLen = 0;
+  SimI2CDevice *dev = findDevice(addr);
+  if(nackNow() || !dev){
+    _stats.nacks++;
+    consume(0);
+    return 0;
+  }
+  consume(quantity);
+  _rxLen = (uint8_t)dev->i2cRead(addr, _rxBuf, quantity);
+  _stats.bytesIn += _rxLen;
+  return _rxLen;
+}
+
+TwoWire Wire;
@@ -0,0 +1,63 @@
+/*!
+ * @file Arduino.h
+ * @brief 主机端仿真用的Arduino核心最小桩，仅提供本库用到的接口
+ * @n 时间由仿真时钟驱动，delay/delayMicroseconds会推进仿真时间并驱动WK2132模型
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#ifndef __HOST_ARDUINO_H
+#define __HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define ARDUINO 10809
+#define ARDUINO_ARCH_HOST
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define HEX 16
+#define DEC 10
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int digitalPinToInterrupt(int pin);
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+void noInterrupts(void);
+void interrupts(void);
+
+#include "Stream.h"
+
+class HardwareSerial : public Stream{
+public:
+  void begin(unsigned long){}
+  virtual int available(void){ return 0; }
+  virtual int peek(void){ return -1; }
+  virtual int read(void){ return -1; }
+  virtual size_t write(uint8_t c);
+  using Print::write;
+};
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,31 @@
+/*!
+ * @file FreeRTOS.cpp
+ * @brief 主机端仿真用FreeRTOS桩的实现
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#include <chrono>
+#include <mutex>
+#include "semphr.h"
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void){
+  return new std::recursive_timed_mutex();
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks){
+  std::recursive_timed_mutex *m = (std::recursive_timed_mutex *)mutex;
+  if(ticks == portMAX_DELAY){
+    m->lock();
+    return pdTRUE;
+  }
+  if(ticks == 0){
+    return m->try_lock() ? pdTRUE : pdFALSE;
+  }
+  return m->try_lock_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex){
+  ((std::recursive_timed_mutex *)mutex)->unlock();
+  return pdTRUE;
+}
@@ -0,0 +1,23 @@
+/*!
+ * @file FreeRTOS.h
+ * @brief 主机端仿真用的FreeRTOS最小桩，只提供本库RTOS模式用到的递归互斥锁
+ * @n 互斥锁由std::recursive_timed_mutex实现，任务由测试用std::thread代替，1个tick为1ms
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#ifndef __HOST_FREERTOS_H
+#define __HOST_FREERTOS_H
+
+#include <stdint.h>
+
+typedef int32_t BaseType_t;
+typedef uint32_t TickType_t;
+typedef void *SemaphoreHandle_t;
+
+#define pdTRUE             ((BaseType_t)1)
+#define pdFALSE            ((BaseType_t)0)
+#define portMAX_DELAY      ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1)
+
+#endif
@@ -0,0 +1,58 @@
+/*!
+ * @file Print.h
+ * @brief 主机端仿真用的Print类，接口与Arduino AVR核心保持一致
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#ifndef __HOST_PRINT_H
+#define __HOST_PRINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class Print{
+public:
+  Print(): _writeError(0){}
+  virtual ~Print(){}
+  virtual size_t write(uint8_t) = 0;
+  size_t write(const char *str){
+    if(str == NULL) return 0;
+    return write((const uint8_t *)str, strlen(str));
+  }
+  virtual size_t write(const uint8_t *buffer, size_t size){
+    size_t n = 0;
+    while(size--){
+      if(write(*buffer++)) n++;
+      else break;
+    }
+    return n;
+  }
+  size_t write(const char *buffer, size_t size){ return write((const uint8_t *)buffer, size); }
+  virtual int availableForWrite(){ return 0; }
+  virtual void flush(){}
+
+  size_t print(const char *s){ return write(s); }
+  size_t print(char c){ return write((uint8_t)c); }
+  size_t print(unsigned long n, int base = 10){ return printNumber(n, base); }
+  size_t print(long n, int base = 10){
+    if(n < 0 && base == 10){ size_t t = print('-'); return t + printNumber((unsigned long)(-n), 10); }
+    return printNumber((unsigned long)n, base);
+  }
+  size_t print(unsigned int n, int base = 10){ return print((unsigned long)n, base); }
+  size_t print(int n, int base = 10){ return print((long)n, base); }
+  size_t print(unsigned char n, int base = 10){ return print((unsigned long)n, base); }
+  size_t print(double n, int digits = 2);
+  size_t println(void){ return write("\r\n"); }
+  template<typename T> size_t println(T v){ size_t n = print(v); return n + println(); }
+  template<typename T> size_t println(T v, int f){ size_t n = print(v, f); return n + println(); }
+
+protected:
+  void setWriteError(int err = 1){ _writeError = err; }
+private:
+  size_t printNumber(unsigned long n, uint8_t base);
+  int _writeError;
+};
+
+#endif
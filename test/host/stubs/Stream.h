@@ -0,0 +1,37 @@
+/*!
+ * @file Stream.h
+ * @brief 主机端仿真用的Stream类，接口与Arduino AVR核心保持一致
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#ifndef __HOST_STREAM_H
+#define __HOST_STREAM_H
+
+#include "Print.h"
+
+class Stream : public Print{
+public:
+  Stream(): _timeout(1000), _startMillis(0){}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout){ _timeout = timeout; }
+  unsigned long getTimeout(void){ return _timeout; }
+  bool find(const char *target);
+  bool find(const char *target, size_t length);
+  long parseInt();
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length){ return readBytes((char *)buffer, length); }
+  size_t readBytesUntil(char terminator, char *buffer, size_t length);
+
+protected:
+  int timedRead();
+  int timedPeek();
+  int peekNextDigit();
+  unsigned long _timeout;
+  unsigned long _startMillis;
+};
+
+#endif
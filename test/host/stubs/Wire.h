@@ -0,0 +1,116 @@
+/*!
+ * @file Wire.h
+ * @brief 主机端仿真用的TwoWire类，接口与Arduino AVR核心保持一致
+ * @n 事务不走真实总线，而是转发给挂在总线上的仿真从设备(SimI2CDevice)，
+ * @n 并按setClock()设置的时钟速率推进仿真时间，同时统计事务数与字节数
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#ifndef __HOST_WIRE_H
+#define __HOST_WIRE_H
+
+#include <stdint.h>
+#include "Stream.h"
+
+#define BUFFER_LENGTH 32
+#define WIRE_SIM_MAX_DEVICES 8
+
+/**
+ * @brief 仿真I2C从设备接口
+ */
+class SimI2CDevice{
+public:
+  virtual ~SimI2CDevice(){}
+  /**
+   * @brief 判断7位地址是否属于本设备
+   */
+  virtual bool i2cMatch(uint8_t addr) = 0;
+  /**
+   * @brief 主机写事务
+   * @return 0表示ACK，其他值与endTransmission()返回值含义一致
+   */
+  virtual uint8_t i2cWrite(uint8_t addr, const uint8_t *pBuf, size_t size) = 0;
+  /**
+   * @brief 主机读事务
+   * @return 返回实际提供的字节数
+   */
+  virtual size_t i2cRead(uint8_t addr, uint8_t *pBuf, size_t size) = 0;
+};
+
+class TwoWire : public Stream{
+public:
+  typedef struct{
+    uint32_t writes;    /*!< 写事务数(endTransmission次数) */
+    uint32_t reads;     /*!< 读事务数(requestFrom次数) */
+    uint32_t bytesOut;  /*!< 主机发出的字节数(不含地址) */
+    uint32_t bytesIn;   /*!< 主机读到的字节数 */
+    uint32_t nacks;     /*!< 收到NACK的事务数 */
+    uint64_t busMicros; /*!< 总线占用时间 */
+  } sBusStats_t;
+
+  TwoWire();
+  void begin(){}
+  void end(){}
+  void setClock(uint32_t clock){ _clock = clock; }
+  uint32_t getClock(void){ return _clock; }
+  void beginTransmission(uint8_t addr);
+  void beginTransmission(int addr){ beginTransmission((uint8_t)addr); }
+  uint8_t endTransmission(void){ return endTransmission((uint8_t)true); }
+  uint8_t endTransmission(uint8_t sendStop);
+  uint8_t requestFrom(uint8_t addr, uint8_t quantity){ return requestFrom(addr, quantity, (uint8_t)true); }
+  uint8_t requestFrom(uint8_t addr, uint8_t quantity, uint8_t sendStop);
+  uint8_t requestFrom(int addr, int quantity){ return requestFrom((uint8_t)addr, (uint8_t)quantity); }
+  virtual size_t write(uint8_t data);
+  virtual size_t write(const uint8_t *data, size_t quantity);
+  virtual int available(void){ return _rxLen - _rxIndex; }
+  virtual int read(void){ return (_rxIndex < _rxLen) ? _rxBuf[_rxIndex++] : -1; }
+  virtual int peek(void){ return (_rxIndex < _rxLen) ? _rxBuf[_rxIndex] : -1; }
+  virtual void flush(void){}
+  using Print::write;
+
+  /**
+   * @brief 将仿真从设备挂到本总线上
+   */
+  void attachDevice(SimI2CDevice *dev);
+  /**
+   * @brief 注入NACK，接下来的count个事务返回NACK(endTransmission返回2，requestFrom返回0)
+   */
+  void injectNack(uint16_t count){ _nackSkip = 0; _nackInject = count; }
+  /**
+   * @brief 注入NACK，先正常完成skip个事务，再让之后的count个事务返回NACK
+   */
+  void injectNack(uint16_t skip, uint16_t count){ _nackSkip = skip; _nackInject = count; }
+  /**
+   * @brief 注入数据NACK，接下来的count个写事务由从设备正常接收，但endTransmission返回3
+   */
+  void injectDataNack(uint16_t count){ _dataNackInject = count; }
+  /**
+   * @brief 移除所有仿真从设备并清空统计，便于在同一进程中执行多组用例
+   */
+  void detachAllDevices(void){ _devNum = 0; _nackSkip = 0; _nackInject = 0; _dataNackInject = 0; resetStats(); }
+  const sBusStats_t &stats(void){ return _stats; }
+  void resetStats(void){ memset(&_stats, 0, sizeof(_stats)); }
+
+private:
+  SimI2CDevice *findDevice(uint8_t addr);
+  bool nackNow(void);
+  void consume(size_t bytes);
+  SimI2CDevice *_dev[WIRE_SIM_MAX_DEVICES];
+  uint8_t _devNum;
+  uint32_t _clock;
+  uint8_t _txAddr;
+  uint8_t _txBuf[BUFFER_LENGTH];
+  uint8_t _txLen;
+  uint8_t _rxBuf[BUFFER_LENGTH];
+  uint8_t _rxLen;
+  uint8_t _rxIndex;
+  uint16_t _nackSkip;
+  uint16_t _nackInject;
+  uint16_t _dataNackInject;
+  sBusStats_t _stats;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,21 @@
+/*!
+ * @file semphr.h
+ * @brief 主机端仿真用的FreeRTOS信号量桩，只提供递归互斥锁
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#ifndef __HOST_SEMPHR_H
+#define __HOST_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+/**
+ * @brief 获取递归互斥锁，ticks为0时只尝试一次，portMAX_DELAY时一直等待
+ * @return 成功返回pdTRUE，超时返回pdFALSE
+ */
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+
+#endif
@@ -0,0 +1,301 @@
+/*!
+ * @file trace_tool.cpp
+ * @brief 分析DFRobot_WK2132::dumpTrace()导出的总线跟踪记录，并可回放到WK2132仿真模型中
+ * @n 用法：wk2132_trace [--replay] [--loopback] 跟踪文件
+ * @n 跟踪文件为dumpTrace()的二进制输出，或从串口监视器复制的十六进制文本(dumpTrace(Serial, true))
+ * @n 输出按操作(通道、寄存器、方向)统计的事务数、字节数和失败数，SPAGE切换次数和冗余切换，相邻事务的时间间隔分布；
+ * @n --replay按记录的时间间隔把事务依次发给仿真模型，比较读到的第一个字节，--loopback使回放时两个子串口TX接RX
+ * @n 返回值：0正常，1文件格式错误
+ *
+ * @copyright   Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @licence     The MIT License (MIT)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <Arduino.h>
+#include <DFRobot_WK2132.h>
+#include "WK2132Model.h"
+
+typedef struct{
+  uint32_t us;
+  uint8_t addr;
+  uint8_t reg;
+  uint8_t flags;
+  uint8_t len;
+  uint8_t value;
+  uint8_t result;
+} sRecord_t;
+
+typedef struct{
+  uint32_t count;
+  uint32_t bytes;
+  uint32_t failed;
+  uint32_t mismatch;
+} sOpStats_t;
+
+static bool loadFile(const char *path, std::vector<uint8_t> &data){
+  FILE *fp = fopen(path, "rb");
+  if(fp == NULL){
+    return false;
+  }
+  uint8_t buf[512];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), fp)) > 0){
+    data.insert(data.end(), buf, buf + n);
+  }
+  fclose(fp);
+  if(data.size() >= 4 && memcmp(&data[0], "WKTR", 4) == 0){
+    return true;
+  }
+  //十六进制文本：忽略空白，每两个十六进制字符为一个字节
+  std::vector<uint8_t> bin;
+  int hi = -1;
+  for(size_t i = 0; i < data.size(); i++){
+    int c = data[i];
+    if(isspace(c)){
+      continue;
+    }
+    if(!isxdigit(c)){
+      return false;
+    }
+    int v = isdigit(c) ? (c - '0') : (toupper(c) - 'A' + 10);
+    if(hi < 0){
+      hi = v;
+    }else{
+      bin.push_back((uint8_t)((hi << 4) | v));
+      hi = -1;
+    }
+  }
+  data.swap(bin);
+  return data.size() >= 4 && memcmp(&data[0], "WKTR", 4) == 0;
+}
+
+static bool parse(const std::vector<uint8_t> &data, std::vector<sRecord_t> &records){
+  if(data.size() < 8 || data[4] != IIC_SERIAL_TRACE_VERSION || data[5] < 10){
+    return false;
+  }
+  size_t size = data[5];
+  size_t count = data[6] | (data[7] << 8);
+  if(data.size() < 8 + count * size){
+    return false;
+  }
+  for(size_t i = 0; i < count; i++){
+    const uint8_t *p = &data[8 + i * size];
+    sRecord_t r;
+    r.us = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    r.addr = p[4];
+    r.reg = p[5];
+    r.flags = p[6];
+    r.len = p[7];
+    r.value = p[8];
+    r.result = p[9];
+    records.push_back(r);
+  }
+  return true;
+}
+
+/*按寄存器地址和当前页得到寄存器名，页未知时第0页、第1页的名字都列出*/
+static std::string regName(uint8_t reg, int page){
+  static const char *global[] = {"GENA", "GRST", NULL, "SPAGE"};
+  static const char *page0[] = {"SCR", "LCR", "FCR", "SIER", "SIFR", "TFCNT", "RFCNT", "FSR", "LSR", "FDAT"};
+  static const char *page1[] = {"BAUD1", "BAUD0", "PRES", "RFTL", "TFTL"};
+  char buf[24];
+  if(reg < 4 && global[reg]) return global[reg];
+  if(reg == 0x10) return "GIER";
+  if(reg == 0x11) return "GIFR";
+  bool in0 = reg >= 0x04 && reg <= 0x0D, in1 = reg >= 0x04 && reg <= 0x08;
+  if(page == 0 && in0) return page0[reg - 0x04];
+  if(page == 1 && in1) return page1[reg - 0x04];
+  if(page < 0 && in1){
+    snprintf(buf, sizeof(buf), "%s/%s", page0[reg - 0x04], page1[reg - 0x04]);
+    return buf;
+  }
+  if(page < 0 && in0) return page0[reg - 0x04];
+  snprintf(buf, sizeof(buf), "0x%02X", reg);
+  return buf;
+}
+
+static std::string opName(const sRecord_t &r, int page){
+  char buf[64];
+  uint8_t chip = r.addr >> 3, channel = (r.addr >> 1) & 0x03;
+  snprintf(buf, sizeof(buf), "0x%02X ch%u %-5s %s", chip, channel + 1, (r.flags & IIC_SERIAL_TRACE_READ) ? "read" : "write",
+           (r.flags & IIC_SERIAL_TRACE_FIFO) ? "FIFO" : regName(r.reg, page).c_str());
+  return buf;
+}
+
+/*把一条记录作为IIC事务发给总线上的仿真模型，返回读到的第一个字节，-1表示无应答*/
+static int replayOne(const sRecord_t &r){
+  uint8_t buf[256];
+  uint8_t len = r.len ? r.len : 1;
+  if(!(r.flags & IIC_SERIAL_TRACE_READ)){
+    //只记录了第一个数据字节，多字节写入用它补足长度
+    memset(buf, r.value, sizeof(buf));
+    Wire.beginTransmission(r.addr);
+    if(!(r.flags & IIC_SERIAL_TRACE_FIFO)){
+      Wire.write(&r.reg, 1);
+    }
+    Wire.write(buf, r.len);
+    return Wire.endTransmission() == 0 ? r.value : -1;
+  }
+  if(!(r.flags & IIC_SERIAL_TRACE_FIFO)){
+    Wire.beginTransmission(r.addr);
+    Wire.write(&r.reg, 1);
+    if(Wire.endTransmission() != 0){
+      return -1;
+    }
+  }
+  uint8_t n = Wire.requestFrom(r.addr, len);
+  for(uint8_t i = 0; i < n; i++){
+    buf[i] = Wire.read();
+  }
+  return n ? buf[0] : -1;
+}
+
+int main(int argc, char **argv){
+  bool replay = false, loopback = false;
+  const char *path = NULL;
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "--replay") == 0){
+      replay = true;
+    }else if(strcmp(argv[i], "--loopback") == 0){
+      loopback = true;
+    }else{
+      path = argv[i];
+    }
+  }
+  if(path == NULL){
+    fprintf(stderr, "usage: %s [--replay] [--loopback] trace-file\n", argv[0]);
+    return 1;
+  }
+  std::vector<uint8_t> data;
+  std::vector<sRecord_t> records;
+  if(!loadFile(path, data) || !parse(data, records)){
+    fprintf(stderr, "%s: not a WK2132 trace (version %d)\n", path, IIC_SERIAL_TRACE_VERSION);
+    return 1;
+  }
+
+  //回放：每个出现过的芯片地址一个仿真模型
+  std::vector<WK2132Model *> models;
+  if(replay){
+    sim::reset();
+    Wire.detachAllDevices();
+    for(size_t i = 0; i < records.size(); i++){
+      uint8_t chip = records[i].addr >> 3;
+      bool found = false;
+      for(size_t m = 0; m < models.size(); m++){
+        found = found || (models[m]->i2cMatch(records[i].addr));
+      }
+      if(!found){
+        WK2132Model *model = new WK2132Model(chip);
+        model->attach(Wire);
+        if(loopback){
+          model->loopback(0);
+          model->loopback(1);
+        }
+        models.push_back(model);
+      }
+    }
+  }
+
+  uint64_t replayBase = sim::now();
+  std::map<std::string, sOpStats_t> ops;
+  std::map<uint8_t, int> page;          //每个子串口(寄存器地址)当前的页，-1未知
+  uint32_t pageWrites = 0, redundantPages = 0, roundTrips = 0, failed = 0, mismatches = 0;
+  std::vector<uint32_t> gaps;
+  uint32_t gapHist[6] = {0};
+  static const char *gapNames[6] = {"<100us", "<1ms", "<10ms", "<100ms", "<1s", ">=1s"};
+  std::vector<std::pair<uint32_t, size_t> > largest;
+  for(size_t i = 0; i < records.size(); i++){
+    const sRecord_t &r = records[i];
+    uint8_t port = r.addr & ~0x01;
+    int cur = page.count(port) ? page[port] : -1;
+    std::string name = opName(r, cur);
+    sOpStats_t &op = ops[name];
+    op.count++;
+    op.bytes += r.len;
+    if(r.result){
+      op.failed++;
+      failed++;
+    }
+    if(!(r.flags & (IIC_SERIAL_TRACE_READ | IIC_SERIAL_TRACE_FIFO)) && r.reg == 0x03 && r.len && r.result == 0){
+      int next = r.value & 0x01;
+      pageWrites++;
+      if(next == cur){
+        redundantPages++;
+      }
+      //从第1页切回第0页，每次访问第1页的往返
+      if(next == 0 && cur == 1){
+        roundTrips++;
+      }
+      page[port] = next;
+    }
+    if(i){
+      uint32_t gap = r.us - records[i - 1].us;
+      gaps.push_back(gap);
+      uint8_t bucket = 0;
+      uint32_t limit = 100;
+      while(bucket < 5 && gap >= limit){
+        bucket++;
+        limit *= 10;
+      }
+      gapHist[bucket]++;
+      largest.push_back(std::make_pair(gap, i));
+    }
+    if(replay){
+      //按记录的时间戳对齐，回放本身的IIC事务也会推进仿真时间
+      uint64_t target = replayBase + (uint32_t)(r.us - records[0].us);
+      if(sim::now() < target){
+        sim::advance(target - sim::now());
+      }
+      int v = replayOne(r);
+      bool recordedOk = (r.result == 0);
+      if((v >= 0) != recordedOk || ((r.flags & IIC_SERIAL_TRACE_READ) && recordedOk && v != r.value)){
+        op.mismatch++;
+        mismatches++;
+      }
+    }
+  }
+
+  uint32_t span = records.size() > 1 ? records.back().us - records.front().us : 0;
+  printf("records: %u  span: %.3fms  failed: %u\n", (unsigned)records.size(), span / 1000.0, failed);
+  printf("\n%-32s %8s %8s %8s%s\n", "operation", "count", "bytes", "failed", replay ? "  mismatch" : "");
+  for(std::map<std::string, sOpStats_t>::iterator it = ops.begin(); it != ops.end(); ++it){
+    printf("%-32s %8u %8u %8u", it->first.c_str(), it->second.count, it->second.bytes, it->second.failed);
+    if(replay){
+      printf("  %8u", it->second.mismatch);
+    }
+    printf("\n");
+  }
+  printf("\npage switches: %u  redundant: %u  page1->page0 round trips: %u  per transaction: %.3f\n", pageWrites,
+         redundantPages, roundTrips, records.size() ? (double)pageWrites / records.size() : 0.0);
+  if(!gaps.empty()){
+    std::vector<uint32_t> sorted(gaps);
+    std::sort(sorted.begin(), sorted.end());
+    printf("\ngaps: min %uus  median %uus  max %uus\n", sorted.front(), sorted[sorted.size() / 2], sorted.back());
+    for(uint8_t b = 0; b < 6; b++){
+      printf("  %-7s %u\n", gapNames[b], gapHist[b]);
+    }
+    std::sort(largest.begin(), largest.end());
+    printf("largest gaps (before record #):");
+    for(size_t k = 0; k < 5 && k < largest.size(); k++){
+      const std::pair<uint32_t, size_t> &g = largest[largest.size() - 1 - k];
+      printf(" %uus@%u", g.first, (unsigned)g.second);
+    }
+    printf("\n");
+  }
+  if(replay){
+    //接收计数、状态等随线路数据变化的寄存器在回放时通常不同，失败的事务在回放时一般会成功
+    printf("\nreplay: %u transactions, %u differ from the trace\n", (unsigned)records.size(), mismatches);
+  }
+  Wire.detachAllDevices();
+  sim::reset();
+  for(size_t m = 0; m < models.size(); m++){
+    delete models[m];
+  }
+  return 0;
+}